@@ -1,8 +1,13 @@
 #include "provided.h"
 #include "MyMap.h"
+#include "MyHashMap.h"
+#include "support.h"
+#include "MapSnapshot.h"
 #include <string>
+#include <vector>
 #include <algorithm>
-#include <cctype>
+#include <cstdint>
+#include <memory>
 using namespace std;
 
 class AttractionMapperImpl
@@ -11,14 +16,83 @@ public:
 	AttractionMapperImpl();
 	~AttractionMapperImpl();
 	void init(const MapLoader& ml);
-	bool getGeoCoord(string attraction, GeoCoord& gc) const;
+	void initFrom(const AttractionMapperImpl& other);
+	bool getGeoCoord(const string& attraction, GeoCoord& gc) const;
+	const GeoCoord* findGeoCoord(const char* name, size_t length) const;
+	vector<Attraction> complete(const string& prefix, size_t k, unsigned maxEdits) const;
+	void applyChanges(const vector<MapChange>& changes);
 private:
-	MyMap<string, GeoCoord> attractionMap;
+	// every place on the map an attraction has the name, in map order: by segment number, then in
+	// the order the segment lists them. names can be used more than once, and when they are, the
+	// last one is the one a fresh load of the map would find, so that's what the name stands for
+	struct Occurrence
+	{
+		size_t segNum;
+		Attraction attraction;
+	};
+	typedef vector<Occurrence> Occurrences;
+	// everything init builds. it never changes after, so mappers made with initFrom share it, and
+	// what patches change goes in the tables after it instead
+	struct NameTables
+	{
+		vector<Occurrences> occurrences; // one list per name, numbered by id
+		// names are only ever looked up exactly, so this is a hash table from each lowercase name
+		// to its id. it hashes without regard to case, so a name can be looked up as the caller
+		// wrote it, without lowercasing a copy
+		MyHashMap<string, uint32_t, CaseInsensitiveHash> nameIds;
+		// the same, sorted for completion. every name starting with a prefix is in one run of
+		// entries, and names sharing a start are next to each other, which is all a trie would give
+		FrozenMap<string, uint32_t> prefixIndex;
+	};
+	shared_ptr<const NameTables> m_tables;
+	// the lists patches have changed, by id. a name a patch has taken off entirely keeps an empty
+	// list, since the tables can't erase
+	MyHashMap<uint32_t, Occurrences> m_changed;
+	int m_numRemoved; // how many of the lists are empty
+	// names patches have added, with ids after m_tables' own. looked up like nameIds, and sorted
+	// like prefixIndex, so complete can search them alongside it. once patches have changed enough
+	// lists (see FOLD_DIVISOR), everything is folded into new tables
+	MyHashMap<string, uint32_t, CaseInsensitiveHash> m_addedIds;
+	vector<pair<string, uint32_t>> m_addedNames;
+	static const size_t FOLD_DIVISOR = 8;
+	static const size_t MIN_FOLD = 64;
+
+	// the current list for id
+	const Occurrences& occurrences(uint32_t id) const
+	{
+		const Occurrences* changed = m_changed.size() != 0 ? m_changed.find(id) : nullptr;
+		return changed != nullptr ? *changed : m_tables->occurrences[id]; // added names' lists are all changed ones
+	}
+	// the id for a name in any case, or nullptr if it's never been on the map
+	const uint32_t* findId(const NameProbe &probe) const
+	{
+		const uint32_t* id = m_tables->nameIds.findEquivalent(probe);
+		return id != nullptr || m_addedIds.size() == 0 ? id : m_addedIds.findEquivalent(probe);
+	}
+	// completion numbers the frozen names from 0 and the added ones after them
+	int numEntries() const { return m_tables->prefixIndex.size() + static_cast<int>(m_addedNames.size()); }
+	const string& nameAt(int entry) const
+	{
+		const FrozenMap<string, uint32_t> &frozen = m_tables->prefixIndex;
+		return entry < frozen.size() ? frozen.keyAt(entry) : m_addedNames[entry - frozen.size()].first;
+	}
+	// the attraction the name at entry stands for, or nullptr if it's been removed
+	const Attraction* current(int entry) const;
+	// matches for the entries from first up to last, which have to be in order
+	void completeWithEdits(const string &lowerPrefix, unsigned maxEdits, int first, int last, vector<pair<unsigned, int>> &matches) const;
+	// returns whether the name is new to the map, so the added names need sorting again
+	bool addName(size_t segNum, const Attraction &attraction);
+	void removeName(size_t segNum, const Attraction &attraction);
+	// id's list, copied into m_changed first if it's still the shared one
+	Occurrences& changeOccurrences(uint32_t id);
+	// puts every current list in new tables, leaving the names that have been removed out
+	void fold();
 	// just returns a string that's a lowercase version of what was passed in
 	string stringToLowerCase(const string &toBeLowered) const;
 };
 
 AttractionMapperImpl::AttractionMapperImpl()
+	: m_tables(make_shared<NameTables>()), m_numRemoved(0)
 {
 }
 
@@ -26,51 +100,336 @@ AttractionMapperImpl::~AttractionMapperImpl()
 {
 }
 
+// a snapshot doesn't keep these tables (see MapSnapshot.h), so they get filled the same way for
+// both. a snapshot's attractions are read straight from its records, though, so the loader doesn't
+// have to make every segment just to hand over the few that have attractions
 void AttractionMapperImpl::init(const MapLoader& ml)
 {
-	StreetSegment seg;
-	size_t numSegments = ml.getNumSegments();
-	
-	for (size_t i = 0; i < numSegments; i++) // iterate through all of line segments
+	shared_ptr<NameTables> tables = make_shared<NameTables>();
+	MyMap<string, uint32_t> names; // for the sorted copy
+	auto add = [&](size_t segNum, const Attraction &attraction)
 	{
-		if (ml.getSegment(i, seg))
+		// get attraction name and send it to lowercase
+		string lowerName = stringToLowerCase(attraction.name);
+		pair<uint32_t*, bool> id = tables->nameIds.emplace(lowerName, static_cast<uint32_t>(tables->occurrences.size()));
+		if (id.second)
 		{
-			if (seg.attractions.size() != 0) // check if there are attractions in street segment
+			tables->occurrences.push_back(Occurrences());
+			names.associate(std::move(lowerName), *id.first);
+		}
+		Occurrence found = { segNum, attraction };
+		tables->occurrences[*id.first].push_back(found); // in map order, so it goes on the end
+	};
+	const MapSnapshot* snapshot = MapSnapshot::unpatched(ml);
+	if (snapshot != nullptr)
+	{
+		size_t numSegments;
+		const snapshot::SegmentRecord* segments = snapshot->records<snapshot::SegmentRecord>(snapshot::SEGMENTS, numSegments);
+		Attraction attraction;
+		for (size_t segNum = 0; segNum < numSegments; segNum++)
+			for (uint32_t j = 0; j < segments[segNum].numAttractions; j++)
 			{
-				for (size_t j = 0; j < seg.attractions.size(); j++) // iterate through all attractions
-				{
-					// get attraction name and send it to lowercase
-					string lowerName = stringToLowerCase(seg.attractions[j].name);
-					// add to attraction map
-					attractionMap.associate(lowerName, seg.attractions[j].geocoordinates);
-				} // end for
-			} // end if
-		} // end if
-	} // end for
-}
-
-bool AttractionMapperImpl::getGeoCoord(string attraction, GeoCoord& gc) const
-{
-	// send attraction name to lowercase because they're stored in map in that form
-	// to ensure case-insensitivity
-	string lowerName = stringToLowerCase(attraction);
-	const GeoCoord* gcPtr = attractionMap.find(lowerName); // returns pointer to GeoCoord with that key
-	if (!gcPtr) // if find returns nullptr, !nullptr is true
-		return false;
+				snapshot->getAttraction(segments[segNum].firstAttraction + j, attraction);
+				add(segNum, attraction);
+			}
+	}
 	else
 	{
-		gc = *(const_cast<GeoCoord*>(gcPtr)); // otherwise, set gc to a dereferenced, const_cast version of returned pointer
-		return true;
+		size_t segNum = 0;
+		for (const StreetSegment &seg : ml) // iterate through all of line segments without copying them
+		{
+			for (size_t j = 0; j < seg.attractions.size(); j++) // iterate through all attractions
+				add(segNum, seg.attractions[j]);
+			segNum++;
+		} // end for
 	}
+	names.freeze(tables->prefixIndex);
+	m_tables = tables;
+	m_changed.clear();
+	m_numRemoved = 0;
+	m_addedIds.clear();
+	m_addedNames.clear();
 }
 
-string AttractionMapperImpl::stringToLowerCase(const string &toBeLowered) const
+void AttractionMapperImpl::initFrom(const AttractionMapperImpl& other)
+{
+	m_tables = other.m_tables;
+	m_changed.copyFrom(other.m_changed);
+	m_numRemoved = other.m_numRemoved;
+	m_addedIds.copyFrom(other.m_addedIds);
+	m_addedNames = other.m_addedNames;
+}
+
+bool AttractionMapperImpl::getGeoCoord(const string& attraction, GeoCoord& gc) const
+{
+	const GeoCoord* found = findGeoCoord(attraction.data(), attraction.size());
+	if (found == nullptr)
+		return false;
+	gc = *found;
+	return true;
+}
+
+// the tables are keyed by lowercase names and hashed without regard to case, so the name is
+// hashed and compared right where the caller has it
+const GeoCoord* AttractionMapperImpl::findGeoCoord(const char* name, size_t length) const
 {
-	string result;
-	for (size_t i = 0; i < toBeLowered.size(); i++)
+	const uint32_t* id = findId(NameProbe(name, length));
+	if (id == nullptr || occurrences(*id).empty()) // the name isn't on the map
+		return nullptr;
+	return &occurrences(*id).back().attraction.geocoordinates;
+}
+
+vector<Attraction> AttractionMapperImpl::complete(const string& prefix, size_t k, unsigned maxEdits) const
+{
+	string lowerPrefix = stringToLowerCase(prefix);
+	vector<Attraction> result;
+	if (maxEdits == 0)
 	{
-		result += tolower(toBeLowered[i]); // goes character by character and sends to lowercase
+		// in both lists, the names starting with the prefix come right where the prefix itself
+		// would go. the two runs are merged, so the names still come out in order
+		int frozen = m_tables->prefixIndex.lowerBound(lowerPrefix);
+		int added = m_tables->prefixIndex.size() + static_cast<int>(lower_bound(m_addedNames.begin(), m_addedNames.end(), lowerPrefix,
+			[](const pair<string, uint32_t> &entry, const string &key) { return entry.first < key; }) - m_addedNames.begin());
+		auto startsWithPrefix = [&](int entry, int last) { return entry < last && nameAt(entry).compare(0, lowerPrefix.size(), lowerPrefix) == 0; };
+		while (result.size() < k)
+		{
+			bool frozenLeft = startsWithPrefix(frozen, m_tables->prefixIndex.size());
+			bool addedLeft = startsWithPrefix(added, numEntries());
+			if (!frozenLeft && !addedLeft)
+				break;
+			int entry = frozenLeft && (!addedLeft || nameAt(frozen) < nameAt(added)) ? frozen++ : added++;
+			if (current(entry) != nullptr)
+				result.push_back(*current(entry));
+		}
+		return result;
 	}
+
+	vector<pair<unsigned, int>> matches; // (edits, entry)
+	completeWithEdits(lowerPrefix, maxEdits, 0, m_tables->prefixIndex.size(), matches);
+	completeWithEdits(lowerPrefix, maxEdits, m_tables->prefixIndex.size(), numEntries(), matches);
+	// a short prefix can match most of the names, and only the first k are wanted. the first k plus
+	// however many names have been removed is enough to still have k once those are skipped
+	size_t wanted = min(matches.size(), k + m_numRemoved);
+	// fewest edits first, then by name
+	partial_sort(matches.begin(), matches.begin() + wanted, matches.end(), [this](const pair<unsigned, int> &a, const pair<unsigned, int> &b)
+		{ return a.first != b.first ? a.first < b.first : nameAt(a.second) < nameAt(b.second); });
+	for (size_t i = 0; i < wanted && result.size() < k; i++)
+		if (current(matches[i].second) != nullptr)
+			result.push_back(*current(matches[i].second));
+	return result;
+}
+
+// a name matches if some start of it is within maxEdits of the prefix. row j of the table for a
+// name holds, for each i, how many edits turn the prefix's first i characters into the name's first
+// j, so the best start is the smallest last entry over all the rows. a row is worked out from the
+// one above it alone, which means two names only differ in the rows past what they have in common:
+// going through the names in order, each one picks up the rows of the one before at the point they
+// split, the same as walking down a trie. no row is ever smaller than the smallest entry of the row
+// above it, so once that's no better than the best start so far (or is already over maxEdits) the
+// rest of the name can't change anything, and neither can the rest of any name sharing that much
+void AttractionMapperImpl::completeWithEdits(const string &lowerPrefix, unsigned maxEdits, int first, int last, vector<pair<unsigned, int>> &matches) const
+{
+	size_t width = lowerPrefix.size() + 1;
+	vector<unsigned> rows(width * 32); // one after another in a single array
+	for (size_t i = 0; i < width; i++)
+		rows[i] = static_cast<unsigned>(i);
+	vector<unsigned> bestStart(1, rows[width - 1]); // bestStart[j] is the smallest last entry of rows 0 to j
+	const string* rowsName = nullptr; // the name rows was worked out for
+	size_t decidedRow = SIZE_MAX; // the row of rowsName past which nothing can change
+
+	for (int e = first; e < last; e++)
+	{
+		const string &name = nameAt(e);
+		size_t shared = 0;
+		if (rowsName != nullptr)
+			while (shared < name.size() && shared < rowsName->size() && name[shared] == (*rowsName)[shared])
+				shared++;
+		if (shared < decidedRow) // otherwise the rows it has in common with rowsName already decide it
+		{
+			bestStart.resize(min(bestStart.size(), shared + 1));
+			rowsName = &name;
+			decidedRow = SIZE_MAX;
+			for (size_t j = bestStart.size(); j <= name.size(); j++)
+			{
+				if (rows.size() < (j + 1) * width)
+					rows.resize(2 * (j + 1) * width);
+				const unsigned* above = &rows[(j - 1) * width];
+				unsigned* row = &rows[j * width];
+				row[0] = static_cast<unsigned>(j);
+				unsigned lowest = row[0];
+				for (size_t i = 1; i < width; i++)
+				{
+					unsigned change = above[i - 1] + (lowerPrefix[i - 1] == name[j - 1] ? 0 : 1);
+					row[i] = min(change, min(above[i], row[i - 1]) + 1);
+					lowest = min(lowest, row[i]);
+				}
+				bestStart.push_back(min(bestStart.back(), row[width - 1]));
+				if (lowest >= bestStart.back() || lowest > maxEdits)
+				{
+					decidedRow = j;
+					break;
+				}
+			}
+		}
+		if (bestStart.back() <= maxEdits)
+			matches.push_back(make_pair(bestStart.back(), e));
+		else if (decidedRow != SIZE_MAX)
+		{
+			// none of the names sharing the first decidedRow characters match, and they're all in a
+			// row from here, so jump past the lot instead of looking at each one
+			int low = e + 1, high = last;
+			while (low < high)
+			{
+				int mid = low + (high - low) / 2;
+				if (nameAt(mid).compare(0, decidedRow, *rowsName, 0, decidedRow) == 0)
+					low = mid + 1;
+				else
+					high = mid;
+			}
+			e = low - 1;
+		}
+	}
+}
+
+const Attraction* AttractionMapperImpl::current(int entry) const
+{
+	const FrozenMap<string, uint32_t> &frozen = m_tables->prefixIndex;
+	const Occurrences &list = occurrences(entry < frozen.size() ? frozen.valueAt(entry) : m_addedNames[entry - frozen.size()].second);
+	return list.empty() ? nullptr : &list.back().attraction;
+}
+
+// only the attractions named in the change list are touched
+void AttractionMapperImpl::applyChanges(const vector<MapChange>& changes)
+{
+	bool namesAdded = false;
+	for (const MapChange &change : changes)
+	{
+		switch (change.type)
+		{
+		case MapChange::SEGMENT_ADDED:
+			for (size_t j = 0; j < change.segment.attractions.size(); j++)
+				namesAdded = addName(change.segNum, change.segment.attractions[j]) || namesAdded;
+			break;
+		case MapChange::SEGMENT_REMOVED:
+			for (size_t j = 0; j < change.segment.attractions.size(); j++)
+				removeName(change.segNum, change.segment.attractions[j]);
+			break;
+		case MapChange::SEGMENT_MOVED: // same attractions under a different segment number, which can change which one is last
+			for (size_t j = 0; j < change.segment.attractions.size(); j++)
+			{
+				removeName(change.fromSegNum, change.segment.attractions[j]);
+				addName(change.segNum, change.segment.attractions[j]);
+			}
+			break;
+		case MapChange::ATTRACTION_ADDED:
+			namesAdded = addName(change.segNum, change.attraction) || namesAdded;
+			break;
+		case MapChange::ATTRACTION_REMOVED:
+			removeName(change.segNum, change.attraction);
+			break;
+		}
+	}
+	// every changed list gets copied along with the mapper, and folding costs the whole map, so
+	// it waits until they're a good fraction of it. that works out to a few names' worth of
+	// copying per list changed
+	size_t foldAt = m_tables->occurrences.size() / FOLD_DIVISOR;
+	if (foldAt < MIN_FOLD)
+		foldAt = MIN_FOLD;
+	if (static_cast<size_t>(m_changed.size()) > foldAt)
+		fold();
+	else if (namesAdded)
+		sort(m_addedNames.begin(), m_addedNames.end());
+}
+
+// new attractions go on the end of their segment, so the occurrence goes after every other one
+// from the same segment or before it
+bool AttractionMapperImpl::addName(size_t segNum, const Attraction &attraction)
+{
+	const string &name = attraction.name;
+	const uint32_t* found = findId(NameProbe(name.data(), name.size()));
+	uint32_t id;
+	bool added = found == nullptr;
+	if (added)
+	{
+		id = static_cast<uint32_t>(m_tables->occurrences.size() + m_addedNames.size());
+		string lowerName = stringToLowerCase(name);
+		m_addedIds.associate(lowerName, id);
+		m_addedNames.push_back(make_pair(std::move(lowerName), id)); // applyChanges sorts them
+	}
+	else
+		id = *found;
+	Occurrences &list = changeOccurrences(id);
+	if (list.empty() && !added)
+		m_numRemoved--;
+	Occurrence occurrence = { segNum, attraction };
+	auto after = list.end();
+	while (after != list.begin() && (after - 1)->segNum > segNum)
+		--after;
+	list.insert(after, occurrence);
+	return added;
+}
+
+// a segment loses its first attraction with the name, in any case, which is that segment's first
+// occurrence of it
+void AttractionMapperImpl::removeName(size_t segNum, const Attraction &attraction)
+{
+	const string &name = attraction.name;
+	const uint32_t* id = findId(NameProbe(name.data(), name.size()));
+	if (id == nullptr)
+		return;
+	Occurrences &list = changeOccurrences(*id);
+	for (auto it = list.begin(); it != list.end(); ++it)
+	{
+		if (it->segNum == segNum)
+		{
+			list.erase(it);
+			if (list.empty())
+				m_numRemoved++;
+			return;
+		}
+	}
+}
+
+AttractionMapperImpl::Occurrences& AttractionMapperImpl::changeOccurrences(uint32_t id)
+{
+	Occurrences* list = m_changed.find(id);
+	if (list == nullptr)
+		list = m_changed.emplace(id, id < m_tables->occurrences.size() ? m_tables->occurrences[id] : Occurrences()).first;
+	return *list;
+}
+
+void AttractionMapperImpl::fold()
+{
+	shared_ptr<NameTables> tables = make_shared<NameTables>();
+	MyMap<string, uint32_t> names;
+	auto keep = [&](const string &lowerName, uint32_t id)
+	{
+		const Occurrences &list = occurrences(id);
+		if (list.empty())
+			return;
+		uint32_t newId = static_cast<uint32_t>(tables->occurrences.size());
+		tables->occurrences.push_back(list);
+		tables->nameIds.associate(lowerName, newId);
+		names.associate(lowerName, newId);
+	};
+	const FrozenMap<string, uint32_t> &frozen = m_tables->prefixIndex;
+	for (int i = 0; i < frozen.size(); i++)
+		keep(frozen.keyAt(i), frozen.valueAt(i));
+	for (const pair<string, uint32_t> &added : m_addedNames)
+		keep(added.first, added.second);
+	names.freeze(tables->prefixIndex);
+	m_tables = tables;
+	m_changed.clear();
+	m_numRemoved = 0;
+	m_addedIds.clear();
+	m_addedNames.clear();
+}
+
+string AttractionMapperImpl::stringToLowerCase(const string &toBeLowered) const
+{
+	string result(toBeLowered); // one allocation at most, then lowered in place
+	for (size_t i = 0; i < result.size(); i++)
+		result[i] = asciiLower(result[i]);
 	return result;
 }
 
@@ -94,7 +453,27 @@ void AttractionMapper::init(const MapLoader& ml)
 	m_impl->init(ml);
 }
 
-bool AttractionMapper::getGeoCoord(string attraction, GeoCoord& gc) const
+void AttractionMapper::initFrom(const AttractionMapper& other)
+{
+	m_impl->initFrom(*other.m_impl);
+}
+
+bool AttractionMapper::getGeoCoord(const string& attraction, GeoCoord& gc) const
 {
 	return m_impl->getGeoCoord(attraction, gc);
 }
+
+const GeoCoord* AttractionMapper::findGeoCoord(const char* name, size_t length) const
+{
+	return m_impl->findGeoCoord(name, length);
+}
+
+vector<Attraction> AttractionMapper::complete(const string& prefix, size_t k, unsigned maxEdits) const
+{
+	return m_impl->complete(prefix, k, maxEdits);
+}
+
+void AttractionMapper::applyChanges(const vector<MapChange>& changes)
+{
+	m_impl->applyChanges(changes);
+}
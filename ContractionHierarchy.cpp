@@ -0,0 +1,426 @@
+#include "ContractionHierarchy.h"
+#include <vector>
+#include <queue>
+#include <functional>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <cmath>
+using namespace std;
+using namespace hierarchy;
+
+namespace
+{
+	struct Arc {
+		uint32_t node;
+		uint32_t middle;
+		double length;
+	};
+
+	// the graph partway through being contracted: every node's arcs out and in, shortcuts included.
+	// arcs to nodes that have already been contracted are left in place and skipped
+	class Contractor
+	{
+	public:
+		Contractor(const RoadGraph &graph);
+		// contracts every node, filling in their ranks and the final edges: up[n] goes from n to
+		// higher ranked nodes, down[n] comes into n from them
+		void contractAll(vector<uint32_t> &ranks, vector<vector<HierarchyEdge>> &up, vector<vector<HierarchyEdge>> &down);
+	private:
+		// how far a witness search goes before giving up and letting the shortcut be added anyway.
+		// that's always safe, it just might add a shortcut that isn't needed
+		static const size_t WITNESS_SETTLE_LIMIT = 500;
+
+		vector<vector<Arc>> m_out, m_in;
+		vector<bool> m_contracted;
+		vector<uint32_t> m_contractedNeighbors;
+		// witness search state, reset by bumping m_round rather than clearing
+		vector<double> m_distance;
+		vector<uint32_t> m_round;
+		uint32_t m_currentRound;
+
+		void addArc(uint32_t from, uint32_t to, uint32_t middle, double length);
+		// the shortcuts contracting node would need. with add set, they're added too
+		int contract(uint32_t node, bool add);
+		// shortest distances from start to anything within limit, not going through avoid
+		void witnessSearch(uint32_t start, uint32_t avoid, double limit);
+		double witnessDistance(uint32_t node) const { return m_round[node] == m_currentRound ? m_distance[node] : HUGE_VAL; }
+		int priority(uint32_t node);
+	};
+
+	Contractor::Contractor(const RoadGraph &graph)
+		: m_out(graph.getNumNodes()), m_in(graph.getNumNodes()), m_contracted(graph.getNumNodes(), false),
+		m_contractedNeighbors(graph.getNumNodes(), 0), m_distance(graph.getNumNodes(), HUGE_VAL),
+		m_round(graph.getNumNodes(), 0), m_currentRound(0)
+	{
+		for (uint32_t node = 0; node < graph.getNumNodes(); node++)
+			for (const RoadEdge *edge = graph.edgesBegin(node), *end = graph.edgesEnd(node); edge != end; edge++)
+				if (!edge->toAttraction())
+					addArc(node, edge->target, RoadGraph::NO_NODE, edge->length);
+	}
+
+	// keeps only the shortest arc between any two nodes
+	void Contractor::addArc(uint32_t from, uint32_t to, uint32_t middle, double length)
+	{
+		for (Arc &arc : m_out[from])
+		{
+			if (arc.node != to)
+				continue;
+			if (length < arc.length)
+			{
+				arc.middle = middle;
+				arc.length = length;
+				for (Arc &back : m_in[to])
+					if (back.node == from)
+						back = Arc{ from, middle, length };
+			}
+			return;
+		}
+		m_out[from].push_back(Arc{ to, middle, length });
+		m_in[to].push_back(Arc{ from, middle, length });
+	}
+
+	void Contractor::witnessSearch(uint32_t start, uint32_t avoid, double limit)
+	{
+		if (++m_currentRound == 0) // wrapped around, so really clear the rounds this once
+		{
+			fill(m_round.begin(), m_round.end(), 0);
+			m_currentRound = 1;
+		}
+		typedef pair<double, uint32_t> Waiting;
+		priority_queue<Waiting, vector<Waiting>, greater<Waiting>> open;
+		m_distance[start] = 0;
+		m_round[start] = m_currentRound;
+		open.push(Waiting(0, start));
+		size_t settled = 0;
+		while (!open.empty() && settled < WITNESS_SETTLE_LIMIT)
+		{
+			Waiting current = open.top();
+			open.pop();
+			if (current.first > m_distance[current.second]) // stale, it was reached faster since
+				continue;
+			if (current.first > limit)
+				break;
+			settled++;
+			for (const Arc &arc : m_out[current.second])
+			{
+				if (m_contracted[arc.node] || arc.node == avoid)
+					continue;
+				double d = current.first + arc.length;
+				if (d < witnessDistance(arc.node))
+				{
+					m_distance[arc.node] = d;
+					m_round[arc.node] = m_currentRound;
+					open.push(Waiting(d, arc.node));
+				}
+			}
+		}
+	}
+
+	int Contractor::contract(uint32_t node, bool add)
+	{
+		int shortcuts = 0;
+		vector<Arc> out;
+		for (const Arc &arc : m_out[node])
+			if (!m_contracted[arc.node])
+				out.push_back(arc);
+		for (const Arc &in : m_in[node])
+		{
+			if (m_contracted[in.node])
+				continue;
+			double limit = -1; // stays negative if in's node is the only place node leads
+			for (const Arc &arc : out)
+				if (arc.node != in.node)
+					limit = max(limit, in.length + arc.length);
+			if (limit < 0)
+				continue;
+			witnessSearch(in.node, node, limit);
+			for (const Arc &arc : out)
+			{
+				if (arc.node == in.node)
+					continue;
+				double via = in.length + arc.length;
+				if (witnessDistance(arc.node) <= via) // there's another way that's no longer
+					continue;
+				shortcuts++;
+				if (add)
+					addArc(in.node, arc.node, node, via);
+			}
+		}
+		return shortcuts;
+	}
+
+	// the usual measure: how many more edges contracting the node would leave than it takes away,
+	// plus how many of its neighbors are already gone, which spreads the contraction out evenly
+	int Contractor::priority(uint32_t node)
+	{
+		int removed = 0;
+		for (const Arc &arc : m_out[node])
+			removed += m_contracted[arc.node] ? 0 : 1;
+		for (const Arc &arc : m_in[node])
+			removed += m_contracted[arc.node] ? 0 : 1;
+		return contract(node, false) - removed + static_cast<int>(m_contractedNeighbors[node]);
+	}
+
+	void Contractor::contractAll(vector<uint32_t> &ranks, vector<vector<HierarchyEdge>> &up, vector<vector<HierarchyEdge>> &down)
+	{
+		size_t numNodes = m_out.size();
+		ranks.assign(numNodes, 0);
+		up.assign(numNodes, vector<HierarchyEdge>());
+		down.assign(numNodes, vector<HierarchyEdge>());
+
+		// priorities only go stale by getting worse (or better) as neighbors go, so they're
+		// rechecked when a node comes up and it's put back if it's no longer the least important.
+		// ties go to the lower node number, so the same graph always contracts the same way
+		typedef pair<int, uint32_t> Waiting;
+		priority_queue<Waiting, vector<Waiting>, greater<Waiting>> order;
+		for (uint32_t node = 0; node < numNodes; node++)
+			order.push(Waiting(priority(node), node));
+
+		uint32_t nextRank = 0;
+		while (!order.empty())
+		{
+			uint32_t node = order.top().second;
+			order.pop();
+			int now = priority(node);
+			if (!order.empty() && Waiting(now, node) > order.top())
+			{
+				order.push(Waiting(now, node));
+				continue;
+			}
+
+			// every arc still attached goes to a node contracted later, so it's final now
+			for (const Arc &arc : m_out[node])
+				if (!m_contracted[arc.node])
+					up[node].push_back(HierarchyEdge{ arc.node, arc.middle, arc.length });
+			for (const Arc &arc : m_in[node])
+				if (!m_contracted[arc.node])
+					down[node].push_back(HierarchyEdge{ arc.node, arc.middle, arc.length });
+			contract(node, true);
+			m_contracted[node] = true;
+			ranks[node] = nextRank++;
+			for (const Arc &arc : m_out[node])
+				m_contractedNeighbors[arc.node]++;
+			for (const Arc &arc : m_in[node])
+				m_contractedNeighbors[arc.node]++;
+		}
+	}
+
+	// flattens one edge list per node into an array of where each node's edges start plus the edges
+	void flatten(const vector<vector<HierarchyEdge>> &lists, vector<uint32_t> &first, vector<HierarchyEdge> &edges)
+	{
+		first.clear();
+		edges.clear();
+		for (const vector<HierarchyEdge> &list : lists)
+		{
+			first.push_back(static_cast<uint32_t>(edges.size()));
+			edges.insert(edges.end(), list.begin(), list.end());
+		}
+		first.push_back(static_cast<uint32_t>(edges.size()));
+	}
+
+	size_t alignedSize(size_t bytes)
+	{
+		return (bytes + 7) & ~static_cast<size_t>(7); // every section starts on an 8 byte boundary
+	}
+
+	template<typename Record>
+	void setSection(Header &header, SectionId id, const vector<Record> &records, uint64_t &offset)
+	{
+		header.sections[id].offset = offset;
+		header.sections[id].count = records.size();
+		offset += alignedSize(records.size() * sizeof(Record));
+	}
+
+	template<typename Record>
+	void writeSection(ofstream &out, const vector<Record> &records)
+	{
+		static const char zeros[8] = { 0 };
+		size_t bytes = records.size() * sizeof(Record);
+		if (bytes != 0)
+			out.write(reinterpret_cast<const char*>(records.data()), bytes);
+		out.write(zeros, alignedSize(bytes) - bytes);
+	}
+
+	// Section::count is untrusted, so check it against the file before multiplying it out
+	bool sectionFits(const Section &section, size_t recordSize, size_t fileSize)
+	{
+		if (section.offset > fileSize || section.offset % 8 != 0)
+			return false;
+		return section.count <= (fileSize - section.offset) / recordSize;
+	}
+}
+
+ContractionHierarchy::ContractionHierarchy()
+	: m_ranks(nullptr), m_upFirst(nullptr), m_upEdges(nullptr), m_downFirst(nullptr), m_downEdges(nullptr),
+	m_numNodes(0), m_numUpEdges(0), m_numDownEdges(0)
+{
+}
+
+bool ContractionHierarchy::write(const RoadGraph &graph, const string &fileName)
+{
+	vector<uint32_t> ranks;
+	vector<vector<HierarchyEdge>> up, down;
+	Contractor(graph).contractAll(ranks, up, down);
+	vector<uint32_t> upFirst, downFirst;
+	vector<HierarchyEdge> upEdges, downEdges;
+	flatten(up, upFirst, upEdges);
+	flatten(down, downFirst, downEdges);
+
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.byteOrderMark = BYTE_ORDER_MARK;
+	header.numNodes = graph.getNumNodes();
+	header.fingerprint = fingerprint(graph);
+	uint64_t offset = alignedSize(sizeof(Header));
+	setSection(header, RANKS, ranks, offset);
+	setSection(header, UP_FIRST, upFirst, offset);
+	setSection(header, UP_EDGES, upEdges, offset);
+	setSection(header, DOWN_FIRST, downFirst, offset);
+	setSection(header, DOWN_EDGES, downEdges, offset);
+	header.fileSize = offset;
+
+	ofstream out(fileName, ios::binary | ios::trunc);
+	if (!out)
+		return false;
+	vector<Header> headerRecord(1, header);
+	writeSection(out, headerRecord);
+	writeSection(out, ranks);
+	writeSection(out, upFirst);
+	writeSection(out, upEdges);
+	writeSection(out, downFirst);
+	writeSection(out, downEdges);
+	return static_cast<bool>(out.flush());
+}
+
+bool ContractionHierarchy::open(const string &fileName, const RoadGraph &graph)
+{
+	if (!m_file.open(fileName) || m_file.size() < sizeof(Header))
+		return false;
+
+	const Header* header = reinterpret_cast<const Header*>(m_file.data());
+	if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION ||
+		header->byteOrderMark != BYTE_ORDER_MARK || header->fileSize != m_file.size() ||
+		header->numNodes != graph.getNumNodes() || header->fingerprint != fingerprint(graph))
+	{
+		m_file.close();
+		return false;
+	}
+
+	static const size_t recordSizes[NUM_SECTIONS] = { sizeof(uint32_t), sizeof(uint32_t), sizeof(HierarchyEdge),
+		sizeof(uint32_t), sizeof(HierarchyEdge) };
+	for (int id = 0; id < NUM_SECTIONS; id++)
+	{
+		if (!sectionFits(header->sections[id], recordSizes[id], m_file.size()))
+		{
+			m_file.close();
+			return false;
+		}
+	}
+
+	const char* base = m_file.data();
+	m_ranks = reinterpret_cast<const uint32_t*>(base + header->sections[RANKS].offset);
+	m_upFirst = reinterpret_cast<const uint32_t*>(base + header->sections[UP_FIRST].offset);
+	m_upEdges = reinterpret_cast<const HierarchyEdge*>(base + header->sections[UP_EDGES].offset);
+	m_downFirst = reinterpret_cast<const uint32_t*>(base + header->sections[DOWN_FIRST].offset);
+	m_downEdges = reinterpret_cast<const HierarchyEdge*>(base + header->sections[DOWN_EDGES].offset);
+	m_numNodes = graph.getNumNodes();
+	m_numUpEdges = header->sections[UP_EDGES].count;
+	m_numDownEdges = header->sections[DOWN_EDGES].count;
+
+	if (header->sections[RANKS].count != m_numNodes || header->sections[UP_FIRST].count != m_numNodes + 1 ||
+		header->sections[DOWN_FIRST].count != m_numNodes + 1 || !validate())
+	{
+		m_file.close();
+		m_numNodes = 0;
+		return false;
+	}
+	return true;
+}
+
+// one pass over the records so queries never have to bounds check anything. edges have to climb
+// in rank and shortcuts have to come apart into edges that are really there, further down, or
+// a search or an unpack could run off the end or never finish
+bool ContractionHierarchy::validate() const
+{
+	for (size_t node = 0; node < m_numNodes; node++)
+		if (m_ranks[node] >= m_numNodes)
+			return false;
+	auto firstsOk = [this](const uint32_t* first, size_t numEdges) {
+		if (first[0] != 0 || first[m_numNodes] != numEdges)
+			return false;
+		for (size_t node = 0; node < m_numNodes; node++)
+			if (first[node] > first[node + 1])
+				return false;
+		return true;
+	};
+	if (!firstsOk(m_upFirst, m_numUpEdges) || !firstsOk(m_downFirst, m_numDownEdges))
+		return false;
+	for (int direction = 0; direction < 2; direction++)
+	{
+		for (uint32_t node = 0; node < m_numNodes; node++)
+		{
+			const HierarchyEdge* begin = direction == 0 ? upBegin(node) : downBegin(node);
+			const HierarchyEdge* end = direction == 0 ? upEnd(node) : downEnd(node);
+			for (const HierarchyEdge* edge = begin; edge != end; edge++)
+			{
+				if (edge->other >= m_numNodes || m_ranks[edge->other] <= m_ranks[node] || !(edge->length >= 0))
+					return false;
+				if (edge->middle == RoadGraph::NO_NODE)
+					continue;
+				uint32_t from = direction == 0 ? node : edge->other;
+				uint32_t to = direction == 0 ? edge->other : node;
+				if (edge->middle >= m_numNodes || m_ranks[edge->middle] >= m_ranks[node] ||
+					findEdge(from, edge->middle) == nullptr || findEdge(edge->middle, to) == nullptr)
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+const HierarchyEdge* ContractionHierarchy::findEdge(uint32_t from, uint32_t to) const
+{
+	if (m_ranks[to] > m_ranks[from])
+	{
+		for (const HierarchyEdge* edge = upBegin(from); edge != upEnd(from); edge++)
+			if (edge->other == to)
+				return edge;
+	}
+	else
+	{
+		for (const HierarchyEdge* edge = downBegin(to); edge != downEnd(to); edge++)
+			if (edge->other == from)
+				return edge;
+	}
+	return nullptr;
+}
+
+uint64_t ContractionHierarchy::fingerprint(const RoadGraph &graph)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	auto mix = [&hash](uint64_t value) {
+		for (int i = 0; i < 8; i++, value >>= 8)
+		{
+			hash ^= value & 0xff;
+			hash *= 1099511628211ULL;
+		}
+	};
+	mix(graph.getNumNodes());
+	for (uint32_t node = 0; node < graph.getNumNodes(); node++)
+	{
+		mix(graph.getKey(node).bits());
+		for (const RoadEdge *edge = graph.edgesBegin(node), *end = graph.edgesEnd(node); edge != end; edge++)
+		{
+			if (edge->toAttraction())
+				continue;
+			uint64_t lengthBits;
+			memcpy(&lengthBits, &edge->length, sizeof(lengthBits));
+			mix(edge->target);
+			mix(lengthBits);
+		}
+	}
+	return hash;
+}
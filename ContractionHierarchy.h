@@ -0,0 +1,115 @@
+#ifndef CONTRACTION_HIERARCHY_H
+#define CONTRACTION_HIERARCHY_H
+
+#include "provided.h"
+#include "support.h"
+#include "RoadGraph.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// A contraction hierarchy over a RoadGraph's streets. Building one takes every node out of the
+// graph in turn, least important first, and wherever the shortest way between two of its
+// neighbors ran through it, adds a shortcut edge between them that stands for the two edges it
+// replaces. The order nodes were taken out in is their rank. Then the shortest route between any
+// two nodes goes up in rank and back down again, so a query is two small Dijkstra searches that
+// only ever climb, one from each end, that meet at the route's highest node.
+//
+// Only street edges are in it. Attraction edges can only be taken into the destination, so a
+// query adds those itself, as the last step of the route.
+//
+// Contracting takes a while, so it's meant to be done once per map and the result kept in a file.
+// The file is mmapped and searched in place like a map snapshot, and it's only any good for the
+// graph it was built from: it carries a fingerprint of that graph's nodes and edges, and open()
+// turns down a file that doesn't match. All offsets are relative to the start of the file.
+
+namespace hierarchy
+{
+	const char MAGIC[8] = { 'B', 'R', 'U', 'I', 'N', 'C', 'H', 'S' };
+	const uint32_t VERSION = 1; // bump whenever a record layout changes
+	const uint32_t BYTE_ORDER_MARK = 0x01020304; // written natively, so a foreign-endian file won't match
+
+	enum SectionId {
+		RANKS,			// uint32_t per node, the order nodes were contracted in
+		UP_FIRST,		// uint32_t per node plus one past the end, where each node's edges start in UP_EDGES
+		UP_EDGES,		// HierarchyEdge, from a node to higher ranked ones
+		DOWN_FIRST,		// uint32_t per node plus one past the end, where each node's edges start in DOWN_EDGES
+		DOWN_EDGES,		// HierarchyEdge, into a node from higher ranked ones
+		NUM_SECTIONS
+	};
+
+	struct Section {
+		uint64_t offset;
+		uint64_t count; // number of records
+	};
+
+	struct Header {
+		char		magic[8];
+		uint32_t	version;
+		uint32_t	byteOrderMark;
+		uint64_t	fileSize;
+		uint64_t	numNodes;
+		uint64_t	fingerprint;		// of the graph it was built from
+		Section		sections[NUM_SECTIONS];
+	};
+}
+
+struct HierarchyEdge
+{
+	uint32_t other;		// the node at the far end: where an up edge goes, or where a down edge comes from
+	uint32_t middle;	// for a shortcut, the node whose contraction made it. RoadGraph::NO_NODE for a street edge
+	double length;
+};
+
+class ContractionHierarchy
+{
+public:
+	ContractionHierarchy();
+	// contracts graph and writes the result. returns false if the file can't be written
+	static bool write(const RoadGraph &graph, const std::string &fileName);
+
+	// maps the file and checks that it was built from graph and that every reference is in bounds
+	bool open(const std::string &fileName, const RoadGraph &graph);
+
+	uint32_t rank(uint32_t node) const { return m_ranks[node]; }
+	// the edges from node up to higher ranked nodes
+	const HierarchyEdge* upBegin(uint32_t node) const { return m_upEdges + m_upFirst[node]; }
+	const HierarchyEdge* upEnd(uint32_t node) const { return m_upEdges + m_upFirst[node + 1]; }
+	// the edges into node from higher ranked nodes
+	const HierarchyEdge* downBegin(uint32_t node) const { return m_downEdges + m_downFirst[node]; }
+	const HierarchyEdge* downEnd(uint32_t node) const { return m_downEdges + m_downFirst[node + 1]; }
+	// the edge from one node to another, or nullptr if the hierarchy has none
+	const HierarchyEdge* findEdge(uint32_t from, uint32_t to) const;
+	// calls street(a, b) for every street edge along edge (which goes from from to to), in order
+	// from from, with every shortcut replaced by the street edges it stands for
+	template<typename Street>
+	void unpack(uint32_t from, uint32_t to, const HierarchyEdge &edge, Street street) const
+	{
+		if (edge.middle == RoadGraph::NO_NODE)
+		{
+			street(from, to);
+			return;
+		}
+		// open() made sure both halves are there
+		unpack(from, edge.middle, *findEdge(from, edge.middle), street);
+		unpack(edge.middle, to, *findEdge(edge.middle, to), street);
+	}
+
+	// we prevent a ContractionHierarchy from being copied or assigned because it owns the mapping
+	ContractionHierarchy(const ContractionHierarchy&) = delete;
+	ContractionHierarchy& operator=(const ContractionHierarchy&) = delete;
+private:
+	MappedFile m_file;
+	const uint32_t* m_ranks;
+	const uint32_t* m_upFirst;
+	const HierarchyEdge* m_upEdges;
+	const uint32_t* m_downFirst;
+	const HierarchyEdge* m_downEdges;
+	size_t m_numNodes, m_numUpEdges, m_numDownEdges;
+
+	// FNV-1a over graph's node coordinates and street edges
+	static uint64_t fingerprint(const RoadGraph &graph);
+	bool validate() const;
+};
+
+#endif // for CONTRACTION_HIERARCHY_H
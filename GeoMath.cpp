@@ -0,0 +1,295 @@
+#include "provided.h"
+#include "GeoMath.h"
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+using namespace std;
+
+namespace
+{
+	const double EARTH_RADIUS_KM = 6371.0; // same constants provided.h uses
+	const double MILES_PER_KM = 0.621371;
+	const double PI = 4 * atan(1.0);
+
+	// Each "lanes" struct is one way of doing arithmetic on WIDTH doubles at a time. The kernels
+	// below are written once against these and instantiated for each. The scalar version is both
+	// the fallback for other CPUs and what finishes off the points left over after the wide loop.
+	struct ScalarLanes
+	{
+		typedef double Vec;
+		typedef bool Mask;
+		static const size_t WIDTH = 1;
+		static Vec load(const double* p) { return *p; }
+		static void store(double* p, Vec v) { *p = v; }
+		static Vec set(double d) { return d; }
+		static Vec add(Vec a, Vec b) { return a + b; }
+		static Vec sub(Vec a, Vec b) { return a - b; }
+		static Vec mul(Vec a, Vec b) { return a * b; }
+		static Vec div(Vec a, Vec b) { return a / b; }
+		static Vec sqrt(Vec a) { return std::sqrt(a); }
+		static Vec min(Vec a, Vec b) { return a < b ? a : b; }
+		static Vec max(Vec a, Vec b) { return a > b ? a : b; }
+		static Vec abs(Vec a) { return std::fabs(a); }
+		static Mask greater(Vec a, Vec b) { return a > b; }
+		static Vec select(Mask m, Vec a, Vec b) { return m ? a : b; }
+	};
+
+#if defined(__SSE2__) || defined(_M_X64)
+	struct SSE2Lanes
+	{
+		typedef __m128d Vec;
+		typedef __m128d Mask;
+		static const size_t WIDTH = 2;
+		static Vec load(const double* p) { return _mm_loadu_pd(p); }
+		static void store(double* p, Vec v) { _mm_storeu_pd(p, v); }
+		static Vec set(double d) { return _mm_set1_pd(d); }
+		static Vec add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+		static Vec sub(Vec a, Vec b) { return _mm_sub_pd(a, b); }
+		static Vec mul(Vec a, Vec b) { return _mm_mul_pd(a, b); }
+		static Vec div(Vec a, Vec b) { return _mm_div_pd(a, b); }
+		static Vec sqrt(Vec a) { return _mm_sqrt_pd(a); }
+		static Vec min(Vec a, Vec b) { return _mm_min_pd(a, b); }
+		static Vec max(Vec a, Vec b) { return _mm_max_pd(a, b); }
+		static Vec abs(Vec a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+		static Mask greater(Vec a, Vec b) { return _mm_cmpgt_pd(a, b); }
+		// SSE2 has no blend, so pick lanes with and/andnot/or
+		static Vec select(Mask m, Vec a, Vec b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+	};
+#endif
+
+#if defined(__AVX__)
+	struct AVXLanes
+	{
+		typedef __m256d Vec;
+		typedef __m256d Mask;
+		static const size_t WIDTH = 4;
+		static Vec load(const double* p) { return _mm256_loadu_pd(p); }
+		static void store(double* p, Vec v) { _mm256_storeu_pd(p, v); }
+		static Vec set(double d) { return _mm256_set1_pd(d); }
+		static Vec add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+		static Vec sub(Vec a, Vec b) { return _mm256_sub_pd(a, b); }
+		static Vec mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+		static Vec div(Vec a, Vec b) { return _mm256_div_pd(a, b); }
+		static Vec sqrt(Vec a) { return _mm256_sqrt_pd(a); }
+		static Vec min(Vec a, Vec b) { return _mm256_min_pd(a, b); }
+		static Vec max(Vec a, Vec b) { return _mm256_max_pd(a, b); }
+		static Vec abs(Vec a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+		static Mask greater(Vec a, Vec b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+		static Vec select(Mask m, Vec a, Vec b) { return _mm256_blendv_pd(b, a, m); }
+	};
+	typedef AVXLanes WideLanes;
+#elif defined(__SSE2__) || defined(_M_X64)
+	typedef SSE2Lanes WideLanes;
+#else
+	typedef ScalarLanes WideLanes;
+#endif
+
+	// atan(t) for 0 <= t <= 1. this is the rational approximation from the Cephes math library,
+	// good to about one unit in the last place. past tan(3pi/16) it's taken around pi/4 instead
+	template<typename L>
+	typename L::Vec atanUnit(typename L::Vec t)
+	{
+		typedef typename L::Vec Vec;
+		static const double MOREBITS = 6.123233995736765886130E-17; // what pi/4 as a double is missing
+		typename L::Mask upper = L::greater(t, L::set(0.66));
+		Vec x = L::select(upper, L::div(L::sub(t, L::set(1.0)), L::add(t, L::set(1.0))), t);
+		Vec base = L::select(upper, L::set(PI / 4), L::set(0.0));
+		Vec extra = L::select(upper, L::set(0.5 * MOREBITS), L::set(0.0));
+
+		Vec z = L::mul(x, x);
+		Vec p = L::set(-8.750608600031904122785E-1);
+		p = L::add(L::mul(p, z), L::set(-1.615753718733365076637E1));
+		p = L::add(L::mul(p, z), L::set(-7.500855792314704667340E1));
+		p = L::add(L::mul(p, z), L::set(-1.228866684490136173410E2));
+		p = L::add(L::mul(p, z), L::set(-6.485021904942025371773E1));
+		Vec q = L::add(z, L::set(2.485846490142306297962E1));
+		q = L::add(L::mul(q, z), L::set(1.650270098316988542046E2));
+		q = L::add(L::mul(q, z), L::set(4.328810604912902668951E2));
+		q = L::add(L::mul(q, z), L::set(4.853903996359136964868E2));
+		q = L::add(L::mul(q, z), L::set(1.945506571482613964425E2));
+
+		Vec r = L::add(L::mul(x, L::div(L::mul(z, p), q)), x);
+		return L::add(base, L::add(r, extra));
+	}
+
+	// atan2(y, x) for y, x >= 0, folded into atanUnit's range. x = y = 0 gives 0 like std::atan2
+	template<typename L>
+	typename L::Vec atanRatio(typename L::Vec y, typename L::Vec x)
+	{
+		typedef typename L::Vec Vec;
+		Vec smaller = L::min(y, x);
+		Vec larger = L::max(L::max(y, x), L::set(DBL_MIN));
+		Vec r = atanUnit<L>(L::div(smaller, larger));
+		return L::select(L::greater(y, x), L::sub(L::set(PI / 2), r), r);
+	}
+
+	// full atan2 built on atanRatio, with the quadrant put back from the signs
+	template<typename L>
+	typename L::Vec atan2Lanes(typename L::Vec y, typename L::Vec x)
+	{
+		typedef typename L::Vec Vec;
+		Vec zero = L::set(0.0);
+		Vec r = atanRatio<L>(L::abs(y), L::abs(x));
+		r = L::select(L::greater(zero, x), L::sub(L::set(PI), r), r);
+		return L::select(L::greater(zero, y), L::sub(zero, r), r);
+	}
+
+	// the central angle is 2 asin(c/2) for a chord of length c. asin is written as an atan so
+	// everything goes through atanRatio
+	template<typename L>
+	typename L::Vec chordDistance(typename L::Vec dx, typename L::Vec dy, typename L::Vec dz, typename L::Vec diameter)
+	{
+		typedef typename L::Vec Vec;
+		Vec one = L::set(1.0);
+		Vec chordSquared = L::add(L::add(L::mul(dx, dx), L::mul(dy, dy)), L::mul(dz, dz));
+		Vec sinHalf = L::min(L::mul(L::sqrt(chordSquared), L::set(0.5)), one);
+		Vec cosHalf = L::sqrt(L::max(L::sub(one, L::mul(sinHalf, sinHalf)), L::set(0.0)));
+		return L::mul(diameter, atanRatio<L>(sinHalf, cosHalf));
+	}
+
+	template<typename L>
+	size_t distanceKernel(const GeoPoint &from, const GeoPoints &points, size_t i, double scale, double* out)
+	{
+		typedef typename L::Vec Vec;
+		Vec fx = L::set(from.x), fy = L::set(from.y), fz = L::set(from.z);
+		Vec diameter = L::set(2.0 * EARTH_RADIUS_KM * scale);
+		for (; i + L::WIDTH <= points.size(); i += L::WIDTH)
+		{
+			Vec dx = L::sub(L::load(points.xs() + i), fx);
+			Vec dy = L::sub(L::load(points.ys() + i), fy);
+			Vec dz = L::sub(L::load(points.zs() + i), fz);
+			L::store(out + i, chordDistance<L>(dx, dy, dz, diameter));
+		}
+		return i;
+	}
+
+	// same angle angleOfLine gives, from the differences in degrees, and shifted into [0, 360)
+	template<typename L>
+	size_t angleKernel(const GeoPoint &from, const GeoPoints &points, size_t i, double subtract, double* out)
+	{
+		typedef typename L::Vec Vec;
+		Vec fromLatitude = L::set(from.latitude), fromLongitude = L::set(from.longitude);
+		Vec toDegrees = L::set(180 / PI), offset = L::set(subtract), full = L::set(360.0), zero = L::set(0.0);
+		for (; i + L::WIDTH <= points.size(); i += L::WIDTH)
+		{
+			Vec dLatitude = L::sub(L::load(points.latitudes() + i), fromLatitude);
+			Vec dLongitude = L::sub(L::load(points.longitudes() + i), fromLongitude);
+			Vec angle = L::sub(L::mul(atan2Lanes<L>(dLatitude, dLongitude), toDegrees), offset);
+			L::store(out + i, L::select(L::greater(zero, angle), L::add(angle, full), angle));
+		}
+		return i;
+	}
+
+	void distances(const GeoPoint &from, const GeoPoints &points, double scale, vector<double> &out)
+	{
+		out.resize(points.size());
+		if (points.size() == 0)
+			return;
+		size_t done = distanceKernel<WideLanes>(from, points, 0, scale, out.data());
+		distanceKernel<ScalarLanes>(from, points, done, scale, out.data());
+	}
+
+	// angleBetween2Lines is the second line's angle minus the first's, so both batch angle
+	// functions are the same kernel with a different amount taken off
+	void angles(const GeoPoint &from, const GeoPoints &points, double subtract, vector<double> &out)
+	{
+		out.resize(points.size());
+		if (points.size() == 0)
+			return;
+		size_t done = angleKernel<WideLanes>(from, points, 0, subtract, out.data());
+		angleKernel<ScalarLanes>(from, points, done, subtract, out.data());
+	}
+
+	double rawAngle(const GeoSegment &line)
+	{
+		return atan2Lanes<ScalarLanes>(line.end.latitude - line.start.latitude, line.end.longitude - line.start.longitude) * (180 / PI);
+	}
+}
+
+GeoPoint::GeoPoint(const GeoCoord &gc)
+	: latitude(gc.latitude), longitude(gc.longitude)
+{
+	double latitudeRad = deg2rad(gc.latitude);
+	double longitudeRad = deg2rad(gc.longitude);
+	x = cos(latitudeRad) * cos(longitudeRad);
+	y = cos(latitudeRad) * sin(longitudeRad);
+	z = sin(latitudeRad);
+}
+
+void GeoPoints::reserve(size_t n)
+{
+	m_latitude.reserve(n);
+	m_longitude.reserve(n);
+	m_x.reserve(n);
+	m_y.reserve(n);
+	m_z.reserve(n);
+}
+
+void GeoPoints::clear()
+{
+	m_latitude.clear();
+	m_longitude.clear();
+	m_x.clear();
+	m_y.clear();
+	m_z.clear();
+}
+
+void GeoPoints::push_back(const GeoPoint &point)
+{
+	m_latitude.push_back(point.latitude);
+	m_longitude.push_back(point.longitude);
+	m_x.push_back(point.x);
+	m_y.push_back(point.y);
+	m_z.push_back(point.z);
+}
+
+GeoPoint GeoPoints::operator[](size_t i) const
+{
+	GeoPoint point;
+	point.latitude = m_latitude[i];
+	point.longitude = m_longitude[i];
+	point.x = m_x[i];
+	point.y = m_y[i];
+	point.z = m_z[i];
+	return point;
+}
+
+void distancesEarthKM(const GeoPoint &from, const GeoPoints &points, vector<double> &out)
+{
+	distances(from, points, 1.0, out);
+}
+
+void distancesEarthMiles(const GeoPoint &from, const GeoPoints &points, vector<double> &out)
+{
+	distances(from, points, MILES_PER_KM, out);
+}
+
+void anglesOfLines(const GeoPoint &from, const GeoPoints &points, vector<double> &out)
+{
+	angles(from, points, 0.0, out);
+}
+
+void anglesBetween2Lines(const GeoSegment &line1, const GeoPoint &from, const GeoPoints &points, vector<double> &out)
+{
+	angles(from, points, rawAngle(line1), out);
+}
+
+double distanceEarthKM(const GeoPoint &p1, const GeoPoint &p2)
+{
+	return chordDistance<ScalarLanes>(p2.x - p1.x, p2.y - p1.y, p2.z - p1.z, 2.0 * EARTH_RADIUS_KM);
+}
+
+double distanceEarthMiles(const GeoPoint &p1, const GeoPoint &p2)
+{
+	return chordDistance<ScalarLanes>(p2.x - p1.x, p2.y - p1.y, p2.z - p1.z, 2.0 * EARTH_RADIUS_KM * MILES_PER_KM);
+}
+
+double angleOfLine(const GeoPoint &start, const GeoPoint &end)
+{
+	double angle = atan2Lanes<ScalarLanes>(end.latitude - start.latitude, end.longitude - start.longitude) * (180 / PI);
+	return angle < 0 ? angle + 360 : angle;
+}
@@ -0,0 +1,77 @@
+#include "LandmarkTable.h"
+#include <queue>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <cmath>
+using namespace std;
+
+void LandmarkTable::build(const RoadGraph &graph, size_t count)
+{
+	size_t numNodes = graph.getNumNodes();
+	count = min(count, numNodes);
+	m_landmarks.clear();
+	m_distances.clear();
+	if (count == 0)
+		return;
+
+	vector<vector<double>> columns; // each landmark's distances, interleaved into m_distances at the end
+	vector<double> nearest(numNodes, HUGE_VAL); // each node's distance to the closest landmark so far
+	vector<double> distances;
+	distancesFrom(graph, 0, distances);
+	for (size_t i = 0; i < count; i++)
+	{
+		// the farthest node that can be reached at all. nodes nothing reaches are left to the
+		// heuristic they'd have had without landmarks
+		uint32_t farthest = 0;
+		double farthestDistance = -1;
+		for (uint32_t node = 0; node < numNodes; node++)
+		{
+			double d = i == 0 ? distances[node] : nearest[node];
+			if (d != HUGE_VAL && d > farthestDistance)
+			{
+				farthest = node;
+				farthestDistance = d;
+			}
+		}
+		// everything reachable is already a landmark (or sits right on one), so another would only
+		// repeat a column. a small map, or one in pieces, can end up with fewer than count
+		if (i > 0 && farthestDistance <= 0)
+			break;
+		m_landmarks.push_back(farthest);
+		distancesFrom(graph, farthest, distances);
+		for (uint32_t node = 0; node < numNodes; node++)
+			nearest[node] = min(nearest[node], distances[node]);
+		columns.push_back(distances);
+	}
+
+	m_distances.resize(numNodes * m_landmarks.size());
+	for (uint32_t node = 0; node < numNodes; node++)
+		for (size_t i = 0; i < m_landmarks.size(); i++)
+			m_distances[node * m_landmarks.size() + i] = columns[i][node];
+}
+
+void LandmarkTable::distancesFrom(const RoadGraph &graph, uint32_t start, vector<double> &distances)
+{
+	distances.assign(graph.getNumNodes(), HUGE_VAL);
+	typedef pair<double, uint32_t> Waiting; // distance, node
+	priority_queue<Waiting, vector<Waiting>, greater<Waiting>> open;
+	distances[start] = 0;
+	open.push(Waiting(0, start));
+	while (!open.empty())
+	{
+		Waiting current = open.top();
+		open.pop();
+		if (current.first > distances[current.second]) // stale, it was reached faster since
+			continue;
+		for (const RoadEdge *edge = graph.edgesBegin(current.second), *end = graph.edgesEnd(current.second); edge != end; edge++)
+		{
+			double d = current.first + edge->length;
+			if (d < distances[edge->target])
+			{
+				distances[edge->target] = d;
+				open.push(Waiting(d, edge->target));
+			}
+		}
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef LANDMARK_TABLE_H
+#define LANDMARK_TABLE_H
+
+#include "provided.h"
+#include "RoadGraph.h"
+#include <vector>
+#include <cstdint>
+
+// Distances from a handful of landmark nodes to every node of a RoadGraph, for A*'s heuristic
+// (the ALT technique: A*, landmarks, triangle inequality). If a landmark L is d(L, t) from the
+// target and d(L, v) from node v, then getting from v to t takes at least |d(L, t) - d(L, v)|, or
+// there'd be a shorter way from L to one of them by way of the other. Where the streets wind, as
+// up a canyon, that's a much better guess than the straight line, and it's still never too much.
+//
+// The distances are over every edge, attraction edges included, so they're never longer than what
+// a search that leaves some of those out could find. Every edge has a twin going the other way,
+// so distances from a landmark are distances to it too, and one table does for both.
+//
+// Landmarks are picked the "farthest" way: the first is the node farthest from node 0, and each
+// one after it is whichever node is farthest from all the landmarks picked so far. That puts them
+// around the edge of the map, behind the nodes they'll be guessing about.
+class LandmarkTable
+{
+public:
+	LandmarkTable() {}
+	// throws away whatever was there, picks up to count landmarks and finds every node's distance
+	// to each of them. it stops early once every node it can reach is already a landmark
+	void build(const RoadGraph &graph, size_t count);
+
+	size_t size() const { return m_landmarks.size(); }
+	uint32_t landmark(size_t i) const { return m_landmarks[i]; }
+	// the shortest distance between node and landmark i, HUGE_VAL if there's no way between them
+	double distance(uint32_t node, size_t i) const { return m_distances[node * m_landmarks.size() + i]; }
+	// the least distance from node to other that landmark i proves
+	double lowerBound(uint32_t node, uint32_t other, size_t i) const { return difference(distance(other, i), distance(node, i)); }
+	// |a - b| for two distances from the same landmark. if neither can be reached from it, it says
+	// nothing about them, so that's 0. if only one can, they can't reach each other, so it's HUGE_VAL
+	static double difference(double a, double b) { return a == b ? 0 : a > b ? a - b : b - a; }
+
+	LandmarkTable(const LandmarkTable&) = delete;
+	LandmarkTable& operator=(const LandmarkTable&) = delete;
+private:
+	std::vector<uint32_t> m_landmarks;
+	std::vector<double> m_distances; // a row per node, a column per landmark, so a node's are all together
+
+	// fills distances with every node's distance from start
+	static void distancesFrom(const RoadGraph &graph, uint32_t start, std::vector<double> &distances);
+};
+
+#endif // for LANDMARK_TABLE_H
@@ -1,7 +1,17 @@
 #include "provided.h"
+#include "support.h"
+#include "MapSnapshot.h"
+#include "RoadGraph.h"
+#include "SpatialIndex.h"
 #include <string>
-#include <fstream>
-#include <iostream>
+#include <vector>
+#include <cstring>
+#include <cctype>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <memory>
+#include <atomic>
 using namespace std;
 
 class MapLoaderImpl
@@ -10,124 +20,634 @@ public:
 	MapLoaderImpl();
 	~MapLoaderImpl();
 	bool load(string mapFile);
+	void loadFrom(const MapLoaderImpl &other);
+	size_t getNumPatched() const;
+	void compact();
+	void setLoadThreads(unsigned numThreads);
 	size_t getNumSegments() const;
 	bool getSegment(size_t segNum, StreetSegment& seg) const;
+	const StreetSegment* getSegment(size_t segNum) const;
+	bool saveSnapshot(const MapLoader &ml, string snapshotFile) const;
+	const MapSnapshot* getSnapshot() const;
+	bool readPatch(string patchFile, vector<MapPatchOp> &ops) const;
+	bool applyPatchOp(const MapPatchOp &op, size_t segNum, vector<MapChange> &changes);
 private:
+	// a snapshot's segments are made from it this many at a time, the first time one of them is asked for
+	static const size_t SEGMENTS_PER_PAGE = 64;
+	struct SegmentPage
+	{
+		StreetSegment segments[SEGMENTS_PER_PAGE];
+	};
+	// what load read. loaders made with loadFrom share it, so it never changes once it's loaded
+	// (apart from a snapshot's pages being made, which nobody can tell from the outside)
+	struct LoadedMap
+	{
+		LoadedMap() : snapshot(nullptr), numPages(0) {}
+		~LoadedMap();
+		vector<StreetSegment> segmentVector; // empty when the map came from a snapshot
+		MapSnapshot* snapshot; // only set when the map came from a compiled snapshot
+		// the snapshot's segments, for the pages that have been made so far. threads asking for
+		// the same page at once each make it, and the first one stored is the one everybody keeps
+		unique_ptr<atomic<SegmentPage*>[]> pages;
+		size_t numPages;
+
+		const StreetSegment* segment(size_t segNum) const
+		{
+			if (snapshot == nullptr)
+				return &segmentVector[segNum];
+			SegmentPage* page = pages[segNum / SEGMENTS_PER_PAGE].load(memory_order_acquire);
+			if (page == nullptr)
+				page = makePage(segNum / SEGMENTS_PER_PAGE);
+			return &page->segments[segNum % SEGMENTS_PER_PAGE];
+		}
+		SegmentPage* makePage(size_t pageNum) const;
+	};
+	shared_ptr<const LoadedMap> m_loaded;
+	// the segments patches have added or replaced, by number, sorted. every other number below
+	// m_numSegments is still the loaded segment. patched segments never change either, a later
+	// patch replaces them again, so they can be shared with other loaders too
+	typedef pair<size_t, shared_ptr<const StreetSegment>> PatchedSegment;
+	vector<PatchedSegment> m_patched;
 	size_t m_numSegments;
-	vector<StreetSegment> segmentVector;
+	unsigned m_numThreads; // 0 means one per core
+
+	// segment segNum, for putting in m_patched. a loaded one is shared along with the whole map
+	shared_ptr<const StreetSegment> shareSegment(size_t segNum) const;
+	void setPatched(size_t segNum, const shared_ptr<const StreetSegment> &seg);
+	// where segNum is in m_patched, or would go
+	size_t patchedPosition(size_t segNum) const
+	{
+		return lower_bound(m_patched.begin(), m_patched.end(), segNum, [](const PatchedSegment &p, size_t n) { return p.first < n; }) - m_patched.begin();
+	}
+	void erasePatched(size_t segNum);
+
+	bool loadSnapshot(const string &snapshotFile);
+	size_t numChunksFor(size_t fileSize) const;
+	static bool splitIntoChunks(const char* begin, const char* end, size_t numChunks, vector<const char*> &bounds);
+	static bool skipRecord(const char* &cur, const char* end);
+	static MapChange makeChange(MapChange::ChangeType type, size_t segNum, const StreetSegment &seg);
+	static bool sameIgnoringCase(const string &a, const string &b);
+	static bool parseChunk(const char* cur, const char* end, vector<StreetSegment> &segments);
+	static bool parseCount(const char* &cur, const char* end, int &count);
+
+	static bool parseRecord(const char* &cur, const char* end, StreetSegment &seg, const StreetSegment* previous);
+	static bool parseStreetLines(const char* &cur, const char* end, StreetSegment &seg, const StreetSegment* previous);
+	static bool parseAttraction(const char* &cur, const char* end, Attraction &attraction);
+	static bool parseCoord(const char* &cur, const char* end, char terminator, GeoCoord &gc);
+	static bool skipTo(const char* &cur, const char* end, char target);
+	static bool isBlank(const char* cur, const char* end);
+	static void skipLine(const char* &cur, const char* end);
+	static size_t lineLength(const char* lineStart, const char* cur);
 };
 
 MapLoaderImpl::MapLoaderImpl()
-	: m_numSegments(0) // just to be safe
+	: m_loaded(make_shared<LoadedMap>()), m_numSegments(0), m_numThreads(0) // just to be safe
 {
 }
 
-MapLoaderImpl::~MapLoaderImpl() // nothing to do because no dynamic memory allocation or pointers
+MapLoaderImpl::~MapLoaderImpl()
 {
 }
 
 bool MapLoaderImpl::load(string mapFile)
 {
-	ifstream loader(mapFile);
-	if (!loader) // if file is bad, this is true
+	m_loaded = make_shared<LoadedMap>(); // start fresh in case load gets called more than once
+	m_patched.clear();
+	m_numSegments = 0;
+
+	if (MapSnapshot::isSnapshot(mapFile))
+		return loadSnapshot(mapFile);
+
+	MappedFile file;
+	if (!file.open(mapFile)) // if file is bad, this is true
 		return false;
-	else
+
+	// the whole file is in memory, so cut it into runs of whole records and parse each run on its
+	// own thread. each field is copied straight from the buffer, no characters are pulled from a stream.
+	vector<const char*> bounds;
+	if (!splitIntoChunks(file.data(), file.data() + file.size(), numChunksFor(file.size()), bounds))
+		return false;
+	size_t numChunks = bounds.size() - 1;
+	vector<vector<StreetSegment>> chunks(numChunks);
+	vector<char> parsedOk(numChunks, false);
+	vector<thread> workers;
+	for (size_t c = 1; c < numChunks; c++)
+		workers.emplace_back([&bounds, &chunks, &parsedOk, c]() {
+			parsedOk[c] = parseChunk(bounds[c], bounds[c + 1], chunks[c]);
+		});
+	parsedOk[0] = parseChunk(bounds[0], bounds[1], chunks[0]); // this thread takes the first chunk itself
+	for (size_t w = 0; w < workers.size(); w++)
+		workers[w].join();
+
+	// stitch the chunks back together in file order
+	size_t total = 0;
+	for (size_t c = 0; c < numChunks; c++)
+	{
+		if (!parsedOk[c])
+			return false; // don't leave a half loaded map behind
+		total += chunks[c].size();
+	}
+	shared_ptr<LoadedMap> loaded = make_shared<LoadedMap>();
+	vector<StreetSegment> &segmentVector = loaded->segmentVector;
+	segmentVector.reserve(total);
+	for (size_t c = 0; c < numChunks; c++)
 	{
-		segmentVector.resize(20000); // only expand the vector if file loaded correctly
-		string input, streetName, attractionName;
-		int numAttractions = 0;
-		string latitude, longitude;
-		while (getline(loader, input))
+		for (size_t i = 0; i < chunks[c].size(); i++)
+			segmentVector.push_back(std::move(chunks[c][i]));
+		vector<StreetSegment>().swap(chunks[c]); // free each chunk as soon as it's been moved out
+	}
+
+	m_numSegments = segmentVector.size();
+	m_loaded = loaded;
+	return true; // file was loaded successfully
+}
+
+void MapLoaderImpl::loadFrom(const MapLoaderImpl &other)
+{
+	m_loaded = other.m_loaded;
+	m_patched = other.m_patched; // just pointers, the segments stay where they are
+	m_numSegments = other.m_numSegments;
+}
+
+size_t MapLoaderImpl::getNumPatched() const
+{
+	return m_patched.size();
+}
+
+void MapLoaderImpl::compact()
+{
+	shared_ptr<LoadedMap> loaded = make_shared<LoadedMap>();
+	loaded->segmentVector.reserve(m_numSegments);
+	for (size_t segNum = 0; segNum < m_numSegments; segNum++)
+		loaded->segmentVector.push_back(*getSegment(segNum));
+	m_loaded = loaded;
+	m_patched.clear();
+}
+
+void MapLoaderImpl::setLoadThreads(unsigned numThreads)
+{
+	m_numThreads = numThreads;
+}
+
+// how many chunks to cut a file of this size into. small files aren't worth starting threads for.
+// one thread parses about 60 MB/s, so a 256 KB chunk is ~4 ms of work against ~10 us to start and
+// join its thread; the split costs well under 1% even at the minimum, and mapdata.txt still gets
+// five chunks. bench/loadbench.cpp sweeps the thread counts
+size_t MapLoaderImpl::numChunksFor(size_t fileSize) const
+{
+	const size_t MIN_CHUNK_BYTES = 256 * 1024;
+	size_t numThreads = m_numThreads;
+	if (numThreads == 0)
+		numThreads = max(1u, thread::hardware_concurrency());
+	return max<size_t>(1, min(numThreads, fileSize / MIN_CHUNK_BYTES));
+}
+
+// fills bounds with numChunks + 1 pointers (fewer if the file is short) so that every chunk starts
+// at the street name line of a record. finding the boundaries only needs the line structure and the
+// attraction counts, so this pass is much cheaper than actually parsing.
+bool MapLoaderImpl::splitIntoChunks(const char* begin, const char* end, size_t numChunks, vector<const char*> &bounds)
+{
+	bounds.clear();
+	bounds.push_back(begin);
+	if (numChunks > 1)
+	{
+		size_t targetBytes = (end - begin) / numChunks;
+		const char* nextCut = begin + targetBytes;
+		const char* cur = begin;
+		while (cur != end && !isBlank(cur, end) && bounds.size() < numChunks)
 		{
-			streetName = input;
-			segmentVector[m_numSegments].streetName = streetName; // add street name to segment
+			if (cur >= nextCut)
+			{
+				bounds.push_back(cur);
+				nextCut = cur + targetBytes;
+			}
+			if (!skipRecord(cur, end))
+				return false;
+		}
+	}
+	bounds.push_back(end);
+	return true;
+}
+
+// moves cur past one record without building anything
+bool MapLoaderImpl::skipRecord(const char* &cur, const char* end)
+{
+	skipLine(cur, end); // street name
+	skipLine(cur, end); // both coordinates
+	int numAttractions = 0;
+	if (!parseCount(cur, end, numAttractions))
+		return false;
+	for (int i = 0; i < numAttractions; i++)
+	{
+		if (cur == end)
+			return false;
+		skipLine(cur, end);
+	}
+	return true;
+}
 
-			latitude = longitude = "";
-			char ch;
-			loader.get(ch);
-			while (ch != ',') // get latitude
+// parses every record between cur and end. run on a worker thread, so it reports any
+// failure (including a coordinate stod can't convert) through its return value
+bool MapLoaderImpl::parseChunk(const char* cur, const char* end, vector<StreetSegment> &segments)
+{
+	try
+	{
+		while (cur != end)
+		{
+			if (isBlank(cur, end)) // trailing blank lines at the end of the file aren't records
+				break;
+			segments.emplace_back();
+			const StreetSegment* previous = segments.size() >= 2 ? &segments[segments.size() - 2] : nullptr;
+			if (!parseRecord(cur, end, segments.back(), previous))
+				return false;
+		}
+	}
+	catch (const exception&)
+	{
+		return false;
+	}
+	return true;
+}
+
+MapLoaderImpl::LoadedMap::~LoadedMap()
+{
+	for (size_t pageNum = 0; pageNum < numPages; pageNum++)
+		delete pages[pageNum].load(memory_order_relaxed);
+	delete snapshot;
+}
+
+MapLoaderImpl::SegmentPage* MapLoaderImpl::LoadedMap::makePage(size_t pageNum) const
+{
+	SegmentPage* made = new SegmentPage;
+	size_t first = pageNum * SEGMENTS_PER_PAGE;
+	for (size_t i = 0; i < SEGMENTS_PER_PAGE && first + i < snapshot->getNumSegments(); i++)
+		snapshot->getSegment(first + i, made->segments[i]);
+	SegmentPage* expected = nullptr;
+	if (pages[pageNum].compare_exchange_strong(expected, made, memory_order_acq_rel, memory_order_acquire))
+		return made;
+	delete made; // somebody else got there first
+	return expected;
+}
+
+// a compiled snapshot stays mapped for as long as the loader lives so the mappers can search its
+// indexes in place. nothing is copied out of it up front: a segment is made from its records the
+// first time it's asked for, along with the rest of its page, so loading only costs as much as
+// opening the file
+bool MapLoaderImpl::loadSnapshot(const string &snapshotFile)
+{
+	MapSnapshot* snapshot = new MapSnapshot;
+	if (!snapshot->open(snapshotFile))
+	{
+		delete snapshot;
+		return false;
+	}
+	shared_ptr<LoadedMap> loaded = make_shared<LoadedMap>();
+	loaded->snapshot = snapshot;
+	loaded->numPages = (snapshot->getNumSegments() + SEGMENTS_PER_PAGE - 1) / SEGMENTS_PER_PAGE;
+	loaded->pages.reset(new atomic<SegmentPage*>[loaded->numPages]);
+	for (size_t pageNum = 0; pageNum < loaded->numPages; pageNum++)
+		loaded->pages[pageNum].store(nullptr, memory_order_relaxed);
+	m_numSegments = snapshot->getNumSegments();
+	m_loaded = loaded;
+	return true;
+}
+
+// ml is the loader this is the inside of. the graph and the spatial index are built for it here,
+// once, so every load of the snapshot can read them instead of building them again
+bool MapLoaderImpl::saveSnapshot(const MapLoader &ml, string snapshotFile) const
+{
+	SegmentMapper sm;
+	sm.init(ml);
+	RoadGraph graph;
+	graph.build(ml, sm);
+	SpatialIndex spatial;
+	spatial.build(ml);
+	// removing the last segment patches nothing, but leaves the loaded map one too long
+	if (m_patched.empty() && m_loaded->snapshot == nullptr && m_numSegments == m_loaded->segmentVector.size())
+		return MapSnapshot::write(m_loaded->segmentVector, graph, spatial, snapshotFile);
+	vector<StreetSegment> segments; // the patched map only exists a segment at a time, so gather it up
+	segments.reserve(m_numSegments);
+	for (size_t segNum = 0; segNum < m_numSegments; segNum++)
+		segments.push_back(*getSegment(segNum));
+	return MapSnapshot::write(segments, graph, spatial, snapshotFile);
+}
+
+const MapSnapshot* MapLoaderImpl::getSnapshot() const
+{
+	return m_loaded->snapshot;
+}
+
+// A patch file is a list of ops. Each op is a line naming it followed by lines in the same
+// format the map data file uses:
+//
+//   add segment          a whole record: street name, coordinates, attraction count, attraction lines
+//   remove segment       the street name and coordinate lines of the segment to remove
+//   add attraction       the street name and coordinate lines of a segment, then one attraction line
+//   remove attraction    one line with the attraction's name (matched ignoring case)
+//
+// Blank lines and lines starting with # are allowed between ops.
+bool MapLoaderImpl::readPatch(string patchFile, vector<MapPatchOp> &ops) const
+{
+	ops.clear();
+	MappedFile file;
+	if (!file.open(patchFile))
+		return false;
+
+	const char* cur = file.data();
+	const char* end = cur + file.size();
+	try
+	{
+		while (cur != end)
+		{
+			const char* line = cur;
+			skipLine(cur, end);
+			string keyword(line, lineLength(line, cur));
+			while (!keyword.empty() && isspace(static_cast<unsigned char>(keyword.back()))) // tolerate \r and trailing spaces
+				keyword.pop_back();
+			if (keyword.empty() || keyword[0] == '#')
+				continue;
+
+			MapPatchOp op;
+			bool parsed;
+			if (keyword == "add segment")
 			{
-				latitude += ch;
-				loader.get(ch);
+				op.type = MapPatchOp::ADD_SEGMENT;
+				parsed = parseRecord(cur, end, op.segment, nullptr);
 			}
-			loader.get(ch);
-			while (ch == ' ') // consume any empty space between
+			else if (keyword == "remove segment")
 			{
-				loader.get(ch);
+				op.type = MapPatchOp::REMOVE_SEGMENT;
+				parsed = parseStreetLines(cur, end, op.segment, nullptr);
 			}
-			while (ch != ' ') // get longitude
+			else if (keyword == "add attraction")
 			{
-				longitude += ch;
-				loader.get(ch);
+				op.type = MapPatchOp::ADD_ATTRACTION;
+				parsed = parseStreetLines(cur, end, op.segment, nullptr) && parseAttraction(cur, end, op.attraction);
 			}
-
-			GeoCoord start(latitude, longitude);
-			segmentVector[m_numSegments].segment.start = start; // add start GeoCoord
-
-			latitude = longitude = "";
-			loader.get(ch);
-			while (ch != ',') // get latitude
+			else if (keyword == "remove attraction")
 			{
-				latitude += ch;
-				loader.get(ch);
+				op.type = MapPatchOp::REMOVE_ATTRACTION;
+				line = cur;
+				skipLine(cur, end);
+				op.attraction.name = Name(line, lineLength(line, cur));
+				parsed = !op.attraction.name.empty();
 			}
-			loader.get(ch);
-			while (ch == ' ') // consume any empty space
+			else
+				parsed = false;
+
+			if (!parsed)
 			{
-				loader.get(ch);
+				ops.clear();
+				return false;
 			}
-			while (ch != '\n') // get longitude
+			ops.push_back(op);
+		}
+	}
+	catch (const exception&) // stod couldn't make sense of a coordinate
+	{
+		ops.clear();
+		return false;
+	}
+	return true;
+}
+
+// segments are never changed where they are. one that's patched is copied, changed and put in
+// m_patched, so any other loader still sharing the old one sees no difference
+bool MapLoaderImpl::applyPatchOp(const MapPatchOp &op, size_t segNum, vector<MapChange> &changes)
+{
+	if (op.type == MapPatchOp::ADD_SEGMENT) // new segments always go on the end
+	{
+		m_patched.push_back(PatchedSegment(m_numSegments, make_shared<const StreetSegment>(op.segment))); // still in order
+		m_numSegments++;
+		changes.push_back(makeChange(MapChange::SEGMENT_ADDED, m_numSegments - 1, op.segment));
+		return true;
+	}
+	if (segNum >= m_numSegments)
+		return false;
+
+	const StreetSegment &seg = *getSegment(segNum);
+	switch (op.type)
+	{
+	case MapPatchOp::REMOVE_SEGMENT:
+	{
+		changes.push_back(makeChange(MapChange::SEGMENT_REMOVED, segNum, seg));
+		// fill the hole with the last segment instead of shifting everything after it down,
+		// so only one other segment gets a new number
+		size_t last = m_numSegments - 1;
+		if (segNum != last)
+		{
+			setPatched(segNum, shareSegment(last));
+			changes.push_back(makeChange(MapChange::SEGMENT_MOVED, segNum, *getSegment(segNum)));
+			changes.back().fromSegNum = last;
+		}
+		erasePatched(last);
+		m_numSegments--;
+		return true;
+	}
+	case MapPatchOp::ADD_ATTRACTION:
+	{
+		shared_ptr<StreetSegment> patched = make_shared<StreetSegment>(seg);
+		patched->attractions.push_back(op.attraction);
+		setPatched(segNum, patched);
+		changes.push_back(makeChange(MapChange::ATTRACTION_ADDED, segNum, *patched));
+		changes.back().attraction = op.attraction;
+		return true;
+	}
+	case MapPatchOp::REMOVE_ATTRACTION:
+		for (size_t i = 0; i < seg.attractions.size(); i++)
+		{
+			if (sameIgnoringCase(seg.attractions[i].name, op.attraction.name))
 			{
-				longitude += ch;
-				loader.get(ch);
+				Attraction removed = seg.attractions[i];
+				shared_ptr<StreetSegment> patched = make_shared<StreetSegment>(seg);
+				patched->attractions.erase(patched->attractions.begin() + i);
+				setPatched(segNum, patched);
+				changes.push_back(makeChange(MapChange::ATTRACTION_REMOVED, segNum, *patched));
+				changes.back().attraction = removed;
+				return true;
 			}
-			GeoCoord end(latitude, longitude);
-			segmentVector[m_numSegments].segment.end = end; // add end GeoCoord
+		}
+		return false; // that segment doesn't have the attraction
+	default:
+		return false;
+	}
+}
+
+shared_ptr<const StreetSegment> MapLoaderImpl::shareSegment(size_t segNum) const
+{
+	size_t i = patchedPosition(segNum);
+	if (i < m_patched.size() && m_patched[i].first == segNum)
+		return m_patched[i].second;
+	// points into the loaded map, and keeps all of it alive for as long as it's around
+	return shared_ptr<const StreetSegment>(m_loaded, m_loaded->segment(segNum));
+}
 
+void MapLoaderImpl::setPatched(size_t segNum, const shared_ptr<const StreetSegment> &seg)
+{
+	size_t i = patchedPosition(segNum);
+	if (i < m_patched.size() && m_patched[i].first == segNum)
+		m_patched[i].second = seg;
+	else
+		m_patched.insert(m_patched.begin() + i, PatchedSegment(segNum, seg));
+}
 
-			loader >> numAttractions; // read in number of attractions
-			loader.ignore(10000, '\n');
+void MapLoaderImpl::erasePatched(size_t segNum)
+{
+	size_t i = patchedPosition(segNum);
+	if (i < m_patched.size() && m_patched[i].first == segNum)
+		m_patched.erase(m_patched.begin() + i);
+}
 
-			for (int i = 0; i < numAttractions; i++) // look at all attractions
-			{
-				loader.get(ch);
-				attractionName = "";
-				while (ch != '|') // read in attraction name, char by char
-				{
-					attractionName += ch;
-					loader.get(ch);
-				}
-
-				latitude = longitude = "";
-				loader.get(ch);
-				while (ch != ',') // read in latitude
-				{
-					latitude += ch;
-					loader.get(ch);
-				}
-				loader.get(ch);
-				while (ch == ' ')
-				{
-					loader.get(ch);
-				}
-				while (ch != '\n') // read in longitude
-				{
-					longitude += ch;
-					loader.get(ch);
-				}
-
-				GeoCoord attractionLoc(latitude, longitude);
-
-				Attraction newAttraction; // make an attraction
-				newAttraction.name = attractionName; // initialize name
-				newAttraction.geocoordinates = attractionLoc; // initialize geocoord
-				segmentVector[m_numSegments].attractions.push_back(newAttraction); // add to vector
-			} // end for
-			m_numSegments++; // increment segment count
-		} // end while
-	} // end else
+MapChange MapLoaderImpl::makeChange(MapChange::ChangeType type, size_t segNum, const StreetSegment &seg)
+{
+	MapChange change;
+	change.type = type;
+	change.segNum = segNum;
+	change.fromSegNum = segNum;
+	change.segment = seg;
+	return change;
+}
 
-	return true; // file was loaded successfully
+bool MapLoaderImpl::sameIgnoringCase(const string &a, const string &b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++)
+		if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i])))
+			return false;
+	return true;
+}
+
+// parses one street segment record (name line, coordinate line, attraction count, attraction lines)
+// starting at cur and leaves cur at the start of the next record. returns false if the record is cut off.
+// previous is the record parsed just before this one (or nullptr), used to skip re-interning the street name.
+bool MapLoaderImpl::parseRecord(const char* &cur, const char* end, StreetSegment &seg, const StreetSegment* previous)
+{
+	if (!parseStreetLines(cur, end, seg, previous))
+		return false;
+
+	int numAttractions = 0;
+	if (!parseCount(cur, end, numAttractions))
+		return false;
+
+	seg.attractions.resize(numAttractions);
+	for (int i = 0; i < numAttractions; i++) // look at all attractions
+		if (!parseAttraction(cur, end, seg.attractions[i]))
+			return false;
+	return true;
+}
+
+// the street name line and the coordinate line that start every record
+bool MapLoaderImpl::parseStreetLines(const char* &cur, const char* end, StreetSegment &seg, const StreetSegment* previous)
+{
+	const char* field = cur;
+	skipLine(cur, end); // street name is the whole line
+	size_t nameLength = lineLength(field, cur);
+	// a street is usually a run of consecutive segments, so only go to the name table when it changes
+	if (previous != nullptr && previous->streetName.str().size() == nameLength &&
+		memcmp(previous->streetName.str().data(), field, nameLength) == 0)
+		seg.streetName = previous->streetName;
+	else
+		seg.streetName = Name(field, nameLength);
+
+	if (!parseCoord(cur, end, ' ', seg.segment.start)) // start coord ends at the space between coords
+		return false;
+	return parseCoord(cur, end, '\n', seg.segment.end); // end coord ends the line
+}
+
+// one "name|lat, lon" attraction line
+bool MapLoaderImpl::parseAttraction(const char* &cur, const char* end, Attraction &attraction)
+{
+	const char* field = cur;
+	if (!skipTo(cur, end, '|')) // attraction name runs up to the bar
+		return false;
+	attraction.name = Name(field, cur - field);
+	cur++;
+	return parseCoord(cur, end, '\n', attraction.geocoordinates);
+}
+
+// reads the attraction count and moves cur past the rest of its line
+bool MapLoaderImpl::parseCount(const char* &cur, const char* end, int &count)
+{
+	count = 0;
+	while (cur != end && isspace(static_cast<unsigned char>(*cur))) // same whitespace skipping as operator>>
+		cur++;
+	if (cur == end || *cur < '0' || *cur > '9')
+		return false;
+	while (cur != end && *cur >= '0' && *cur <= '9' && count < 1000000)
+		count = count * 10 + (*cur++ - '0');
+	skipLine(cur, end); // ignore the rest of the count line
+	return true;
+}
+
+// reads "lat, lon" up to (and past) the terminator straight into gc. spaces after the comma are skipped.
+// a newline terminator is also satisfied by the end of the file.
+bool MapLoaderImpl::parseCoord(const char* &cur, const char* end, char terminator, GeoCoord &gc)
+{
+	string &latitude = gc.latitudeText;
+	string &longitude = gc.longitudeText;
+	const char* field = cur;
+	if (!skipTo(cur, end, ',') || cur - field > 64) // a comma way down the file means this isn't a coord line
+		return false;
+	latitude.assign(field, cur - field);
+	cur++;
+	while (cur != end && *cur == ' ') // consume any empty space between
+		cur++;
+	field = cur;
+	if (terminator == '\n')
+	{
+		skipLine(cur, end);
+		longitude.assign(field, lineLength(field, cur));
+	}
+	else
+	{
+		if (!skipTo(cur, end, terminator))
+			return false;
+		longitude.assign(field, cur - field);
+		cur++;
+	}
+	if (latitude.empty() || longitude.empty())
+		return false;
+	gc.latitude = stod(latitude); // same conversion the GeoCoord constructor does
+	gc.longitude = stod(longitude);
+	return true;
+}
+
+// moves cur forward to the next occurrence of target. returns false if the buffer runs out first
+bool MapLoaderImpl::skipTo(const char* &cur, const char* end, char target)
+{
+	const void* found = memchr(cur, target, end - cur);
+	if (found == nullptr)
+	{
+		cur = end;
+		return false;
+	}
+	cur = static_cast<const char*>(found);
+	return true;
+}
+
+// true if there's nothing but whitespace from cur to the end of the buffer
+bool MapLoaderImpl::isBlank(const char* cur, const char* end)
+{
+	for (; cur != end; cur++)
+		if (!isspace(static_cast<unsigned char>(*cur)))
+			return false;
+	return true;
+}
+
+// moves cur to the start of the next line (or the end of the buffer if this is the last line)
+void MapLoaderImpl::skipLine(const char* &cur, const char* end)
+{
+	if (skipTo(cur, end, '\n'))
+		cur++;
+}
+
+// length of the line that started at lineStart, given that cur was just moved past it by skipLine
+size_t MapLoaderImpl::lineLength(const char* lineStart, const char* cur)
+{
+	if (cur != lineStart && cur[-1] == '\n')
+		return cur - lineStart - 1;
+	return cur - lineStart;
 }
 
 size_t MapLoaderImpl::getNumSegments() const
@@ -141,11 +661,26 @@ bool MapLoaderImpl::getSegment(size_t segNum, StreetSegment &seg) const
 		return false;
 	else
 	{
-		seg = segmentVector[segNum];
+		seg = *getSegment(segNum);
 		return true;
 	}
 }
 
+// no copying here (past making a snapshot's page the first time). a map nothing has patched is
+// just the loaded segments, so that's all it looks at
+const StreetSegment* MapLoaderImpl::getSegment(size_t segNum) const
+{
+	if (segNum >= m_numSegments)
+		return nullptr;
+	if (!m_patched.empty())
+	{
+		size_t i = patchedPosition(segNum);
+		if (i < m_patched.size() && m_patched[i].first == segNum)
+			return m_patched[i].second.get();
+	}
+	return m_loaded->segment(segNum);
+}
+
 //******************** MapLoader functions ************************************
 
 // These functions simply delegate to MapLoaderImpl's functions.
@@ -166,6 +701,26 @@ bool MapLoader::load(string mapFile)
 	return m_impl->load(mapFile);
 }
 
+void MapLoader::loadFrom(const MapLoader& other)
+{
+	m_impl->loadFrom(*other.m_impl);
+}
+
+size_t MapLoader::getNumPatched() const
+{
+	return m_impl->getNumPatched();
+}
+
+void MapLoader::compact()
+{
+	m_impl->compact();
+}
+
+void MapLoader::setLoadThreads(unsigned numThreads)
+{
+	m_impl->setLoadThreads(numThreads);
+}
+
 size_t MapLoader::getNumSegments() const
 {
 	return m_impl->getNumSegments();
@@ -175,3 +730,29 @@ bool MapLoader::getSegment(size_t segNum, StreetSegment& seg) const
 {
 	return m_impl->getSegment(segNum, seg);
 }
+
+const StreetSegment* MapLoader::getSegment(size_t segNum) const
+{
+	return m_impl->getSegment(segNum);
+}
+
+
+bool MapLoader::saveSnapshot(string snapshotFile) const
+{
+	return m_impl->saveSnapshot(*this, snapshotFile);
+}
+
+const MapSnapshot* MapLoader::getSnapshot() const
+{
+	return m_impl->getSnapshot();
+}
+
+bool MapLoader::readPatch(string patchFile, vector<MapPatchOp>& ops) const
+{
+	return m_impl->readPatch(patchFile, ops);
+}
+
+bool MapLoader::applyPatchOp(const MapPatchOp& op, size_t segNum, vector<MapChange>& changes)
+{
+	return m_impl->applyPatchOp(op, segNum, changes);
+}
@@ -0,0 +1,515 @@
+#include "MapSnapshot.h"
+#include "RoadGraph.h"
+#include "SpatialIndex.h"
+#include "GeoMath.h"
+#include "MyMap.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+using namespace std;
+using namespace snapshot;
+
+namespace
+{
+	// builds up the string pool while the snapshot is being written. identical strings share storage
+	class StringPoolBuilder
+	{
+	public:
+		StringRef add(const string &text)
+		{
+			pair<StringRef*, bool> slot = m_refs.emplace(text);
+			if (!slot.second) // already pooled
+				return *slot.first;
+			slot.first->offset = static_cast<uint32_t>(m_pool.size());
+			slot.first->length = static_cast<uint32_t>(text.size());
+			m_pool += text;
+			return *slot.first;
+		}
+		const string& pool() const { return m_pool; }
+	private:
+		string m_pool;
+		MyMap<string, StringRef> m_refs;
+	};
+
+	size_t alignedSize(size_t bytes)
+	{
+		return (bytes + 7) & ~static_cast<size_t>(7); // every section starts on an 8 byte boundary
+	}
+
+	// Records is a vector or a FlatArray
+	template<typename Records>
+	void setSection(Header &header, SectionId id, const Records &records, uint64_t &offset)
+	{
+		header.sections[id].offset = offset;
+		header.sections[id].count = records.size();
+		offset += alignedSize(records.size() * sizeof(*records.data()));
+	}
+
+	template<typename Records>
+	void writeSection(ofstream &out, const Records &records)
+	{
+		static const char zeros[8] = { 0 };
+		size_t bytes = records.size() * sizeof(*records.data());
+		if (bytes != 0)
+			out.write(reinterpret_cast<const char*>(records.data()), bytes);
+		out.write(zeros, alignedSize(bytes) - bytes);
+	}
+
+	// Section::count is untrusted, so check it against the file before multiplying it out
+	bool sectionFits(const Section &section, size_t recordSize, size_t fileSize)
+	{
+		if (section.offset > fileSize || section.offset % 8 != 0)
+			return false;
+		return section.count <= (fileSize - section.offset) / recordSize;
+	}
+}
+
+MapSnapshot::MapSnapshot()
+	: m_header(nullptr), m_strings(nullptr), m_coords(nullptr), m_segments(nullptr), m_attractions(nullptr),
+	m_coordIndex(nullptr), m_coordIndexSegs(nullptr),
+	m_numStrings(0), m_numCoords(0), m_numSegments(0), m_numAttractions(0),
+	m_numCoordIndex(0), m_numCoordIndexSegs(0)
+{
+}
+
+bool MapSnapshot::isSnapshot(const string &fileName)
+{
+	ifstream in(fileName, ios::binary);
+	char magic[sizeof(MAGIC)];
+	if (!in.read(magic, sizeof(magic)))
+		return false;
+	return memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+bool MapSnapshot::write(const vector<StreetSegment> &segments, const RoadGraph &graph, const SpatialIndex &spatial, const string &fileName)
+{
+	StringPoolBuilder strings;
+	vector<CoordRecord> coords;
+	vector<SegmentRecord> segmentRecords;
+	vector<AttractionRecord> attractions;
+	vector<vector<uint32_t>> segmentsOfCoord; // parallel to coords
+	vector<pair<pair<unsigned, uint64_t>, uint32_t>> attractionKeys; // (name, coordinate), attraction number
+	MyMap<CoordKey, uint32_t> coordNumbers;
+
+	// gives every distinct coordinate one CoordRecord and returns its number
+	auto addCoord = [&](const GeoCoord &gc) -> uint32_t {
+		pair<uint32_t*, bool> slot = coordNumbers.emplace(CoordKey(gc), static_cast<uint32_t>(coords.size()));
+		if (!slot.second) // seen it before
+			return *slot.first;
+		CoordRecord record;
+		record.latitudeText = strings.add(gc.latitudeText);
+		record.longitudeText = strings.add(gc.longitudeText);
+		record.latitude = gc.latitude;
+		record.longitude = gc.longitude;
+		coords.push_back(record);
+		segmentsOfCoord.emplace_back();
+		return *slot.first;
+	};
+
+	// same traversal SegmentMapper::init does, so each coordinate lists its segments in the same order
+	for (size_t segNum = 0; segNum < segments.size(); segNum++)
+	{
+		const StreetSegment &seg = segments[segNum];
+		SegmentRecord record;
+		record.streetName = strings.add(seg.streetName);
+		record.start = addCoord(seg.segment.start);
+		record.end = addCoord(seg.segment.end);
+		record.firstAttraction = static_cast<uint32_t>(attractions.size());
+		record.numAttractions = static_cast<uint32_t>(seg.attractions.size());
+		segmentsOfCoord[record.start].push_back(static_cast<uint32_t>(segNum));
+		segmentsOfCoord[record.end].push_back(static_cast<uint32_t>(segNum));
+		for (size_t j = 0; j < seg.attractions.size(); j++)
+		{
+			AttractionRecord attraction;
+			attraction.name = strings.add(seg.attractions[j].name);
+			attraction.coord = addCoord(seg.attractions[j].geocoordinates);
+			attraction.padding = 0;
+			segmentsOfCoord[attraction.coord].push_back(static_cast<uint32_t>(segNum));
+			attractionKeys.push_back(make_pair(make_pair(seg.attractions[j].name.id(), CoordKey(seg.attractions[j].geocoordinates).bits()),
+				static_cast<uint32_t>(attractions.size())));
+			attractions.push_back(attraction);
+		}
+		segmentRecords.push_back(record);
+	}
+
+	// coordinate index. freezing coordNumbers hands back every coordinate already sorted by key
+	FrozenMap<CoordKey, uint32_t> sortedCoords;
+	coordNumbers.freeze(sortedCoords);
+	vector<CoordIndexRecord> coordIndex;
+	vector<uint32_t> coordIndexSegs;
+	for (int i = 0; i < sortedCoords.size(); i++)
+	{
+		uint32_t coordNum = sortedCoords.valueAt(i);
+		CoordIndexRecord record;
+		record.key = sortedCoords.keyAt(i).bits();
+		record.coord = coordNum;
+		record.firstSegment = static_cast<uint32_t>(coordIndexSegs.size());
+		record.numSegments = static_cast<uint32_t>(segmentsOfCoord[coordNum].size());
+		record.padding = 0;
+		coordIndexSegs.insert(coordIndexSegs.end(), segmentsOfCoord[coordNum].begin(), segmentsOfCoord[coordNum].end());
+		coordIndex.push_back(record);
+	}
+
+	// the graph, node by node. a node is found through the coordinate index, so its number has to
+	// be its coordinate's, which it is as long as the graph numbered them in map order too
+	if (graph.getNumNodes() != coords.size())
+		return false;
+	vector<uint64_t> graphKeys;
+	vector<GeoPoint> graphPoints;
+	vector<uint8_t> attractionNodes;
+	vector<uint32_t> firstEdge;
+	vector<RoadEdge> edges;
+	for (uint32_t node = 0; node < coords.size(); node++)
+	{
+		const uint32_t* coordNum = sortedCoords.find(graph.getKey(node));
+		if (coordNum == nullptr || *coordNum != node)
+			return false;
+		graphKeys.push_back(graph.getKey(node).bits());
+		graphPoints.push_back(graph.getPoint(node));
+		attractionNodes.push_back(graph.hasAttraction(node) ? 1 : 0);
+		firstEdge.push_back(static_cast<uint32_t>(edges.size()));
+		edges.insert(edges.end(), graph.edgesBegin(node), graph.edgesEnd(node));
+	}
+	firstEdge.push_back(static_cast<uint32_t>(edges.size()));
+
+	// the spatial index's arrays go out as they are. its attractions are copies, so those are
+	// written as the attraction records they're copies of: the first with the same name and place
+	const SpatialIndex::Built &built = *spatial.m_built;
+	GridRecord grid = { built.minLatitude, built.minLongitude, built.cellHeight, built.cellWidth, built.rows, built.columns };
+	vector<GridRecord> gridRecord(1, grid);
+	sort(attractionKeys.begin(), attractionKeys.end());
+	vector<uint32_t> spatialAttractions;
+	for (const Attraction &a : built.attractions)
+	{
+		pair<unsigned, uint64_t> key(a.name.id(), CoordKey(a.geocoordinates).bits());
+		auto found = lower_bound(attractionKeys.begin(), attractionKeys.end(), make_pair(key, 0u));
+		if (found == attractionKeys.end() || found->first != key)
+			return false;
+		spatialAttractions.push_back(found->second);
+	}
+
+	const string &pool = strings.pool();
+	if (pool.size() > UINT32_MAX)
+		return false; // StringRefs are 32 bit
+
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.byteOrderMark = BYTE_ORDER_MARK;
+	uint64_t offset = alignedSize(sizeof(Header));
+	header.sections[STRINGS].offset = offset;
+	header.sections[STRINGS].count = pool.size();
+	offset += alignedSize(pool.size());
+	setSection(header, COORDS, coords, offset);
+	setSection(header, SEGMENTS, segmentRecords, offset);
+	setSection(header, ATTRACTIONS, attractions, offset);
+	setSection(header, COORD_INDEX, coordIndex, offset);
+	setSection(header, COORD_INDEX_SEGS, coordIndexSegs, offset);
+	setSection(header, GRAPH_KEYS, graphKeys, offset);
+	setSection(header, GRAPH_POINTS, graphPoints, offset);
+	setSection(header, GRAPH_ATTRACTION_NODES, attractionNodes, offset);
+	setSection(header, GRAPH_FIRST_EDGE, firstEdge, offset);
+	setSection(header, GRAPH_EDGES, edges, offset);
+	setSection(header, SEGMENT_TREE_BOXES, built.segmentTree.m_boxes, offset);
+	setSection(header, SEGMENT_TREE_ITEMS, built.segmentTree.m_items, offset);
+	setSection(header, SEGMENT_TREE_LEVELS, built.segmentTree.m_levelStart, offset);
+	setSection(header, SPATIAL_LINES, built.lines, offset);
+	setSection(header, SPATIAL_GRID, gridRecord, offset);
+	setSection(header, GRID_FIRST_CELL_LINE, built.firstCellLine, offset);
+	setSection(header, GRID_CELL_LINES, built.cellLines, offset);
+	setSection(header, ATTRACTION_TREE_BOXES, built.attractionTree.m_boxes, offset);
+	setSection(header, ATTRACTION_TREE_ITEMS, built.attractionTree.m_items, offset);
+	setSection(header, ATTRACTION_TREE_LEVELS, built.attractionTree.m_levelStart, offset);
+	setSection(header, SPATIAL_ATTRACTIONS, spatialAttractions, offset);
+	header.fileSize = offset;
+
+	ofstream out(fileName, ios::binary | ios::trunc);
+	if (!out)
+		return false;
+	vector<Header> headerRecord(1, header);
+	writeSection(out, headerRecord);
+	writeSection(out, vector<char>(pool.begin(), pool.end()));
+	writeSection(out, coords);
+	writeSection(out, segmentRecords);
+	writeSection(out, attractions);
+	writeSection(out, coordIndex);
+	writeSection(out, coordIndexSegs);
+	writeSection(out, graphKeys);
+	writeSection(out, graphPoints);
+	writeSection(out, attractionNodes);
+	writeSection(out, firstEdge);
+	writeSection(out, edges);
+	writeSection(out, built.segmentTree.m_boxes);
+	writeSection(out, built.segmentTree.m_items);
+	writeSection(out, built.segmentTree.m_levelStart);
+	writeSection(out, built.lines);
+	writeSection(out, gridRecord);
+	writeSection(out, built.firstCellLine);
+	writeSection(out, built.cellLines);
+	writeSection(out, built.attractionTree.m_boxes);
+	writeSection(out, built.attractionTree.m_items);
+	writeSection(out, built.attractionTree.m_levelStart);
+	writeSection(out, spatialAttractions);
+	return static_cast<bool>(out.flush());
+}
+
+const MapSnapshot* MapSnapshot::unpatched(const MapLoader &ml)
+{
+	// a patch that only removed the last segment leaves nothing in the loader patched, but it
+	// does leave it shorter
+	const MapSnapshot* snapshot = ml.getSnapshot();
+	if (snapshot == nullptr || ml.getNumPatched() != 0 || ml.getNumSegments() != snapshot->getNumSegments())
+		return nullptr;
+	return snapshot;
+}
+
+bool MapSnapshot::open(const string &fileName)
+{
+	if (!m_file.open(fileName) || m_file.size() < sizeof(Header))
+		return false;
+
+	const Header* header = reinterpret_cast<const Header*>(m_file.data());
+	if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION ||
+		header->byteOrderMark != BYTE_ORDER_MARK || header->fileSize != m_file.size())
+		return false;
+
+	static const size_t recordSizes[] = { 1, sizeof(CoordRecord), sizeof(SegmentRecord), sizeof(AttractionRecord),
+		sizeof(CoordIndexRecord), sizeof(uint32_t),
+		sizeof(uint64_t), sizeof(GeoPoint), sizeof(uint8_t), sizeof(uint32_t), sizeof(RoadEdge),
+		sizeof(PackedRTree::StoredBox), sizeof(uint32_t), sizeof(uint32_t), sizeof(SpatialIndex::Line), sizeof(GridRecord),
+		sizeof(uint32_t), sizeof(uint32_t), sizeof(PackedRTree::StoredBox), sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t) };
+	static_assert(sizeof(recordSizes) / sizeof(recordSizes[0]) == NUM_SECTIONS, "a record size for every section");
+	for (int id = 0; id < NUM_SECTIONS; id++)
+		if (!sectionFits(header->sections[id], recordSizes[id], m_file.size()))
+			return false;
+
+	const char* base = m_file.data();
+	m_header = header;
+	m_strings = base + header->sections[STRINGS].offset;
+	m_coords = reinterpret_cast<const CoordRecord*>(base + header->sections[COORDS].offset);
+	m_segments = reinterpret_cast<const SegmentRecord*>(base + header->sections[SEGMENTS].offset);
+	m_attractions = reinterpret_cast<const AttractionRecord*>(base + header->sections[ATTRACTIONS].offset);
+	m_coordIndex = reinterpret_cast<const CoordIndexRecord*>(base + header->sections[COORD_INDEX].offset);
+	m_coordIndexSegs = reinterpret_cast<const uint32_t*>(base + header->sections[COORD_INDEX_SEGS].offset);
+	m_numStrings = header->sections[STRINGS].count;
+	m_numCoords = header->sections[COORDS].count;
+	m_numSegments = header->sections[SEGMENTS].count;
+	m_numAttractions = header->sections[ATTRACTIONS].count;
+	m_numCoordIndex = header->sections[COORD_INDEX].count;
+	m_numCoordIndexSegs = header->sections[COORD_INDEX_SEGS].count;
+
+	if (!validate())
+	{
+		m_file.close();
+		m_numSegments = 0;
+		return false;
+	}
+	return true;
+}
+
+// one linear pass over the records so lookups never have to bounds check anything
+bool MapSnapshot::validate() const
+{
+	auto stringOk = [this](const StringRef &ref) {
+		return ref.offset <= m_numStrings && ref.length <= m_numStrings - ref.offset;
+	};
+	for (size_t i = 0; i < m_numCoords; i++)
+		if (!stringOk(m_coords[i].latitudeText) || !stringOk(m_coords[i].longitudeText))
+			return false;
+	for (size_t i = 0; i < m_numSegments; i++)
+	{
+		const SegmentRecord &seg = m_segments[i];
+		if (!stringOk(seg.streetName) || seg.start >= m_numCoords || seg.end >= m_numCoords ||
+			seg.firstAttraction > m_numAttractions || seg.numAttractions > m_numAttractions - seg.firstAttraction)
+			return false;
+	}
+	for (size_t i = 0; i < m_numAttractions; i++)
+		if (!stringOk(m_attractions[i].name) || m_attractions[i].coord >= m_numCoords)
+			return false;
+	for (size_t i = 0; i < m_numCoordIndex; i++)
+	{
+		const CoordIndexRecord &entry = m_coordIndex[i];
+		if (entry.coord >= m_numCoords || entry.firstSegment > m_numCoordIndexSegs ||
+			entry.numSegments > m_numCoordIndexSegs - entry.firstSegment)
+			return false;
+		if (i > 0 && m_coordIndex[i - 1].key >= entry.key) // findSegments binary searches on the keys
+			return false;
+	}
+	for (size_t i = 0; i < m_numCoordIndexSegs; i++)
+		if (m_coordIndexSegs[i] >= m_numSegments)
+			return false;
+	return validateGraph() && validateSpatial();
+}
+
+// a node per coordinate, and every edge goes from one to another along a segment that's there
+bool MapSnapshot::validateGraph() const
+{
+	size_t numKeys, numPoints, numAttractionNodes, numFirstEdges, numEdges;
+	const uint64_t* keys = records<uint64_t>(GRAPH_KEYS, numKeys);
+	records<GeoPoint>(GRAPH_POINTS, numPoints);
+	records<uint8_t>(GRAPH_ATTRACTION_NODES, numAttractionNodes);
+	const uint32_t* firstEdge = records<uint32_t>(GRAPH_FIRST_EDGE, numFirstEdges);
+	const RoadEdge* edges = records<RoadEdge>(GRAPH_EDGES, numEdges);
+	if (numKeys != m_numCoords || numPoints != m_numCoords || numAttractionNodes != m_numCoords || numFirstEdges != m_numCoords + 1)
+		return false;
+	// every coordinate is in the index, so this makes sure each node has the number its coordinate does
+	for (size_t i = 0; i < m_numCoordIndex; i++)
+		if (keys[m_coordIndex[i].coord] != m_coordIndex[i].key)
+			return false;
+	if (firstEdge[0] != 0 || firstEdge[m_numCoords] != numEdges)
+		return false;
+	for (size_t node = 0; node < m_numCoords; node++)
+		if (firstEdge[node] > firstEdge[node + 1])
+			return false;
+	for (size_t i = 0; i < numEdges; i++)
+		if (edges[i].target >= m_numCoords || edges[i].segmentNumber() >= m_numSegments)
+			return false;
+	return true;
+}
+
+bool MapSnapshot::validateSpatial() const
+{
+	if (!treeOk(SEGMENT_TREE_BOXES, SEGMENT_TREE_ITEMS, SEGMENT_TREE_LEVELS) ||
+		!treeOk(ATTRACTION_TREE_BOXES, ATTRACTION_TREE_ITEMS, ATTRACTION_TREE_LEVELS))
+		return false;
+
+	// the segment tree holds every segment, and a line for each
+	size_t numItems, numLines;
+	records<uint32_t>(SEGMENT_TREE_ITEMS, numItems);
+	const SpatialIndex::Line* lines = records<SpatialIndex::Line>(SPATIAL_LINES, numLines);
+	if (numItems != m_numSegments || numLines != m_numSegments)
+		return false;
+	for (size_t i = 0; i < numLines; i++)
+		if (lines[i].segment >= m_numSegments)
+			return false;
+
+	size_t numGrids, numFirstCellLines, numCellLines;
+	const GridRecord* grid = records<GridRecord>(SPATIAL_GRID, numGrids);
+	const uint32_t* firstCellLine = records<uint32_t>(GRID_FIRST_CELL_LINE, numFirstCellLines);
+	const uint32_t* cellLines = records<uint32_t>(GRID_CELL_LINES, numCellLines);
+	if (numGrids != 1 || grid->rows < 0 || grid->columns < 0)
+		return false;
+	if (grid->rows == 0) // nothing to grid
+	{
+		if (numFirstCellLines != 0 || numCellLines != 0)
+			return false;
+	}
+	else
+	{
+		if (grid->columns == 0 || !(grid->cellHeight > 0) || !(grid->cellWidth > 0) ||
+			static_cast<uint64_t>(grid->rows) * static_cast<uint64_t>(grid->columns) + 1 != numFirstCellLines)
+			return false;
+		if (firstCellLine[0] != 0 || firstCellLine[numFirstCellLines - 1] != numCellLines)
+			return false;
+		for (size_t cell = 0; cell + 1 < numFirstCellLines; cell++)
+			if (firstCellLine[cell] > firstCellLine[cell + 1])
+				return false;
+		for (size_t i = 0; i < numCellLines; i++)
+			if (cellLines[i] >= numLines)
+				return false;
+	}
+
+	size_t numAttractionItems, numSpatialAttractions;
+	records<uint32_t>(ATTRACTION_TREE_ITEMS, numAttractionItems);
+	const uint32_t* spatialAttractions = records<uint32_t>(SPATIAL_ATTRACTIONS, numSpatialAttractions);
+	if (numSpatialAttractions != numAttractionItems)
+		return false;
+	for (size_t i = 0; i < numSpatialAttractions; i++)
+		if (spatialAttractions[i] >= m_numAttractions)
+			return false;
+	return true;
+}
+
+// the searches find a level's children by arithmetic, so the levels have to be exactly the sizes
+// build makes: each one box per FANOUT of the level below, down from a single root
+bool MapSnapshot::treeOk(SectionId boxes, SectionId items, SectionId levelStart) const
+{
+	size_t numBoxes, numItems, numLevels;
+	records<PackedRTree::StoredBox>(boxes, numBoxes);
+	const uint32_t* positions = records<uint32_t>(items, numItems);
+	const uint32_t* levels = records<uint32_t>(levelStart, numLevels);
+	if (numItems == 0)
+		return numBoxes == 0 && numLevels == 0;
+	if (numLevels < 3 || levels[0] != 0 || levels[1] != numItems || levels[numLevels - 1] != numBoxes)
+		return false;
+	for (size_t level = 1; level + 1 < numLevels; level++)
+	{
+		uint32_t below = levels[level] - levels[level - 1];
+		if (levels[level + 1] < levels[level] || levels[level + 1] - levels[level] != (below + PackedRTree::FANOUT - 1) / PackedRTree::FANOUT)
+			return false;
+	}
+	if (levels[numLevels - 1] - levels[numLevels - 2] != 1) // the root
+		return false;
+	for (size_t i = 0; i < numItems; i++)
+		if (positions[i] >= numItems)
+			return false;
+	return true;
+}
+
+void MapSnapshot::getSegment(size_t segNum, StreetSegment &seg) const
+{
+	const SegmentRecord &record = m_segments[segNum];
+	seg.streetName = Name(m_strings + record.streetName.offset, record.streetName.length);
+	getCoord(record.start, seg.segment.start);
+	getCoord(record.end, seg.segment.end);
+	seg.attractions.resize(record.numAttractions);
+	for (uint32_t i = 0; i < record.numAttractions; i++)
+		getAttraction(record.firstAttraction + i, seg.attractions[i]);
+}
+
+void MapSnapshot::getCoord(uint32_t coordNum, GeoCoord &gc) const
+{
+	const CoordRecord &record = m_coords[coordNum];
+	gc.latitudeText.assign(m_strings + record.latitudeText.offset, record.latitudeText.length);
+	gc.longitudeText.assign(m_strings + record.longitudeText.offset, record.longitudeText.length);
+	gc.latitude = record.latitude;
+	gc.longitude = record.longitude;
+}
+
+void MapSnapshot::getAttraction(uint32_t attractionNum, Attraction &a) const
+{
+	const AttractionRecord &record = m_attractions[attractionNum];
+	a.name = Name(m_strings + record.name.offset, record.name.length);
+	getCoord(record.coord, a.geocoordinates);
+}
+
+const CoordIndexRecord* MapSnapshot::findCoordIndex(const CoordKey &key) const
+{
+	// binary search over the coordinate index. the keys are stored inline, so each probe is one compare
+	size_t low = 0, high = m_numCoordIndex;
+	while (low < high)
+	{
+		size_t mid = low + (high - low) / 2;
+		if (m_coordIndex[mid].key < key.bits())
+			low = mid + 1;
+		else if (m_coordIndex[mid].key > key.bits())
+			high = mid;
+		else
+			return &m_coordIndex[mid];
+	}
+	return nullptr;
+}
+
+const uint32_t* MapSnapshot::findSegments(const CoordKey &key, size_t &count) const
+{
+	const CoordIndexRecord* entry = findCoordIndex(key);
+	if (entry == nullptr)
+	{
+		count = 0;
+		return nullptr;
+	}
+	count = entry->numSegments;
+	return m_coordIndexSegs + entry->firstSegment;
+}
+
+bool MapSnapshot::findCoord(const CoordKey &key, uint32_t &coordNum) const
+{
+	const CoordIndexRecord* entry = findCoordIndex(key);
+	if (entry == nullptr)
+		return false;
+	coordNum = entry->coord;
+	return true;
+}
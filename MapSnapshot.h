@@ -0,0 +1,174 @@
+#ifndef MAP_SNAPSHOT_H
+#define MAP_SNAPSHOT_H
+
+#include "provided.h"
+#include "support.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+class RoadGraph;
+class SpatialIndex;
+
+// A compiled map snapshot is one binary file holding everything the loaders would otherwise
+// rebuild from mapdata.txt: the segments, their attractions, and SegmentMapper's coordinate ->
+// segments index. It also holds the arrays RoadGraph and SpatialIndex would build at load time, exactly as they
+// build them, so a map loaded from a snapshot searches those in place too. Every section is a
+// flat array of fixed size records so the file can be mmapped and searched in place. All offsets
+// are relative to the start of the file.
+//
+// AttractionMapper's name tables aren't in it. They're rebuilt from the attraction records at load
+// (a few hundred names on the LA map, under a millisecond), since they hold the Attractions
+// that patches edit and hash the names as std::strings, neither of which can be read in place.
+
+namespace snapshot
+{
+	const char MAGIC[8] = { 'B', 'R', 'U', 'I', 'N', 'M', 'A', 'P' };
+	const uint32_t VERSION = 4; // bump whenever a record layout changes
+	const uint32_t BYTE_ORDER_MARK = 0x01020304; // written natively, so a foreign-endian file won't match
+
+	enum SectionId {
+		STRINGS,			// char pool that every StringRef points into
+		COORDS,				// CoordRecord, one per distinct coordinate
+		SEGMENTS,			// SegmentRecord, in the same order as the map data file
+		ATTRACTIONS,		// AttractionRecord, grouped by segment
+		COORD_INDEX,		// CoordIndexRecord, sorted by CoordKey
+		COORD_INDEX_SEGS,	// uint32_t segment numbers that CoordIndexRecords point into
+		// RoadGraph's arrays. its nodes are numbered the same way as COORDS, so a node's number is its coordinate's
+		GRAPH_KEYS,				// uint64_t CoordKey::bits(), one per node
+		GRAPH_POINTS,			// GeoPoint, one per node
+		GRAPH_ATTRACTION_NODES,	// uint8_t, 1 if some attraction is at the node
+		GRAPH_FIRST_EDGE,		// uint32_t, one per node plus one past the end
+		GRAPH_EDGES,			// RoadEdge
+		// SpatialIndex's arrays
+		SEGMENT_TREE_BOXES,		// PackedRTree's boxes, over the segments
+		SEGMENT_TREE_ITEMS,		// uint32_t segment number at each of that tree's positions
+		SEGMENT_TREE_LEVELS,	// uint32_t where each of that tree's levels starts
+		SPATIAL_LINES,			// SpatialIndex's lines, in the segment tree's order
+		SPATIAL_GRID,			// GridRecord, just the one
+		GRID_FIRST_CELL_LINE,	// uint32_t, one per cell plus one past the end
+		GRID_CELL_LINES,		// uint32_t positions in SPATIAL_LINES, grouped by cell
+		ATTRACTION_TREE_BOXES,	// the same three for the tree over the attractions
+		ATTRACTION_TREE_ITEMS,
+		ATTRACTION_TREE_LEVELS,
+		SPATIAL_ATTRACTIONS,	// uint32_t index into ATTRACTIONS at each of that tree's positions
+		NUM_SECTIONS
+	};
+
+	struct StringRef {
+		uint32_t offset;
+		uint32_t length;
+	};
+
+	struct Section {
+		uint64_t offset;
+		uint64_t count; // number of records (bytes for STRINGS)
+	};
+
+	struct Header {
+		char		magic[8];
+		uint32_t	version;
+		uint32_t	byteOrderMark;
+		uint64_t	fileSize;
+		Section		sections[NUM_SECTIONS];
+	};
+
+	struct CoordRecord {
+		StringRef	latitudeText;
+		StringRef	longitudeText;
+		double		latitude;
+		double		longitude;
+	};
+
+	struct SegmentRecord {
+		StringRef	streetName;
+		uint32_t	start;				// index into COORDS
+		uint32_t	end;				// index into COORDS
+		uint32_t	firstAttraction;	// index into ATTRACTIONS
+		uint32_t	numAttractions;
+	};
+
+	struct AttractionRecord {
+		StringRef	name;
+		uint32_t	coord;				// index into COORDS
+		uint32_t	padding;
+	};
+
+	struct CoordIndexRecord {
+		uint64_t	key;				// CoordKey::bits() of the coordinate, so searching never touches COORDS
+		uint32_t	coord;				// index into COORDS
+		uint32_t	firstSegment;		// index into COORD_INDEX_SEGS
+		uint32_t	numSegments;
+		uint32_t	padding;			// spelled out so it gets written as zeros, not whatever was in memory
+	};
+
+	struct GridRecord {
+		double		minLatitude, minLongitude;
+		double		cellHeight, cellWidth;
+		int32_t		rows, columns;
+	};
+}
+
+class MapSnapshot
+{
+public:
+	MapSnapshot();
+	// true if the first bytes of the file are a snapshot header, so load() knows which parser to use
+	static bool isSnapshot(const std::string &fileName);
+	// writes segments plus the prebuilt coordinate index, and graph's and spatial's arrays, which have to
+	// have been built for those segments and not patched since. returns false if the file can't be
+	// written, or if graph doesn't number its nodes the way the snapshot numbers its coordinates
+	static bool write(const std::vector<StreetSegment> &segments, const RoadGraph &graph, const SpatialIndex &spatial, const std::string &fileName);
+	// the snapshot ml was loaded from, as long as ml still has exactly the map that was saved in it,
+	// so whatever was built ahead of time for that map can be used for ml. nullptr if ml was loaded
+	// from text, or has been patched since
+	static const MapSnapshot* unpatched(const MapLoader &ml);
+
+	// maps the file and checks that every section and record reference is in bounds
+	bool open(const std::string &fileName);
+
+	size_t getNumSegments() const { return m_numSegments; }
+	void getSegment(size_t segNum, StreetSegment &seg) const;
+	// fills in a GeoCoord without going back through stod. the doubles were saved at compile time
+	void getCoord(uint32_t coordNum, GeoCoord &gc) const;
+	void getAttraction(uint32_t attractionNum, Attraction &a) const;
+	// a section's records, right where they are in the file. Record has to be the type the
+	// section was written with (see SectionId), which open has already checked them against
+	template<typename Record>
+	const Record* records(snapshot::SectionId id, size_t &count) const
+	{
+		count = m_header->sections[id].count;
+		return reinterpret_cast<const Record*>(m_file.data() + m_header->sections[id].offset);
+	}
+
+	// index lookups that work directly on the mapped file. nothing is rebuilt.
+	// returns pointers to the segment numbers touching gc, or nullptr (and count 0) if there are none
+	const uint32_t* findSegments(const CoordKey &key, size_t &count) const;
+	// the number of the coordinate with the key, which is also its RoadGraph node number
+	bool findCoord(const CoordKey &key, uint32_t &coordNum) const;
+
+	// we prevent a MapSnapshot from being copied or assigned because it owns the mapping
+	MapSnapshot(const MapSnapshot&) = delete;
+	MapSnapshot& operator=(const MapSnapshot&) = delete;
+private:
+	MappedFile m_file;
+	const snapshot::Header* m_header;
+	const char* m_strings;
+	const snapshot::CoordRecord* m_coords;
+	const snapshot::SegmentRecord* m_segments;
+	const snapshot::AttractionRecord* m_attractions;
+	const snapshot::CoordIndexRecord* m_coordIndex;
+	const uint32_t* m_coordIndexSegs;
+	size_t m_numStrings, m_numCoords, m_numSegments, m_numAttractions, m_numCoordIndex, m_numCoordIndexSegs;
+
+	bool validate() const;
+	bool validateGraph() const;
+	bool validateSpatial() const;
+	// the three sections of a PackedRTree hold a tree shaped the way PackedRTree::build makes them
+	bool treeOk(snapshot::SectionId boxes, snapshot::SectionId items, snapshot::SectionId levelStart) const;
+	const snapshot::CoordIndexRecord* findCoordIndex(const CoordKey &key) const;
+	std::string getString(const snapshot::StringRef &ref) const { return std::string(m_strings + ref.offset, ref.length); }
+	// three way comparison of pooled text against a std::string, like std::string::compare
+};
+
+#endif // for MAP_SNAPSHOT_H
@@ -0,0 +1,216 @@
+#ifndef MY_HASH_MAP
+#define MY_HASH_MAP
+
+#include <vector>
+#include <functional>
+#include <utility>
+#include <cstdint>
+
+// Same associate/find interface as MyMap, but as an open addressing hash table for when all that's
+// ever needed is exact key lookups. Entries live in one flat array and collisions are resolved by
+// linear probing with the Robin Hood rule: an entry being inserted takes over any slot whose entry
+// is closer to its own home slot, so every key ends up at most a few slots past where it hashes to
+// and a lookup can stop as soon as it passes a slot that's closer to home than it would be.
+// Keys need operator== and a Hasher. The hash gets scrambled again here, so a weak one like
+// std::hash of an integer (which just returns the integer) is fine.
+template<typename KeyType, typename ValueType, typename Hasher = std::hash<KeyType>>
+class MyHashMap
+{
+public:
+	MyHashMap() : m_size(0), m_shift(64) {}
+	~MyHashMap() {}
+	void clear() { m_slots.clear(); m_distances.clear(); m_size = 0; m_shift = 64; }
+	int size() const { return m_size; }
+	// keys and values passed as temporaries (or with std::move) are moved into the table, not copied
+	void associate(const KeyType& key, const ValueType& value) { assign(key, value); }
+	void associate(const KeyType& key, ValueType&& value) { assign(key, std::move(value)); }
+	void associate(KeyType&& key, const ValueType& value) { assign(std::move(key), value); }
+	void associate(KeyType&& key, ValueType&& value) { assign(std::move(key), std::move(value)); }
+
+	// same as MyMap's. unlike MyMap though, any insert can move entries around, so the pointers
+	// and references these return are only good until the next time something is added
+	template<typename... Args>
+	std::pair<ValueType*, bool> emplace(const KeyType& key, Args&&... args)
+	{
+		bool inserted;
+		size_t slot = insertSlot(key, inserted, std::forward<Args>(args)...);
+		return std::make_pair(&m_slots[slot].m_value, inserted);
+	}
+	template<typename... Args>
+	std::pair<ValueType*, bool> emplace(KeyType&& key, Args&&... args)
+	{
+		bool inserted;
+		size_t slot = insertSlot(std::move(key), inserted, std::forward<Args>(args)...);
+		return std::make_pair(&m_slots[slot].m_value, inserted);
+	}
+	ValueType& findOrInsert(const KeyType& key) { bool inserted; return m_slots[insertSlot(key, inserted)].m_value; }
+	ValueType& findOrInsert(KeyType&& key) { bool inserted; return m_slots[insertSlot(std::move(key), inserted)].m_value; }
+
+	// for a map that can't be modified, return a pointer to const ValueType
+	const ValueType* find(const KeyType& key) const;
+
+	// for a modifiable map, return a pointer to modifiable ValueType
+	ValueType* find(const KeyType& key)
+	{
+		return const_cast<ValueType*>(const_cast<const MyHashMap*>(this)->find(key));
+	}
+
+	// finds the entry for the key probe stands in for, without having to build a KeyType to search
+	// with. the Hasher has to hash probe the same as that key, and key == probe has to say if they match
+	template<typename Probe>
+	const ValueType* findEquivalent(const Probe& probe) const
+	{
+		if (m_size == 0)
+			return nullptr;
+		size_t slot = findSlot(probe, scramble(probe));
+		return slot == NOT_FOUND ? nullptr : &m_slots[slot].m_value;
+	}
+
+	// a table is only ever copied on purpose, with this, and never by accident
+	void copyFrom(const MyHashMap& other)
+	{
+		m_slots = other.m_slots;
+		m_distances = other.m_distances;
+		m_size = other.m_size;
+		m_shift = other.m_shift;
+	}
+
+	MyHashMap(const MyHashMap&) = delete;
+	MyHashMap& operator=(const MyHashMap&) = delete;
+
+private:
+	struct Slot {
+		KeyType m_key;
+		ValueType m_value;
+	};
+	std::vector<Slot> m_slots; // the size is always zero or a power of two
+	// one past how far each slot's entry is from its home slot, so 0 means the slot is empty
+	std::vector<uint32_t> m_distances;
+	int m_size;
+	int m_shift; // 64 - log2(number of slots). the home slot is the top bits of the scrambled hash
+	Hasher m_hasher;
+
+	static const size_t NOT_FOUND = static_cast<size_t>(-1);
+	// multiplying by 2^64 / golden ratio spreads every input bit into the top bits. the home slot is
+	// the top bits of this, so it's worked out once per call and shared by the search and the insert
+	template<typename K>
+	uint64_t scramble(const K& key) const { return static_cast<uint64_t>(m_hasher(key)) * 0x9E3779B97F4A7C15ull; }
+	size_t homeSlot(uint64_t scrambled) const { return static_cast<size_t>(scrambled >> m_shift); }
+	template<typename K>
+	size_t findSlot(const K& key, uint64_t scrambled) const; // NOT_FOUND if key isn't there
+	// puts the entry in without checking whether its key is already there. key and value are moved
+	// from. returns the slot the entry ended up in
+	size_t place(KeyType& key, ValueType& value, uint64_t scrambled);
+	void grow();
+
+	// the search and insert every add goes through, building the entry from key and args only if
+	// key isn't there yet. returns key's slot
+	template<typename K, typename... Args>
+	size_t insertSlot(K&& key, bool& inserted, Args&&... args);
+	template<typename K, typename V>
+	void assign(K&& key, V&& value)
+	{
+		bool inserted;
+		size_t slot = insertSlot(std::forward<K>(key), inserted, std::forward<V>(value));
+		if (!inserted) // insertSlot only touches value when it adds a new entry
+			m_slots[slot].m_value = std::forward<V>(value); // just replace the value that's already there
+	}
+};
+
+template<typename KeyType, typename ValueType, typename Hasher>
+template<typename K, typename... Args>
+size_t MyHashMap<KeyType, ValueType, Hasher>::insertSlot(K&& key, bool& inserted, Args&&... args)
+{
+	uint64_t scrambled = scramble(key);
+	size_t existing = findSlot(key, scrambled);
+	if (existing != NOT_FOUND)
+	{
+		inserted = false;
+		return existing;
+	}
+	// keep the table at most 7/8 full so probes stay short
+	if ((m_size + 1) * 8 > static_cast<int>(m_slots.size()) * 7)
+		grow();
+	KeyType newKey(std::forward<K>(key));
+	ValueType newValue(std::forward<Args>(args)...);
+	m_size++;
+	inserted = true;
+	return place(newKey, newValue, scrambled);
+}
+
+template<typename KeyType, typename ValueType, typename Hasher>
+size_t MyHashMap<KeyType, ValueType, Hasher>::place(KeyType& key, ValueType& value, uint64_t scrambled)
+{
+	size_t mask = m_slots.size() - 1;
+	size_t pos = homeSlot(scrambled);
+	size_t landed = NOT_FOUND; // where the entry we were given goes. anything after that is one it bumped
+	uint32_t distance = 1;
+	while (true)
+	{
+		if (m_distances[pos] == 0) // empty, so it's ours
+		{
+			m_slots[pos].m_key = std::move(key);
+			m_slots[pos].m_value = std::move(value);
+			m_distances[pos] = distance;
+			return landed == NOT_FOUND ? pos : landed;
+		}
+		if (m_distances[pos] < distance) // this entry is closer to home than we are, so it moves on instead
+		{
+			std::swap(m_slots[pos].m_key, key);
+			std::swap(m_slots[pos].m_value, value);
+			std::swap(m_distances[pos], distance);
+			if (landed == NOT_FOUND)
+				landed = pos;
+		}
+		pos = (pos + 1) & mask;
+		distance++;
+	}
+}
+
+template<typename KeyType, typename ValueType, typename Hasher>
+void MyHashMap<KeyType, ValueType, Hasher>::grow()
+{
+	std::vector<Slot> oldSlots;
+	std::vector<uint32_t> oldDistances;
+	oldSlots.swap(m_slots);
+	oldDistances.swap(m_distances);
+	size_t capacity = oldSlots.empty() ? 16 : oldSlots.size() * 2;
+	m_shift = 64;
+	for (size_t n = capacity; n > 1; n /= 2)
+		m_shift--;
+	m_slots.resize(capacity);
+	m_distances.assign(capacity, 0);
+	for (size_t i = 0; i < oldSlots.size(); i++)
+		if (oldDistances[i] != 0)
+			place(oldSlots[i].m_key, oldSlots[i].m_value, scramble(oldSlots[i].m_key));
+}
+
+template<typename KeyType, typename ValueType, typename Hasher>
+const ValueType* MyHashMap<KeyType, ValueType, Hasher>::find(const KeyType& key) const
+{
+	if (m_size == 0)
+		return nullptr;
+	size_t slot = findSlot(key, scramble(key));
+	return slot == NOT_FOUND ? nullptr : &m_slots[slot].m_value;
+}
+
+template<typename KeyType, typename ValueType, typename Hasher>
+template<typename K>
+size_t MyHashMap<KeyType, ValueType, Hasher>::findSlot(const K& key, uint64_t scrambled) const
+{
+	if (m_slots.empty())
+		return NOT_FOUND;
+	size_t mask = m_slots.size() - 1;
+	size_t pos = homeSlot(scrambled);
+	// once we reach a slot whose entry is closer to home than we'd be (or an empty one), the key
+	// would have taken that slot if it were in the table
+	for (uint32_t distance = 1; m_distances[pos] >= distance; distance++)
+	{
+		if (m_slots[pos].m_key == key)
+			return pos;
+		pos = (pos + 1) & mask;
+	}
+	return NOT_FOUND;
+}
+
+#endif // for MY_HASH_MAP
@@ -2,9 +2,121 @@
 #define MY_MAP
 
 #include <string>
+#include <vector>
+#include <new>
+#include <utility>
 #include "provided.h"
 
+// Node allocator policies for MyMap. A policy is a template over the node type with allocate()
+// returning room for one node, deallocate() taking one back, and release() that MyMap calls from
+// clear() after every node has been destroyed.
+
+// hands out nodes from a few big slabs instead of making one heap allocation per node, so a map's
+// nodes sit next to each other in memory. nothing is given back until release() frees every slab
+// at once. the first slab is small so maps that stay tiny (like the ones navigate makes) stay cheap
+template<typename NodeType>
+class NodeArena
+{
+public:
+	NodeArena() : m_next(nullptr), m_left(0), m_slabSize(FIRST_SLAB) {}
+	~NodeArena() { release(); }
+	void* allocate()
+	{
+		if (m_left == 0)
+			newSlab();
+		m_left--;
+		return m_next++;
+	}
+	void deallocate(void*) {} // the space comes back in release()
+	void release()
+	{
+		for (size_t i = 0; i < m_slabs.size(); i++)
+			::operator delete(m_slabs[i]);
+		m_slabs.clear();
+		m_next = nullptr;
+		m_left = 0;
+		m_slabSize = FIRST_SLAB;
+	}
+	NodeArena(const NodeArena&) = delete;
+	NodeArena& operator=(const NodeArena&) = delete;
+private:
+	static const size_t FIRST_SLAB = 16, MAX_SLAB = 4096; // in nodes. each slab is double the last
+	std::vector<void*> m_slabs;
+	NodeType* m_next;
+	size_t m_left;
+	size_t m_slabSize;
+
+	void newSlab()
+	{
+		m_slabs.push_back(::operator new(m_slabSize * sizeof(NodeType)));
+		m_next = static_cast<NodeType*>(m_slabs.back());
+		m_left = m_slabSize;
+		if (m_slabSize < MAX_SLAB)
+			m_slabSize *= 2;
+	}
+};
+
+// one new and delete per node, the way MyMap always used to allocate
+template<typename NodeType>
+class NodeNewDelete
+{
+public:
+	void* allocate() { return ::operator new(sizeof(NodeType)); }
+	void deallocate(void* node) { ::operator delete(node); }
+	void release() {}
+};
+
+template<typename KeyType, typename ValueType, template<typename> class NodeAllocator> class MyMap;
+
+// A read-only snapshot of a MyMap made by MyMap::freeze: every entry in key order, with the keys in
+// one contiguous array and the values in another so searches only touch keys. Nothing can change
+// one after it's made, so any number of threads can search the same FrozenMap at once, and since
+// the entries are already sorted, walking a range of keys in order or writing the whole thing out
+// is just a loop over the arrays.
+template<typename KeyType, typename ValueType>
+class FrozenMap
+{
+public:
+	FrozenMap() {}
+	int size() const { return static_cast<int>(m_keys.size()); }
+	const ValueType* find(const KeyType& key) const
+	{
+		int i = lowerBound(key);
+		if (i == size() || key < m_keys[i])
+			return nullptr;
+		return &m_values[i];
+	}
+	// index of the first entry whose key isn't less than key, or size() if there isn't one
+	int lowerBound(const KeyType& key) const;
+	const KeyType& keyAt(int i) const { return m_keys[i]; }
+	const ValueType& valueAt(int i) const { return m_values[i]; }
+private:
+	template<typename K, typename V, template<typename> class A> friend class MyMap; // fills in the arrays
+	std::vector<KeyType> m_keys;
+	std::vector<ValueType> m_values;
+};
+
+// binary search where each step only picks which half to keep, so the compiler can use a
+// conditional move instead of a branch that mispredicts half the time
 template<typename KeyType, typename ValueType>
+int FrozenMap<KeyType, ValueType>::lowerBound(const KeyType& key) const
+{
+	if (m_keys.empty())
+		return 0;
+	const KeyType* base = m_keys.data();
+	size_t length = m_keys.size();
+	while (length > 1)
+	{
+		size_t half = length / 2;
+		base = (base[half] < key) ? base + half : base;
+		length -= half;
+	}
+	return static_cast<int>(base - m_keys.data()) + (*base < key ? 1 : 0);
+}
+
+// an AVL tree, so no matter what order keys are associated in (mapdata.txt adds them in long
+// increasing runs along each street) no path from the root is more than about 1.44 log2(n) long
+template<typename KeyType, typename ValueType, template<typename> class NodeAllocator = NodeArena>
 class MyMap
 {
 public:
@@ -12,7 +124,35 @@ public:
 	~MyMap() { deleteAll(); }
 	void clear() { deleteAll(); }
 	int size() const { return m_size; }
-	void associate(const KeyType& key, const ValueType& value);
+	// how many nodes the longest path from the root goes through, which bounds every find
+	int height() const { return heightOf(m_rootPtr); }
+	// keys and values passed as temporaries (or with std::move) are moved into the map, not copied
+	void associate(const KeyType& key, const ValueType& value) { assign(key, value); }
+	void associate(const KeyType& key, ValueType&& value) { assign(key, std::move(value)); }
+	void associate(KeyType&& key, const ValueType& value) { assign(std::move(key), value); }
+	void associate(KeyType&& key, ValueType&& value) { assign(std::move(key), std::move(value)); }
+
+	// builds the value in place from args if key isn't in the map yet, and leaves an existing value
+	// alone. returns where key's value is and whether it was just added
+	template<typename... Args>
+	std::pair<ValueType*, bool> emplace(const KeyType& key, Args&&... args)
+	{
+		bool inserted;
+		Node* node = insertNode(key, inserted, std::forward<Args>(args)...);
+		return std::make_pair(&node->m_value, inserted);
+	}
+	template<typename... Args>
+	std::pair<ValueType*, bool> emplace(KeyType&& key, Args&&... args)
+	{
+		bool inserted;
+		Node* node = insertNode(std::move(key), inserted, std::forward<Args>(args)...);
+		return std::make_pair(&node->m_value, inserted);
+	}
+
+	// returns key's value, adding a default constructed one first if key isn't there. it's the
+	// same single walk down the tree either way, and the reference stays good until clear()
+	ValueType& findOrInsert(const KeyType& key) { bool inserted; return insertNode(key, inserted)->m_value; }
+	ValueType& findOrInsert(KeyType&& key) { bool inserted; return insertNode(std::move(key), inserted)->m_value; }
 
 	// for a map that can't be modified, return a pointer to const ValueType
 	const ValueType* find(const KeyType& key) const;
@@ -23,81 +163,99 @@ public:
 		return const_cast<ValueType*>(const_cast<const MyMap*>(this)->find(key));
 	}
 
+	// copies every entry into frozen in key order, replacing whatever it held. this map is left as it was
+	void freeze(FrozenMap<KeyType, ValueType>& frozen) const;
+
 	// C++11 syntax for preventing copying and assignment
 	MyMap(const MyMap&) = delete;
 	MyMap& operator=(const MyMap&) = delete;
 
 private:
 	struct Node {
+		// key and value are built straight from what was passed in, never default built and then assigned
+		template<typename K, typename... Args>
+		Node(K&& key, Args&&... args)
+			: m_key(std::forward<K>(key)), m_value(std::forward<Args>(args)...), left(nullptr), right(nullptr), height(1)
+		{}
 		KeyType m_key;
 		ValueType m_value;
 		Node *left, *right;
+		int height; // of the subtree rooted here. a leaf is 1
 	};
 	Node* m_rootPtr;
 	int m_size; // need to make sure that this gets adjusted properly for insertion and deletion
+	NodeAllocator<Node> m_nodes; // where every Node's memory comes from
 
-	// private associate method that does the work of creating the new node and properly initializing
-	// it. sets the pointer reference to the address of the node that's created
-	void associate(const KeyType& key, const ValueType& value, Node* &pointerToModify);
+	// an AVL tree of 2^31 nodes is under 46 high, so this is plenty for the path associate walks down
+	static const int MAX_HEIGHT = 64;
+
+	// the one walk down the tree that every insert goes through. returns the node holding key, first
+	// building it from key and args (and rebalancing) if it isn't there. inserted says which happened
+	template<typename K, typename... Args>
+	Node* insertNode(K&& key, bool& inserted, Args&&... args);
+	template<typename K, typename V>
+	void assign(K&& key, V&& value)
+	{
+		bool inserted;
+		Node* node = insertNode(std::forward<K>(key), inserted, std::forward<V>(value));
+		if (!inserted) // insertNode only touches value when it builds a new node
+			node->m_value = std::forward<V>(value); // just replace the value of the already existent node
+	}
 	void deleteAll();
-	void deleteThis(Node* toBeDeleted); // called by deleteAll at first and then calls itself recursively
+
+	static int heightOf(const Node* node) { return node == nullptr ? 0 : node->height; }
+	static void updateHeight(Node* node);
+	// both rotations replace the subtree root that subtree points at with one of its children
+	static void rotateLeft(Node* &subtree);
+	static void rotateRight(Node* &subtree);
+	// fixes subtree's height and, if its two sides now differ by 2, rotates it back into balance
+	static void rebalance(Node* &subtree);
 };
 
-template<typename KeyType, typename ValueType>
-void MyMap<KeyType, ValueType>::associate(const KeyType& key, const ValueType& value)
+template<typename KeyType, typename ValueType, template<typename> class NodeAllocator>
+template<typename K, typename... Args>
+typename MyMap<KeyType, ValueType, NodeAllocator>::Node* MyMap<KeyType, ValueType, NodeAllocator>::insertNode(K&& key, bool& inserted, Args&&... args)
 {
-	if (m_rootPtr == nullptr)
-	{
-		associate(key, value, m_rootPtr); // add new node for root pointer to point to
-	}
-	else
+	// remember every link followed on the way down, since those are the subtrees that may need
+	// rebalancing once the new leaf is in
+	Node** path[MAX_HEIGHT];
+	int depth = 0;
+	Node** link = &m_rootPtr;
+	while (*link != nullptr)
 	{
-		Node* current = m_rootPtr;
-		while (true)
+		Node* current = *link;
+		path[depth++] = link;
+		if (current->m_key < key) // need to ensure that keys have the appropriate comparison operators defined
+			link = &current->right;
+		else if (key < current->m_key) // current node's key is greater than the key argument that was passed in
+			link = &current->left;
+		else // so current->m_key == key
 		{
-			if (current->m_key < key) // need to ensure that keys have the appropriate comparison operators defined
-			{
-				if (current->right == nullptr)
-				{
-					associate(key, value, current->right);
-					return;
-				}
-				else
-					current = current->right;
-			}
-			else if (key < current->m_key) // current node's key is greater than the key argument that was passed in
-			{
-				if (current->left == nullptr)
-				{
-					associate(key, value, current->left);
-					return;
-				}
-				else
-					current = current->left;
-			}
-			else // so current->m_key == key
-			{
-				current->m_value = value; // just replace the value of the already existent node
-				return;
-			}
+			inserted = false;
+			return current;
 		}
 	}
-}
-
-// called by public associate method. adds a leaf and links to "pointerToModify".
-template<typename KeyType, typename ValueType>
-void MyMap<KeyType, ValueType>::associate(const KeyType& key, const ValueType& value, Node* &pointerToModify)
-{
-	pointerToModify = new Node; // add the link step here
-	pointerToModify->left = pointerToModify->right = nullptr; // set each child as nullptr when node is first created
-	pointerToModify->m_key = key;
-	pointerToModify->m_value = value;
+	Node* added = new (m_nodes.allocate()) Node(std::forward<K>(key), std::forward<Args>(args)...);
+	*link = added; // add the link step here
 	m_size++;
+	inserted = true;
+
+	// walk back up. once a subtree's height comes out the same as before, nothing above it changes.
+	// rotations move links around but never nodes, so added stays where it is
+	while (depth > 0)
+	{
+		Node* &subtree = *path[--depth];
+		int oldHeight = subtree->height;
+		rebalance(subtree);
+		if (subtree->height == oldHeight)
+			break;
+	}
+	return added;
 }
 
 // non-recursive find. returns nullptr if not found and pointer to node if found
-template<typename KeyType, typename ValueType>
-const ValueType* MyMap<KeyType, ValueType>::find(const KeyType& key) const
+template<typename KeyType, typename ValueType, template<typename> class NodeAllocator>
+const ValueType* MyMap<KeyType, ValueType, NodeAllocator>::find(const KeyType& key) const
 {
 	Node* current = m_rootPtr;
 	while (current != nullptr)
@@ -113,32 +271,105 @@ const ValueType* MyMap<KeyType, ValueType>::find(const KeyType& key) const
 	return nullptr; // if find proceeds until it follows a leaf's left or right pointer, return nullptr
 }
 
-// deletes all of tree
-template<typename KeyType, typename ValueType>
-void MyMap<KeyType, ValueType>::deleteAll()
+// in order walk with an explicit stack, which never needs to be taller than the tree
+template<typename KeyType, typename ValueType, template<typename> class NodeAllocator>
+void MyMap<KeyType, ValueType, NodeAllocator>::freeze(FrozenMap<KeyType, ValueType>& frozen) const
 {
-	if (m_rootPtr != nullptr) // only delete stuff if there's a tree to be deleted
+	frozen.m_keys.clear();
+	frozen.m_values.clear();
+	frozen.m_keys.reserve(m_size);
+	frozen.m_values.reserve(m_size);
+	const Node* pending[MAX_HEIGHT];
+	int depth = 0;
+	const Node* current = m_rootPtr;
+	while (current != nullptr || depth > 0)
 	{
-		deleteThis(m_rootPtr);
-		m_size = 0; // so now it's an empty tree
-		m_rootPtr = nullptr; // and so the root pointer has nothing to point to
+		while (current != nullptr) // everything to the left comes first
+		{
+			pending[depth++] = current;
+			current = current->left;
+		}
+		current = pending[--depth];
+		frozen.m_keys.push_back(current->m_key);
+		frozen.m_values.push_back(current->m_value);
+		current = current->right;
 	}
 }
 
-// recursive delete function. deletes root and its subtrees
-template<typename KeyType, typename ValueType>
-void MyMap<KeyType, ValueType>::deleteThis(typename MyMap<KeyType, ValueType>::Node* toBeDeleted)
+// deletes all of tree without recursing. whenever the current node has a left child, that child
+// is rotated up in its place, so the loop only ever has to walk down right links
+template<typename KeyType, typename ValueType, template<typename> class NodeAllocator>
+void MyMap<KeyType, ValueType, NodeAllocator>::deleteAll()
+{
+	Node* current = m_rootPtr;
+	while (current != nullptr)
+	{
+		if (current->left != nullptr)
+		{
+			Node* left = current->left;
+			current->left = left->right;
+			left->right = current;
+			current = left;
+		}
+		else
+		{
+			Node* next = current->right;
+			current->~Node();
+			m_nodes.deallocate(current);
+			current = next;
+		}
+	}
+	m_nodes.release(); // with the arena this is where all the memory actually goes back
+	m_size = 0; // so now it's an empty tree
+	m_rootPtr = nullptr; // and so the root pointer has nothing to point to
+}
+
+template<typename KeyType, typename ValueType, template<typename> class NodeAllocator>
+void MyMap<KeyType, ValueType, NodeAllocator>::updateHeight(Node* node)
+{
+	int leftHeight = heightOf(node->left), rightHeight = heightOf(node->right);
+	node->height = (leftHeight > rightHeight ? leftHeight : rightHeight) + 1;
+}
+
+template<typename KeyType, typename ValueType, template<typename> class NodeAllocator>
+void MyMap<KeyType, ValueType, NodeAllocator>::rotateLeft(Node* &subtree)
 {
-	if (toBeDeleted == nullptr) // get out of this function call!!!
-		return;
+	Node* newRoot = subtree->right;
+	subtree->right = newRoot->left;
+	newRoot->left = subtree;
+	updateHeight(subtree);
+	updateHeight(newRoot);
+	subtree = newRoot;
+}
 
-	if (toBeDeleted->left != nullptr)
-		deleteThis(toBeDeleted->left); // delete the left subtree
-	if (toBeDeleted->right != nullptr)
-		deleteThis(toBeDeleted->right); // delete the right subtree
+template<typename KeyType, typename ValueType, template<typename> class NodeAllocator>
+void MyMap<KeyType, ValueType, NodeAllocator>::rotateRight(Node* &subtree)
+{
+	Node* newRoot = subtree->left;
+	subtree->left = newRoot->right;
+	newRoot->right = subtree;
+	updateHeight(subtree);
+	updateHeight(newRoot);
+	subtree = newRoot;
+}
 
-	m_size--;
-	delete toBeDeleted; // both subtrees have been deleted, so delete the node
+template<typename KeyType, typename ValueType, template<typename> class NodeAllocator>
+void MyMap<KeyType, ValueType, NodeAllocator>::rebalance(Node* &subtree)
+{
+	updateHeight(subtree);
+	int balance = heightOf(subtree->left) - heightOf(subtree->right);
+	if (balance > 1) // left side too tall
+	{
+		if (heightOf(subtree->left->left) < heightOf(subtree->left->right))
+			rotateLeft(subtree->left); // left-right case turns into left-left
+		rotateRight(subtree);
+	}
+	else if (balance < -1) // right side too tall
+	{
+		if (heightOf(subtree->right->right) < heightOf(subtree->right->left))
+			rotateRight(subtree->right); // right-left case turns into right-right
+		rotateLeft(subtree);
+	}
 }
 
 #endif // for MY_MAP
\ No newline at end of file
@@ -1,274 +1,615 @@
 #include "provided.h"
-#include "MyMap.h"
 #include "support.h"
+#include "RoadGraph.h"
+#include "SpatialIndex.h"
+#include "RouteSearch.h"
+#include "ContractionHierarchy.h"
+#include "LandmarkTable.h"
 #include <string>
 #include <vector>
 #include <queue>
-#include <list>
-#include <stack>
 #include <functional>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <memory>
 using namespace std;
 
-// equality comparison operator for geocoords. compares their strings
-bool operator ==(const GeoCoord &LHS, const GeoCoord &RHS)
-{
-	return LHS.latitudeText == RHS.latitudeText && LHS.longitudeText == RHS.longitudeText;
-}
-
 class NavigatorImpl
 {
 public:
 	NavigatorImpl();
 	~NavigatorImpl();
 	bool loadMapData(string mapFile);
+	bool applyPatch(string patchFile);
 	NavResult navigate(string start, string end, vector<NavSegment>& directions) const;
+	NavResult navigate(const GeoCoord &start, const GeoCoord &end, vector<NavSegment>& directions) const;
+	vector<NearbyAttraction> nearestAttractions(const GeoCoord &gc, size_t k, bool byRoad) const;
+	NavResult distanceMatrix(const vector<string> &sources, const vector<string> &targets, vector<vector<double>> &distances) const;
+	bool saveHierarchy(string hierarchyFile) const;
+	bool loadHierarchy(string hierarchyFile);
+	bool buildLandmarks(size_t count);
+	void setRoutingMode(RoutingMode mode) { m_routingMode.store(mode); }
+	RoutingMode getRoutingMode() const { return m_routingMode.load(); }
 
 private:
-	MapLoader* mapper;
-	SegmentMapper segMapper;
-	AttractionMapper attractMapper;
-	// determines direction by calling angleOfLine()
-	string directionToTravel(const GeoCoord &begin, const GeoCoord &end) const;
-	// determines distance by calling distanceEarthMiles()
-	double distanceToTravel(const GeoCoord &begin, const GeoCoord &end) const;
-	// surprisingly tricky function. takes the end coordinate and traces back to determine order in which geoCoords
-	// were reached. then it constructs NavSegments from that knowledge
-	void reconstructPath(GeoCoord endCoord, vector<NavSegment> &path, MyMap<GeoCoord, GeoCoord> *ptrToPriorsMap) const;
-
-	// used in priority_queue. contains two GeoCoords, itself and its parent.
-	// operator < is sort of confusing. it does THE REVERSE of what might be expected.
-	// this is done so that priority_queue can order from least to greatest f_score
-	class AugmentedGeoCoord {
-	public:
-		AugmentedGeoCoord(const GeoCoord &gc, const GeoCoord &end, const GeoCoord &previousCoord, double g_sc);
-		bool operator <(const AugmentedGeoCoord &RHS) const
-		{
-			return f_score > RHS.f_score;
-		}
-		bool operator ==(const AugmentedGeoCoord &RHS) const
+	// everything navigate needs for one loaded map. loadMapData and applyPatch build a whole new
+	// one off to the side and then swap it in, so queries already running keep using the version
+	// they started with
+	struct MapVersion
+	{
+		MapVersion() : hierarchy(nullptr), landmarks(nullptr), refs(1) {} // the one reference belongs to m_current until it's replaced
+		~MapVersion()
 		{
-			return coord == RHS.coord;
+			for (ContractionHierarchy* loaded : hierarchies)
+				delete loaded;
 		}
-		void updateGScore(double newScore) { g_score = newScore; f_score = g_score + h_score; }
-		GeoCoord getGeoCoord() const { return coord; }
-		GeoCoord getPreviousCoord() const { return prevCoord; }
-		double getFScore() const { return f_score; }
-		double getGScore() const { return g_score; }
-	private:
-		GeoCoord coord;
-		GeoCoord prevCoord; // make sure that this is nullptr for the starting location
-		double g_score; // distance from start to coord. initialized to 10000 for all but start
-		double h_score; // distance from coord to end location
-		double f_score; // sum of g and h scores
+		MapLoader loader; // declared first so it's destroyed after the mappers that point into it
+		SegmentMapper segMapper;
+		AttractionMapper attractMapper;
+		RoadGraph graph; // built from the loader and segMapper once they're ready
+		SpatialIndex spatial; // for coordinates that aren't exactly on the map
+		// the hierarchy ROUTE_HIERARCHY uses, or nullptr. one that's replaced is kept in hierarchies
+		// until the version goes, since a query may still be using it
+		atomic<const ContractionHierarchy*> hierarchy;
+		vector<ContractionHierarchy*> hierarchies; // only writers touch this
+		// the landmarks ROUTE_LANDMARKS uses, or nullptr. kept the same way as the hierarchy, but
+		// shared, since a version patched from this one may still be able to use them
+		atomic<const LandmarkTable*> landmarks;
+		vector<shared_ptr<const LandmarkTable>> landmarkTables; // only writers touch this
+		atomic<long> refs;
 	};
 
-	class HashTable
+	// holds a reference to the current MapVersion for as long as it's in scope
+	class PinnedMap
 	{
 	public:
-		HashTable();
-		bool find(const GeoCoord &coord);
-		void insert(GeoCoord coord);
-		//void remove(GeoCoord coord);
-		~HashTable();
+		PinnedMap(const NavigatorImpl* nav) : m_nav(nav), m_version(nav->pin()) {}
+		~PinnedMap() { m_nav->unpin(m_version); }
+		bool loaded() const { return m_version != nullptr; }
+		const MapVersion& operator*() const { return *m_version; }
+		const MapVersion* operator->() const { return m_version; }
+		PinnedMap(const PinnedMap&) = delete;
+		PinnedMap& operator=(const PinnedMap&) = delete;
 	private:
-		// less memory-intensive at the start than have an array of vectors
-		/*vector<GeoCoord> *gcArr[2500];*/
-		list<GeoCoord> *gcArr[2500];
-		// using this hash function to hash strings (latitudeText to be exact) so I'm praying
-		// that two geocoords only have the exact same latitude when they're actually the same
-		// just going to has the latitude of geocoord
-		hash<string> string_hash;
+		const NavigatorImpl* m_nav;
+		MapVersion* m_version;
 	};
 
-	bool shouldAddToOpenSet(GeoCoord coordToCheck, HashTable* ptrToClosedSet, MyMap <GeoCoord, double> *ptrToFScoreMap, double fScore) const;
+	atomic<MapVersion*> m_current;
+	// readers between loading m_current and counting themselves in its refs, counted under the
+	// epoch they started in. publish bumps the epoch after swapping m_current, then waits for the old
+	// epoch's count to drain; readers arriving after that count under the new epoch, so a steady
+	// stream of them can't keep the writer waiting
+	mutable atomic<unsigned long> m_epoch;
+	mutable atomic<long> m_pinning[2];
+	mutex m_writerMutex; // only writers (loadMapData, applyPatch) ever take this
+	atomic<RoutingMode> m_routingMode;
+
+	MapVersion* pin() const;
+	void unpin(MapVersion* version) const;
+	// makes version the current one. the caller holds m_writerMutex
+	void publish(MapVersion* version);
+	// a patched map is compacted once more than 1 in this many of its segments are patched ones
+	static const size_t COMPACT_DIVISOR = 8;
+
+	// finds the number of the segment a patch op edits, using the mappers' indexes
+	bool findPatchTarget(const MapVersion &map, const MapPatchOp &op, size_t &segNum) const;
+
+	// where a route starts or ends: either a node of the graph, or a point partway along a segment
+	// that a coordinate was snapped to
+	struct RouteEnd
+	{
+		GeoCoord coord;
+		uint32_t node; // RoadGraph::NO_NODE if coord is partway along segment
+		size_t segment; // only used when node is NO_NODE
+	};
+	// moves gc onto the closest street. false only if the map has no streets
+	bool snapToMap(const MapVersion &map, const GeoCoord &gc, RouteEnd &end) const;
+	// the k attractions closest to from along the streets, closest first
+	void attractionsByRoad(const MapVersion &map, const RouteEnd &from, size_t k, vector<NearbyAttraction> &nearby) const;
+	// the search both versions of navigate share
+	NavResult findRoute(const MapVersion &map, const RouteEnd &from, const RouteEnd &to, vector<NavSegment> &directions) const;
+	// determines direction by calling angleOfLine()
+	string directionToTravel(const GeoCoord &begin, const GeoCoord &end) const;
+	// determines distance by calling distanceEarthMiles()
+	double distanceToTravel(const GeoCoord &begin, const GeoCoord &end) const;
+	// surprisingly tricky function. takes the coords of the route, start to end, and constructs
+	// NavSegments from them. steps are what the search found, one per coord, and each names the
+	// segment the hop into its coord ran along
+	void reconstructPath(const MapVersion &map, const vector<const GeoCoord*> &route, const vector<RouteStep> &steps,
+		vector<NavSegment> &path) const;
 };
 
+// one per thread and kept between routes, so a search doesn't begin by allocating arrays the size of the map
+static RouteSearch& threadSearch()
+{
+	static thread_local RouteSearch search;
+	return search;
+}
+
 NavigatorImpl::NavigatorImpl()
+	: m_current(nullptr), m_epoch(0), m_routingMode(ROUTE_ASTAR)
 {
+	m_pinning[0].store(0);
+	m_pinning[1].store(0);
 }
 
 NavigatorImpl::~NavigatorImpl()
 {
-	delete mapper;
+	unpin(m_current.load()); // nobody can still be navigating once we're being destroyed
 }
 
+// safe to call while other threads are navigating. they never wait for the new map to be built,
+// and if the file can't be loaded the map that was already there stays in use
 bool NavigatorImpl::loadMapData(string mapFile)
 {
-	mapper = new MapLoader;
-	if (!mapper->load(mapFile)) // if there was some issue loading the file, return false
+	MapVersion* fresh = new MapVersion;
+	if (!fresh->loader.load(mapFile)) // if there was some issue loading the file, return false
+	{
+		delete fresh;
 		return false;
-	else // otherwise, initialize the other mappers
+	}
+	fresh->segMapper.init(fresh->loader); // otherwise, initialize the other mappers
+	fresh->attractMapper.init(fresh->loader);
+	fresh->graph.build(fresh->loader, fresh->segMapper);
+	fresh->spatial.build(fresh->loader);
+	lock_guard<mutex> lock(m_writerMutex);
+	publish(fresh);
+	return true;
+}
+
+// readers never block: pinning is two counter updates around reading the current pointer
+NavigatorImpl::MapVersion* NavigatorImpl::pin() const
+{
+	for (;;)
 	{
-		segMapper.init(*mapper);
-		attractMapper.init(*mapper);
-		return true;
+		unsigned long epoch = m_epoch.load();
+		atomic<long> &pinning = m_pinning[epoch & 1];
+		pinning.fetch_add(1);
+		// if a writer moved the epoch on before we were counted, it may already have seen this count
+		// at zero, so count again under the new one. that happens at most once per publish
+		if (m_epoch.load() != epoch)
+		{
+			pinning.fetch_sub(1);
+			continue;
+		}
+		MapVersion* version = m_current.load();
+		if (version != nullptr)
+			version->refs.fetch_add(1);
+		pinning.fetch_sub(1);
+		return version;
 	}
 }
 
-NavResult NavigatorImpl::navigate(string start, string end, vector<NavSegment> &directions) const
+void NavigatorImpl::unpin(MapVersion* version) const
 {
-	GeoCoord startGC, endGC;
-	if (!attractMapper.getGeoCoord(start, startGC))
-		return NAV_BAD_SOURCE;
-	if (!attractMapper.getGeoCoord(end, endGC))
-		return NAV_BAD_DESTINATION;
+	if (version != nullptr && version->refs.fetch_sub(1) == 1) // last one out frees the old map
+		delete version;
+}
+
+void NavigatorImpl::publish(MapVersion* version)
+{
+	MapVersion* old = m_current.exchange(version);
+	// a reader that loaded the old pointer may not have added itself to refs yet, but it's counted
+	// under the epoch that's ending here. once that count has been seen at zero, every such reader
+	// has, so dropping m_current's reference can't free the map out from under anyone. only readers
+	// already partway through pin are waited for, so this spins for a few instructions' worth
+	unsigned long ending = m_epoch.fetch_add(1);
+	while (m_pinning[ending & 1].load() != 0)
+		this_thread::yield();
+	unpin(old);
+}
 
-	MyMap<GeoCoord, GeoCoord> previousGeoCoordMap; // associates GeoCoords with parent
-	MyMap<GeoCoord, double> fScoresOfClosedSet; // useful in deciding if something needs to be added to openSet
-	HashTable closedSet; // contains geocoords that have already been "relaxed"
+// the patched map is a new version, so queries already running carry on with the one they started
+// with. it starts out sharing everything with the current one, and only copies what the patch changes
+bool NavigatorImpl::applyPatch(string patchFile)
+{
+	lock_guard<mutex> lock(m_writerMutex); // so another patch or load can't be published in between
+	MapVersion* map = m_current.load();
+	vector<MapPatchOp> ops;
+	if (map == nullptr || !map->loader.readPatch(patchFile, ops))
+		return false;
 
-	// contains geocoords that need to be relaxed. ordered based on lowest f_score (sum of g and h scores)
-	priority_queue<AugmentedGeoCoord> openSet;
-	GeoCoord sentinel("-360", "-360");
-	openSet.emplace(startGC, endGC, sentinel, 0);
-	while (!openSet.empty())
+	MapVersion* patched = new MapVersion;
+	patched->loader.loadFrom(map->loader);
+	patched->segMapper.initFrom(map->segMapper, patched->loader);
+	patched->attractMapper.initFrom(map->attractMapper);
+	patched->graph.initFrom(map->graph);
+	patched->spatial.initFrom(map->spatial);
+	vector<MapChange> allChanges; // the spatial index takes them all at once, it repacks a little each time
+	bool onlyRemoved = true;
+	bool allApplied = true;
+	for (const MapPatchOp &op : ops)
 	{
-		AugmentedGeoCoord current = openSet.top(); // get a new AugmentedGeoCoord for each iteration
-		openSet.pop();
-		// if current geocoord is the end geocoord, it means we've found the most efficient way to the end
-		if (current.getGeoCoord() == endGC)
-		{
-			directions.clear(); // clear the vector of NavSegments
-			previousGeoCoordMap.associate(current.getGeoCoord(), current.getPreviousCoord()); // add to map of children to parents
-			reconstructPath(endGC, directions, &previousGeoCoordMap); // go from geocoords to NavSegments by interpolation
-			return NAV_SUCCESS;
-		}
-		if (closedSet.find(current.getGeoCoord())) // see if its coordinates match something on the closed list
+		size_t segNum = 0; // new segments don't have a number yet
+		if (op.type != MapPatchOp::ADD_SEGMENT && !findPatchTarget(*patched, op, segNum))
 		{
-			// there should always be a corresponding entry for the coord in fScores map because
-			// it's added whenever an entry is added to closedSet
-			if (*fScoresOfClosedSet.find(current.getGeoCoord()) < current.getFScore())
-				continue; // if it didn't arrive faster, don't do anything with it
-			else
-			{
-				previousGeoCoordMap.associate(current.getGeoCoord(), current.getPreviousCoord());
-				fScoresOfClosedSet.associate(current.getGeoCoord(), current.getFScore());
-			}
-		}
-		else
-		{
-			closedSet.insert(current.getGeoCoord()); // add it to closed set if it's not already there
-			// associate current geocoord to its parent
-			previousGeoCoordMap.associate(current.getGeoCoord(), current.getPreviousCoord());
-			// add f_score to map for later use in checking what should be added to open set
-			fScoresOfClosedSet.associate(current.getGeoCoord(), current.getFScore());
+			allApplied = false; // nothing on the map matches, so skip this op
+			continue;
 		}
+		// apply one op at a time so a later op in the same patch can find what an earlier one added
+		vector<MapChange> changes;
+		if (!patched->loader.applyPatchOp(op, segNum, changes))
+			allApplied = false;
+		patched->segMapper.applyChanges(changes);
+		patched->attractMapper.applyChanges(changes);
+		patched->graph.applyChanges(changes, patched->loader, patched->segMapper);
+		allChanges.insert(allChanges.end(), changes.begin(), changes.end());
+		for (const MapChange &change : changes)
+			if (change.type == MapChange::SEGMENT_ADDED || change.type == MapChange::ATTRACTION_ADDED)
+				onlyRemoved = false;
+	}
+	// every version after this copies the list of patched segments, so once it's long enough the
+	// map gets one of its own, built the way a load would. that costs a load every so many patched
+	// segments instead of a longer list to copy on every patch
+	bool compacted = patched->loader.getNumPatched() * COMPACT_DIVISOR > patched->loader.getNumSegments();
+	if (compacted)
+	{
+		patched->loader.compact();
+		patched->segMapper.init(patched->loader);
+		patched->attractMapper.init(patched->loader);
+		patched->graph.build(patched->loader, patched->segMapper);
+		patched->spatial.build(patched->loader);
+	}
+	else
+		patched->spatial.applyChanges(allChanges, patched->loader, patched->segMapper);
+	// the edges have changed, so a hierarchy for the old graph is no use. landmarks are distances on
+	// the old map, and taking streets away can only make routes longer, so after a patch that only
+	// removed things they're still never more than the real distance and can be kept (as long as the
+	// graph wasn't built again, which renumbers the nodes). anything added could be a shortcut they'd
+	// overestimate, so then they're dropped and ROUTE_LANDMARKS is plain A* until they're built again
+	const LandmarkTable* landmarks = map->landmarks.load();
+	if (landmarks != nullptr && onlyRemoved && !compacted)
+	{
+		for (const shared_ptr<const LandmarkTable> &table : map->landmarkTables)
+			if (table.get() == landmarks)
+				patched->landmarkTables.push_back(table);
+		patched->landmarks.store(landmarks);
+	}
+	publish(patched);
+	return allApplied;
+}
+
+bool NavigatorImpl::saveHierarchy(string hierarchyFile) const
+{
+	PinnedMap map(this);
+	return map.loaded() && ContractionHierarchy::write(map->graph, hierarchyFile);
+}
+
+bool NavigatorImpl::loadHierarchy(string hierarchyFile)
+{
+	lock_guard<mutex> lock(m_writerMutex); // so a patch can't replace the map while it's being checked
+	MapVersion* map = m_current.load();
+	if (map == nullptr)
+		return false;
+	ContractionHierarchy* loaded = new ContractionHierarchy;
+	if (!loaded->open(hierarchyFile, map->graph))
+	{
+		delete loaded;
+		return false;
+	}
+	map->hierarchies.push_back(loaded);
+	map->hierarchy.store(loaded);
+	return true;
+}
+
+bool NavigatorImpl::buildLandmarks(size_t count)
+{
+	lock_guard<mutex> lock(m_writerMutex); // so a patch can't replace the map before they're in it
+	MapVersion* map = m_current.load();
+	if (map == nullptr || count == 0)
+		return false;
+	shared_ptr<LandmarkTable> built = make_shared<LandmarkTable>();
+	built->build(map->graph, count);
+	map->landmarkTables.push_back(built);
+	map->landmarks.store(built.get());
+	return true;
+}
+
+bool NavigatorImpl::findPatchTarget(const MapVersion &map, const MapPatchOp &op, size_t &segNum) const
+{
+	// segments are found through a coordinate they touch: the start of the named segment, or
+	// for an attraction that's only given by name, wherever the attraction mapper says it is
+	GeoCoord where = op.segment.segment.start;
+	if (op.type == MapPatchOp::REMOVE_ATTRACTION && !map.attractMapper.getGeoCoord(op.attraction.name, where))
+		return false;
 
-		vector<StreetSegment> neighboringSegments = segMapper.getSegments(current.getGeoCoord());
-		// iterate through all segments and add whatever coords can be added to the open set
-		for (auto iter : neighboringSegments)
+	// the name is lowered once, and each attraction's is compared to it right where it's stored
+	string lowerName;
+	if (op.type == MapPatchOp::REMOVE_ATTRACTION)
+	{
+		lowerName = op.attraction.name;
+		for (size_t i = 0; i < lowerName.size(); i++)
+			lowerName[i] = asciiLower(lowerName[i]);
+	}
+	vector<size_t> candidates = map.segMapper.getSegmentNumbers(where);
+	for (size_t candidate : candidates)
+	{
+		const StreetSegment* seg = map.loader.getSegment(candidate);
+		if (op.type == MapPatchOp::REMOVE_ATTRACTION)
 		{
-			for (size_t i = 0; i < iter.attractions.size(); i++) // check if any segment contains the end destination
+			for (size_t i = 0; i < seg->attractions.size(); i++)
 			{
-				if (iter.attractions[i].geocoordinates == endGC) // if it does,
+				const string &name = seg->attractions[i].name;
+				if (seg->attractions[i].geocoordinates == where && lowerName == NameProbe(name.data(), name.size()))
 				{
-					double newGScore = current.getGScore() + distanceEarthMiles(current.getGeoCoord(), endGC);
-					openSet.emplace(endGC, endGC, current.getGeoCoord(), newGScore); // add it to open set so it will eventually rise to the top
+					segNum = candidate;
+					return true;
 				}
 			}
+		}
+		else if (seg->streetName == op.segment.streetName && seg->segment.start == op.segment.segment.start &&
+			seg->segment.end == op.segment.segment.end)
+		{
+			segNum = candidate;
+			return true;
+		}
+	}
+	return false;
+}
 
-				// g score is sum of current coord's g scores and distance between current coord and neighbor
-				double newGScoreOfStart = current.getGScore() + distanceEarthMiles(current.getGeoCoord(), iter.segment.start);
-				if (closedSet.find(iter.segment.start)) // see if its coordinates match something on the closed list
-				{
-					double hScore = distanceEarthMiles(iter.segment.start, endGC);
-					//if (*fScoresOfClosedSet.find(current.getGeoCoord) < current.getFScore())
-					//	continue;
-					if (shouldAddToOpenSet(iter.segment.start, &closedSet, &fScoresOfClosedSet, newGScoreOfStart + hScore))
-						openSet.emplace(iter.segment.start, endGC, current.getGeoCoord(), newGScoreOfStart);
-				}
-				else
-					openSet.emplace(iter.segment.start, endGC, current.getGeoCoord(), newGScoreOfStart);
-
-				// g score is sum of current coord's g scores and distance between current coord and neighbor
-				double newGScoreOfEnd = current.getGScore() + distanceEarthMiles(current.getGeoCoord(), iter.segment.end);
-				if (closedSet.find(iter.segment.end)) // see if its coordinates match something on the closed list
-				{
-					double hScore = distanceEarthMiles(iter.segment.end, endGC);
-					if (shouldAddToOpenSet(iter.segment.end, &closedSet, &fScoresOfClosedSet, newGScoreOfEnd + hScore))
-						openSet.emplace(iter.segment.end, endGC, current.getGeoCoord(), newGScoreOfEnd);
-				}
-				else
-					openSet.emplace(iter.segment.end, endGC, current.getGeoCoord(), newGScoreOfEnd);
-
-			} // end for
-	} // end while
+NavResult NavigatorImpl::navigate(string start, string end, vector<NavSegment> &directions) const
+{
+	PinnedMap map(this); // keeps this version of the map alive even if loadMapData swaps in another
+	RouteEnd from, to;
+	if (!map.loaded() || !map->attractMapper.getGeoCoord(start, from.coord))
+		return NAV_BAD_SOURCE;
+	if (!map->attractMapper.getGeoCoord(end, to.coord))
+		return NAV_BAD_DESTINATION;
+	from.node = map->graph.findNode(from.coord);
+	to.node = map->graph.findNode(to.coord);
+	if (from.node == RoadGraph::NO_NODE || to.node == RoadGraph::NO_NODE)
+		return NAV_NO_ROUTE; // can't happen while the graph is built from the same map as the mapper
+	return findRoute(*map, from, to, directions);
+}
 
-	return NAV_NO_ROUTE;  // if you've made it all the way to here, there must not be a valid route
+NavResult NavigatorImpl::navigate(const GeoCoord &start, const GeoCoord &end, vector<NavSegment> &directions) const
+{
+	PinnedMap map(this);
+	RouteEnd from, to;
+	if (!map.loaded() || !snapToMap(*map, start, from))
+		return NAV_BAD_SOURCE;
+	if (!snapToMap(*map, end, to))
+		return NAV_BAD_DESTINATION;
+	return findRoute(*map, from, to, directions);
 }
 
-// determines if a certain coord should be added to the open set
-bool NavigatorImpl::shouldAddToOpenSet(GeoCoord coordToCheck, HashTable* ptrToClosedSet, MyMap <GeoCoord, double> *ptrToFScoreMap, double fScore) const
+NavResult NavigatorImpl::distanceMatrix(const vector<string> &sources, const vector<string> &targets, vector<vector<double>> &distances) const
 {
-	// if pointer is not already in the closed set, it should be added to the open set
-	if (!ptrToClosedSet->find(coordToCheck))
+	PinnedMap map(this);
+	// every name has to be an attraction, the same as for navigate
+	auto findNodes = [&](const vector<string> &names, vector<uint32_t> &nodes)
+	{
+		for (const string &name : names)
+		{
+			GeoCoord gc;
+			if (!map->attractMapper.getGeoCoord(name, gc))
+				return false;
+			nodes.push_back(map->graph.findNode(gc));
+			if (nodes.back() == RoadGraph::NO_NODE) // can't happen while the graph is built from the same map as the mapper
+				return false;
+		}
 		return true;
+	};
+	vector<uint32_t> from, to;
+	if (!map.loaded() || !findNodes(sources, from))
+		return NAV_BAD_SOURCE;
+	if (!findNodes(targets, to))
+		return NAV_BAD_DESTINATION;
+
+	RouteSearch &search = threadSearch();
+	vector<double> all; // a row per source
+	const ContractionHierarchy* hierarchy = map->hierarchy.load();
+	if (m_routingMode.load() == ROUTE_HIERARCHY && hierarchy != nullptr)
+		search.distanceMatrixContracted(map->graph, *hierarchy, from, to, all);
 	else
-		// if f_score of coord is lower than that which was already relaxed, should return true
-		// otherwise, return false
-		return *ptrToFScoreMap->find(coordToCheck) > fScore;
+		search.distanceMatrix(map->graph, from, to, all);
+	distances.assign(sources.size(), vector<double>());
+	for (size_t i = 0; i < sources.size(); i++)
+		distances[i].assign(all.begin() + i * targets.size(), all.begin() + (i + 1) * targets.size());
+	return NAV_SUCCESS;
 }
 
-void NavigatorImpl::reconstructPath(GeoCoord endCoord, vector<NavSegment> &path, MyMap<GeoCoord, GeoCoord> *ptrToPriorsMap) const
+vector<NearbyAttraction> NavigatorImpl::nearestAttractions(const GeoCoord &gc, size_t k, bool byRoad) const
 {
-	// records all coords that were visited. the fact that it's a stack makes reconstructing the path easier
-	// because of last in, first out nature
-	stack<GeoCoord> coordsVisited;
+	PinnedMap map(this);
+	vector<NearbyAttraction> nearby;
+	if (!map.loaded() || k == 0)
+		return nearby;
+	RouteEnd from;
+	if (!byRoad)
+		map->spatial.nearestAttractions(gc, k, nearby);
+	else if (snapToMap(*map, gc, from))
+		attractionsByRoad(*map, from, k, nearby);
+	return nearby;
+}
+
+// Dijkstra out from the start, stopping once k attractions have been settled, so only as much of
+// the map is searched as it takes to find them. distances are what navigate's routes to them would
+// measure: attractions are driven into but never through (unless a segment also ends there)
+void NavigatorImpl::attractionsByRoad(const MapVersion &map, const RouteEnd &from, size_t k, vector<NearbyAttraction> &nearby) const
+{
+	const RoadGraph &graph = map.graph;
+	vector<SearchSeed> seeds;
+	if (from.node != RoadGraph::NO_NODE)
+	{
+		SearchSeed seed = { from.node, 0, RoadGraph::NO_NODE, RouteStep::NO_SEGMENT };
+		seeds.push_back(seed);
+	}
+	else
+	{
+		// partway along a segment, so it's as though that segment's ends and attractions were its edges
+		const StreetSegment* seg = map.loader.getSegment(from.segment);
+		const GeoCoord* segEnds[] = { &seg->segment.start, &seg->segment.end };
+		for (const GeoCoord* segEnd : segEnds)
+		{
+			SearchSeed seed = { graph.findNode(*segEnd), distanceEarthMiles(from.coord, *segEnd), RoadGraph::NO_NODE, static_cast<uint32_t>(from.segment) };
+			seeds.push_back(seed);
+		}
+		for (const Attraction &a : seg->attractions)
+		{
+			SearchSeed seed = { graph.findNode(a.geocoordinates), distanceEarthMiles(from.coord, a.geocoordinates), RouteSearch::INTO_ATTRACTION,
+				static_cast<uint32_t>(from.segment) };
+			seeds.push_back(seed);
+		}
+	}
 
-	coordsVisited.push(endCoord);
-	GeoCoord *ptrToCoord = ptrToPriorsMap->find(endCoord);
-	while (ptrToCoord->latitudeText != "-360") // -360 is sentinel value. means we've traced back to start.
+	RouteSearch &search = threadSearch();
+	search.startNearest(graph, seeds);
+	uint32_t node;
+	double distance;
+	vector<Attraction> here;
+	while (nearby.size() < k && search.nextNearest(graph, node, distance))
 	{
-		coordsVisited.push(*ptrToCoord);
-		ptrToCoord = ptrToPriorsMap->find(*ptrToCoord);
+		if (!graph.hasAttraction(node))
+			continue;
+		map.spatial.attractionsAt(graph.getCoord(node), here);
+		for (size_t i = 0; i < here.size() && nearby.size() < k; i++)
+		{
+			NearbyAttraction found = { here[i], distance };
+			nearby.push_back(found);
+		}
 	}
+}
 
-	while (coordsVisited.size() >= 2) // as long as there's at least a pair of geocoords, go through this
+bool NavigatorImpl::snapToMap(const MapVersion &map, const GeoCoord &gc, RouteEnd &end) const
+{
+	end.node = map.graph.findNode(gc);
+	if (end.node != RoadGraph::NO_NODE) // exactly on the map already, like an attraction's own coords
 	{
-		GeoCoord first = coordsVisited.top();
-		coordsVisited.pop(); // only pop off one each time through. 
-		GeoCoord second = coordsVisited.top();
-		vector<StreetSegment> segmentsOfFirst, segmentsOfSecond;
-		segmentsOfFirst = segMapper.getSegments(first);
-		segmentsOfSecond = segMapper.getSegments(second);
+		end.coord = map.graph.getCoord(end.node);
+		return true;
+	}
+	SegmentSnap snap;
+	if (!map.spatial.nearestSegment(gc, snap))
+		return false;
+	// round to the map data's precision. if that lands on a node (the snap was to the end of a
+	// segment, or to where an attraction is), the route starts or ends there like any other
+	GeoCoord snapped;
+	snapped.latitude = snap.latitude;
+	snapped.longitude = snap.longitude;
+	CoordKey key(snapped);
+	end.node = map.graph.findNode(key);
+	end.coord = end.node != RoadGraph::NO_NODE ? map.graph.getCoord(end.node) : key.toGeoCoord();
+	end.segment = snap.segment;
+	return true;
+}
 
-		StreetSegment associatedSegment; // segment that is associated with both first and second geocoords
+NavResult NavigatorImpl::findRoute(const MapVersion &map, const RouteEnd &from, const RouteEnd &to, vector<NavSegment> &directions) const
+{
+	const GeoCoord &endGC = to.coord;
+	if (CoordKey(from.coord) == CoordKey(endGC)) // already there
+	{
+		directions.clear();
+		return NAV_SUCCESS;
+	}
+	const RoadGraph &graph = map.graph;
+	const StreetSegment* startSegment = from.node == RoadGraph::NO_NODE ? map.loader.getSegment(from.segment) : nullptr;
+	const StreetSegment* endSegment = to.node == RoadGraph::NO_NODE ? map.loader.getSegment(to.segment) : nullptr;
+	// an attraction on the same segment as a snapped point is reached straight along the segment,
+	// not by way of one of its ends
+	auto onSegment = [](const StreetSegment *seg, const GeoCoord &gc)
+	{
+		for (const Attraction &a : seg->attractions)
+			if (a.geocoordinates == gc)
+				return true;
+		return false;
+	};
+	// snapped ends aren't nodes of the graph, so they get the ids the search keeps for them
+	uint32_t sourcePoint = RouteSearch::sourcePoint(graph);
+	uint32_t targetPoint = RouteSearch::targetPoint(graph);
+	uint32_t target = endSegment == nullptr ? to.node : targetPoint;
 
-		for (StreetSegment segmentToCompare : segmentsOfFirst)
+	vector<SearchSeed> seeds;
+	if (startSegment == nullptr)
+	{
+		SearchSeed start = { from.node, 0, RoadGraph::NO_NODE, RouteStep::NO_SEGMENT };
+		seeds.push_back(start);
+	}
+	else
+	{
+		// a snapped start never goes in the open set. the search starts from both ends of its segment
+		// (and from the end, if it's on the same segment) as though it had just been settled
+		const GeoCoord* ends[2] = { &startSegment->segment.start, &startSegment->segment.end };
+		for (const GeoCoord* segEnd : ends)
 		{
-			if ((segmentToCompare.segment.start == first && segmentToCompare.segment.end == second) ||
-				(segmentToCompare.segment.end == first && segmentToCompare.segment.start == second))
-			{
-				// if endpoints match first and second coords, segment must be associated with them
-				associatedSegment = segmentToCompare;
-				break;
-			}
-			else
-			{
-				for (size_t i = 0; i < segmentToCompare.attractions.size(); i++)
-				{
-					if (segmentToCompare.attractions[i].geocoordinates == first ||
-						segmentToCompare.attractions[i].geocoordinates == second)
-					{
-						// if one of the geocoords is an attraction, then it must be associated with
-						// one of its geosegments
-						associatedSegment = segmentToCompare;
-						break;
-					}
-				}
-			}
+			SearchSeed seed = { graph.findNode(*segEnd), distanceEarthMiles(from.coord, *segEnd), sourcePoint, static_cast<uint32_t>(from.segment) };
+			seeds.push_back(seed);
+		}
+		if ((endSegment != nullptr && from.segment == to.segment) || (endSegment == nullptr && onSegment(startSegment, endGC)))
+		{
+			SearchSeed straight = { target, distanceEarthMiles(from.coord, endGC), sourcePoint, static_cast<uint32_t>(from.segment) };
+			seeds.push_back(straight);
 		}
+	}
+	// a snapped end can only be reached along its own segment: from either end of it, or from the
+	// start if that's an attraction on it
+	vector<TargetStep> targetSteps;
+	if (endSegment != nullptr)
+	{
+		uint32_t steps[3] = { graph.findNode(endSegment->segment.start), graph.findNode(endSegment->segment.end), RoadGraph::NO_NODE };
+		if (startSegment == nullptr && onSegment(endSegment, from.coord))
+			steps[2] = from.node;
+		for (uint32_t node : steps)
+		{
+			if (node == RoadGraph::NO_NODE)
+				continue;
+			TargetStep step = { node, distanceEarthMiles(graph.getCoord(node), endGC), static_cast<uint32_t>(to.segment) };
+			targetSteps.push_back(step);
+		}
+	}
+
+	RouteSearch &search = threadSearch();
+	vector<RouteStep> ids;
+	RoutingMode mode = m_routingMode.load();
+	const ContractionHierarchy* hierarchy = map.hierarchy.load();
+	const LandmarkTable* landmarks = map.landmarks.load();
+	bool found;
+	if (mode == ROUTE_HIERARCHY && hierarchy != nullptr)
+		found = search.shortestPathContracted(graph, *hierarchy, seeds, target, targetSteps, ids);
+	else if (mode == ROUTE_LANDMARKS && landmarks != nullptr)
+		found = search.shortestPathLandmarks(graph, *landmarks, seeds, target, endGC, targetSteps, ids);
+	else if (mode == ROUTE_BIDIRECTIONAL)
+		found = search.shortestPathBidirectional(graph, seeds, target, from.coord, endGC, targetSteps, ids);
+	else
+		found = search.shortestPath(graph, seeds, target, endGC, targetSteps, ids);
+	if (!found)
+		return NAV_NO_ROUTE;
+
+	vector<const GeoCoord*> route;
+	route.reserve(ids.size());
+	for (size_t i = 0; i + 1 < ids.size(); i++)
+		route.push_back(ids[i].node == sourcePoint ? &from.coord : &graph.getCoord(ids[i].node));
+	route.push_back(&endGC); // the coord navigate was asked for, not just one that matches it
+	directions.clear();
+	reconstructPath(map, route, ids, directions);
+	return NAV_SUCCESS;
+}
+
+void NavigatorImpl::reconstructPath(const MapVersion &map, const vector<const GeoCoord*> &route, const vector<RouteStep> &steps,
+	vector<NavSegment> &path) const
+{
+	for (size_t i = 0; i + 1 < route.size(); i++) // every pair of consecutive coords is one proceed
+	{
+		const GeoCoord &first = *route[i];
+		const GeoCoord &second = *route[i + 1];
+		CoordKey firstKey(first);
+		// the segment the search went from first to second along. for a snapped end that's the one
+		// it's on, and for an attraction partway along a segment, that segment
+		const StreetSegment* associatedSegment = map.loader.getSegment(steps[i + 1].segment);
 
 		if (!path.empty())
 		{
 			// if there's a change in street name, there must have been a turn!
-			if (associatedSegment.streetName != path.back().m_streetName)
+			if (associatedSegment->streetName != path.back().m_streetName)
 			{
 				// construct a geosegment to represent the street. have it go in the proper
 				// direction, otherwise angle between 2 lines might return exactly the wrong direction
 				GeoCoord oldStreetStart;
 				GeoCoord oldStreetEnd = first;
-				if (path.back().m_geoSegment.start == first)
+				if (CoordKey(path.back().m_geoSegment.start) == firstKey)
 					oldStreetStart = path.back().m_geoSegment.start;
 				else
 					oldStreetStart = path.back().m_geoSegment.end;
@@ -283,12 +624,12 @@ void NavigatorImpl::reconstructPath(GeoCoord endCoord, vector<NavSegment> &path,
 					direction = "left";
 				else
 					direction = "right";
-				path.emplace_back(direction, associatedSegment.streetName);
+				path.emplace_back(direction, associatedSegment->streetName);
 			}
 		}
 		// add a proceed statement from first coord to second coord for every pair of coords
-		path.emplace_back(directionToTravel(first, second), associatedSegment.streetName,
-			distanceToTravel(first, second), associatedSegment.segment);
+		path.emplace_back(directionToTravel(first, second), associatedSegment->streetName,
+			distanceToTravel(first, second), associatedSegment->segment);
 	}
 }
 
@@ -304,75 +645,72 @@ double NavigatorImpl::distanceToTravel(const GeoCoord &begin, const GeoCoord & e
 	return distanceEarthMiles(begin, end);
 }
 
-NavigatorImpl::HashTable::HashTable()
-	: gcArr{ nullptr } // just to be safe. initialize all elements to nullptr
-{}
+//******************** Navigator functions ************************************
+
+// These functions simply delegate to NavigatorImpl's functions.
+// You probably don't want to change any of this code.
 
-bool NavigatorImpl::HashTable::find(const GeoCoord &coord)
+Navigator::Navigator()
 {
-	// use STL's hash function and hash to array of 2500
-	size_t hashedValue = string_hash(coord.latitudeText) % 2500;
-	// if the list pointer is nullptr, coord can't be there
-	if (gcArr[hashedValue] != nullptr)
-		for (GeoCoord geo : *gcArr[hashedValue]) // iterate through list
-			if (geo == coord) // and check if there's a match
-				return true;
-	return false;
+	m_impl = new NavigatorImpl;
 }
 
-void NavigatorImpl::HashTable::insert(GeoCoord coord)
+Navigator::~Navigator()
 {
-	// use hash function to find where coord should be hashed to
-	size_t hashedValue = string_hash(coord.latitudeText) % 2500;
-	// if the list doesn't already exist, make one
-	if (gcArr[hashedValue] == nullptr)
-		gcArr[hashedValue] = new list<GeoCoord>;
-	for (GeoCoord gc : *gcArr[hashedValue])
-		if (gc == coord) // don't insert something that's already there
-			return;
-	gcArr[hashedValue]->push_back(coord); // otherwise, push_back coord into list
+	delete m_impl;
 }
 
-NavigatorImpl::HashTable::~HashTable()
+bool Navigator::loadMapData(string mapFile)
 {
-	for (auto gcIter : gcArr)
-		if (gcIter != nullptr) // if vector pointer points to a vector, 
-			delete gcIter;  // delete that vector
+	return m_impl->loadMapData(mapFile);
 }
 
-NavigatorImpl::AugmentedGeoCoord::AugmentedGeoCoord(const GeoCoord &gc, const GeoCoord &end, const GeoCoord &previousCoord, double g_sc)
+bool Navigator::applyPatch(string patchFile)
 {
-	coord = gc;
-	prevCoord = previousCoord;
-	// distance required to get to point
-	g_score = g_sc;
-	// save some work on the call by doing this computation during initailization
-	h_score = distanceEarthMiles(coord, end); // compute distance from geocoord to end
-	// sum of scores. priority_queue compares f_scores and selects lowest
-	f_score = g_score + h_score;
+	return m_impl->applyPatch(patchFile);
 }
 
-//******************** Navigator functions ************************************
+NavResult Navigator::navigate(string start, string end, vector<NavSegment>& directions) const
+{
+	return m_impl->navigate(start, end, directions);
+}
 
-// These functions simply delegate to NavigatorImpl's functions.
-// You probably don't want to change any of this code.
+NavResult Navigator::navigate(const GeoCoord& start, const GeoCoord& end, vector<NavSegment>& directions) const
+{
+	return m_impl->navigate(start, end, directions);
+}
 
-Navigator::Navigator()
+vector<NearbyAttraction> Navigator::nearestAttractions(const GeoCoord& gc, size_t k, bool byRoad) const
 {
-	m_impl = new NavigatorImpl;
+	return m_impl->nearestAttractions(gc, k, byRoad);
 }
 
-Navigator::~Navigator()
+NavResult Navigator::distanceMatrix(const vector<string> &sources, const vector<string> &targets, vector<vector<double>> &distances) const
 {
-	delete m_impl;
+	return m_impl->distanceMatrix(sources, targets, distances);
 }
 
-bool Navigator::loadMapData(string mapFile)
+bool Navigator::saveHierarchy(string hierarchyFile) const
 {
-	return m_impl->loadMapData(mapFile);
+	return m_impl->saveHierarchy(hierarchyFile);
 }
 
-NavResult Navigator::navigate(string start, string end, vector<NavSegment>& directions) const
+bool Navigator::loadHierarchy(string hierarchyFile)
 {
-	return m_impl->navigate(start, end, directions);
+	return m_impl->loadHierarchy(hierarchyFile);
+}
+
+bool Navigator::buildLandmarks(size_t count)
+{
+	return m_impl->buildLandmarks(count);
+}
+
+void Navigator::setRoutingMode(RoutingMode mode)
+{
+	m_impl->setRoutingMode(mode);
+}
+
+RoutingMode Navigator::getRoutingMode() const
+{
+	return m_impl->getRoutingMode();
 }
@@ -0,0 +1,247 @@
+#include "RoadGraph.h"
+#include <algorithm>
+using namespace std;
+
+RoadGraph::RoadGraph()
+	: m_built(make_shared<Built>()), m_numBuilt(0), m_points(nullptr), m_firstEdge(nullptr), m_edges(nullptr), m_numEdges(0)
+{
+}
+
+RoadGraph::Built::~Built()
+{
+	if (snapshot != nullptr) // the coordinates were made from it, and belong to this
+		for (size_t node = 0; node < points.size(); node++)
+			delete coords[node].load(memory_order_relaxed);
+}
+
+void RoadGraph::build(const MapLoader &ml, const SegmentMapper &sm)
+{
+	shared_ptr<Built> built = make_shared<Built>();
+	m_built = built;
+	m_addedCoords.clear();
+	m_addedKeys.clear();
+	m_addedPoints.clear();
+	m_addedNodes.clear();
+	m_changed.clear();
+	m_mayHaveChanged.reset();
+
+	const MapSnapshot* snapshot = MapSnapshot::unpatched(ml);
+	if (snapshot != nullptr)
+		openSnapshot(*built, *snapshot);
+	else
+		buildFrom(*built, ml, sm);
+	m_numBuilt = static_cast<uint32_t>(built->points.size());
+	m_numEdges = built->edges.size();
+	m_points = built->points.data();
+	m_firstEdge = built->firstEdge.data();
+	m_edges = built->edges.data();
+}
+
+void RoadGraph::buildFrom(Built &built, const MapLoader &ml, const SegmentMapper &sm)
+{
+	// number the nodes in the order the map data mentions them
+	vector<const GeoCoord*> coords;
+	vector<CoordKey> keys;
+	vector<GeoPoint> points;
+	vector<uint8_t> attractionNodes;
+	auto addNode = [&](const GeoCoord &gc) -> uint32_t
+	{
+		CoordKey key(gc);
+		pair<uint32_t*, bool> added = built.nodes.emplace(key, static_cast<uint32_t>(coords.size()));
+		if (added.second)
+		{
+			coords.push_back(&gc);
+			keys.push_back(key);
+			points.push_back(GeoPoint(gc));
+			attractionNodes.push_back(0);
+		}
+		return *added.first;
+	};
+	for (const StreetSegment &seg : ml)
+	{
+		addNode(seg.segment.start);
+		addNode(seg.segment.end);
+		for (const Attraction &a : seg.attractions)
+			attractionNodes[addNode(a.geocoordinates)] = 1;
+	}
+	m_numBuilt = static_cast<uint32_t>(coords.size());
+	built.coords.reset(new atomic<const GeoCoord*>[m_numBuilt]);
+	for (uint32_t node = 0; node < m_numBuilt; node++)
+		built.coords[node].store(coords[node], memory_order_relaxed);
+	built.keys.assign(move(keys));
+	built.points.assign(move(points));
+	built.attractionNodes.assign(move(attractionNodes));
+
+	vector<uint32_t> firstEdge;
+	vector<RoadEdge> edges;
+	firstEdge.reserve(m_numBuilt + 1);
+	for (uint32_t node = 0; node < m_numBuilt; node++)
+	{
+		firstEdge.push_back(static_cast<uint32_t>(edges.size()));
+		// go through the mapper rather than the loader so the edges come out in the same order
+		// navigate used to find them in, which is what it breaks ties between equal routes by
+		addEdges(node, sm.getSegmentNumbers(getCoord(node)), ml, edges);
+	}
+	firstEdge.push_back(static_cast<uint32_t>(edges.size()));
+	edges.shrink_to_fit();
+	built.firstEdge.assign(move(firstEdge));
+	built.edges.assign(move(edges));
+}
+
+// the arrays are read where they are. the coordinates start out empty, and coordFromSnapshot
+// makes them as they're asked for
+void RoadGraph::openSnapshot(Built &built, const MapSnapshot &snapshot)
+{
+	static_assert(sizeof(CoordKey) == sizeof(uint64_t), "GRAPH_KEYS holds CoordKey::bits()");
+	size_t count;
+	built.snapshot = &snapshot;
+	const CoordKey* keys = snapshot.records<CoordKey>(snapshot::GRAPH_KEYS, count);
+	built.keys.view(keys, count);
+	built.coords.reset(new atomic<const GeoCoord*>[count]);
+	for (size_t node = 0; node < count; node++)
+		built.coords[node].store(nullptr, memory_order_relaxed);
+	const GeoPoint* points = snapshot.records<GeoPoint>(snapshot::GRAPH_POINTS, count);
+	built.points.view(points, count);
+	const uint8_t* attractionNodes = snapshot.records<uint8_t>(snapshot::GRAPH_ATTRACTION_NODES, count);
+	built.attractionNodes.view(attractionNodes, count);
+	const uint32_t* firstEdge = snapshot.records<uint32_t>(snapshot::GRAPH_FIRST_EDGE, count);
+	built.firstEdge.view(firstEdge, count);
+	const RoadEdge* edges = snapshot.records<RoadEdge>(snapshot::GRAPH_EDGES, count);
+	built.edges.view(edges, count);
+}
+
+// readers on other threads can get here for the same node at once. each makes its own, and the
+// first one stored is the one everybody keeps
+const GeoCoord& RoadGraph::coordFromSnapshot(uint32_t node) const
+{
+	GeoCoord* made = new GeoCoord;
+	m_built->snapshot->getCoord(node, *made); // a node's number is its coordinate's
+	const GeoCoord* expected = nullptr;
+	if (m_built->coords[node].compare_exchange_strong(expected, made, memory_order_acq_rel, memory_order_acquire))
+		return *made;
+	delete made;
+	return *expected;
+}
+
+void RoadGraph::initFrom(const RoadGraph &other)
+{
+	m_built = other.m_built;
+	m_numBuilt = other.m_numBuilt;
+	m_points = other.m_points;
+	m_firstEdge = other.m_firstEdge;
+	m_edges = other.m_edges;
+	m_addedCoords = other.m_addedCoords;
+	m_addedKeys = other.m_addedKeys;
+	m_addedPoints = other.m_addedPoints;
+	m_addedNodes.copyFrom(other.m_addedNodes);
+	m_changed.copyFrom(other.m_changed);
+	m_mayHaveChanged = other.m_mayHaveChanged;
+	m_numEdges = other.m_numEdges;
+}
+
+void RoadGraph::applyChanges(const vector<MapChange> &changes, const MapLoader &ml, const SegmentMapper &sm)
+{
+	// a node's edges go to everything on every segment at it, so a change to a segment changes the
+	// edges of every node on it, and only those. the nodes go in first so the edges have somewhere to go
+	vector<uint32_t> touched;
+	for (const MapChange &change : changes)
+	{
+		touched.push_back(addPatchedNode(change.segment.segment.start));
+		touched.push_back(addPatchedNode(change.segment.segment.end));
+		for (const Attraction &a : change.segment.attractions)
+			touched.push_back(addPatchedNode(a.geocoordinates));
+		if (change.type == MapChange::ATTRACTION_ADDED || change.type == MapChange::ATTRACTION_REMOVED)
+			touched.push_back(addPatchedNode(change.attraction.geocoordinates));
+	}
+	sort(touched.begin(), touched.end());
+	touched.erase(unique(touched.begin(), touched.end()), touched.end());
+
+	for (uint32_t node : touched)
+	{
+		ChangedNode changed;
+		vector<size_t> segNums = sm.getSegmentNumbers(getCoord(node));
+		addEdges(node, segNums, ml, changed.edges);
+		changed.onMap = !segNums.empty();
+		changed.attraction = false;
+		for (size_t segNum : segNums)
+			for (const Attraction &a : ml.getSegment(segNum)->attractions)
+				if (CoordKey(a.geocoordinates) == getKey(node))
+					changed.attraction = true;
+		const ChangedNode* before = findChanged(node);
+		m_numEdges -= before != nullptr ? before->edges.size() : node < m_numBuilt ? m_firstEdge[node + 1] - m_firstEdge[node] : 0;
+		m_numEdges += changed.edges.size();
+		m_changed.associate(node, move(changed));
+		m_mayHaveChanged.set(node % CHANGED_BITS);
+	}
+}
+
+uint32_t RoadGraph::findNode(const CoordKey &key) const
+{
+	uint32_t node = nodeAt(key);
+	if (node == NO_NODE)
+		return NO_NODE;
+	const ChangedNode* changed = m_changed.find(node);
+	return changed != nullptr && !changed->onMap ? NO_NODE : node;
+}
+
+const RoadEdge* RoadGraph::findEdge(uint32_t from, uint32_t to) const
+{
+	const RoadEdge* found = nullptr;
+	for (const RoadEdge *edge = edgesBegin(from), *end = edgesEnd(from); edge != end; edge++)
+		if (edge->target == to && !edge->toAttraction() && (found == nullptr || edge->length < found->length))
+			found = edge;
+	return found;
+}
+
+uint32_t RoadGraph::nodeAt(const CoordKey &key) const
+{
+	uint32_t coordNum;
+	if (m_built->snapshot != nullptr && m_built->snapshot->findCoord(key, coordNum))
+		return coordNum;
+	const uint32_t* node = m_built->nodes.find(key);
+	if (node == nullptr)
+		node = m_addedNodes.find(key);
+	return node == nullptr ? NO_NODE : *node;
+}
+
+uint32_t RoadGraph::addPatchedNode(const GeoCoord &gc)
+{
+	CoordKey key(gc);
+	uint32_t node = nodeAt(key);
+	if (node != NO_NODE)
+		return node;
+	node = static_cast<uint32_t>(getNumNodes());
+	m_addedNodes.associate(key, node);
+	m_addedCoords.push_back(gc);
+	m_addedKeys.push_back(key);
+	m_addedPoints.push_back(GeoPoint(gc));
+	return node;
+}
+
+void RoadGraph::addEdges(uint32_t node, const vector<size_t> &segNums, const MapLoader &ml, vector<RoadEdge> &edges) const
+{
+	const GeoCoord &here = getCoord(node);
+	CoordKey key = getKey(node);
+	auto addEdge = [&](const GeoCoord &to, uint32_t flags)
+	{
+		uint32_t target = nodeAt(CoordKey(to)); // every coordinate has a node by now
+		if (target == node) // going nowhere never shortens a route
+			return;
+		RoadEdge edge;
+		edge.target = target;
+		edge.segment = flags;
+		// measured from the node's own coord, the way navigate always measured it
+		edge.length = distanceEarthMiles(here, to);
+		edges.push_back(edge);
+	};
+	for (size_t segNum : segNums)
+	{
+		const StreetSegment &seg = *ml.getSegment(segNum);
+		uint32_t from = key == CoordKey(seg.segment.start) || key == CoordKey(seg.segment.end) ? 0 : RoadEdge::FROM_ATTRACTION;
+		uint32_t segment = static_cast<uint32_t>(segNum) | from;
+		for (const Attraction &a : seg.attractions)
+			addEdge(a.geocoordinates, segment | RoadEdge::ATTRACTION);
+		addEdge(seg.segment.start, segment);
+		addEdge(seg.segment.end, segment);
+	}
+}
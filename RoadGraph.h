@@ -0,0 +1,167 @@
+#ifndef ROAD_GRAPH_H
+#define ROAD_GRAPH_H
+
+#include "provided.h"
+#include "support.h"
+#include "MapSnapshot.h"
+#include "MyHashMap.h"
+#include "GeoMath.h"
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+
+// The street map as a graph the search can walk without asking the mappers anything. Every
+// distinct coordinate (segment ends and attractions) gets a dense node number, and the edges
+// leaving each node sit next to each other in one array (compressed sparse row), so the
+// neighbors of node n are edges[firstEdge[n]] up to edges[firstEdge[n + 1]]. Expanding a node is
+// a walk along that range: no vectors get built, no segments get copied, no indexes get searched.
+//
+// A node's edges are the ones navigate always followed: for every segment touching the coordinate,
+// in the order SegmentMapper lists them, an edge to each attraction on the segment followed by one
+// to each end of the segment. Attraction edges are only meant to be taken into the destination,
+// so they're flagged. Edges back to the node they leave from are left out.
+//
+// Every edge has one going the other way, of the same length, so a search can also run backward
+// from the destination by walking the same lists. The only catch is an edge leaving an attraction
+// that isn't one of its segment's ends: the edge coming back along it is an attraction edge, so
+// those are flagged too.
+//
+// A patched map doesn't build its graph again. What build made is shared with the graph it was
+// patched from, and each node the patch touches gets its edges worked out again, the same way,
+// into a list of its own that's used instead. Nodes for coordinates that are new to the map are
+// numbered on from the built ones. Ones that are no longer on the map keep their numbers, so
+// nothing else needs renumbering, but they have no edges and findNode doesn't find them.
+//
+// A map loaded from a snapshot has its graph saved in it, and build reads the arrays from there
+// instead of making them. The snapshot numbers its coordinates the same way, so its coordinate
+// index finds nodes too.
+
+struct RoadEdge
+{
+	static const uint32_t ATTRACTION = 0x80000000u; // set in segment for edges into an attraction
+	static const uint32_t FROM_ATTRACTION = 0x40000000u; // set for edges leaving an attraction partway along the segment
+
+	uint32_t target;	// node number
+	uint32_t segment;	// the loader's number for the segment the edge runs along, plus the flags
+	double length;		// distanceEarthMiles between the two nodes
+
+	bool toAttraction() const { return (segment & ATTRACTION) != 0; }
+	bool fromAttraction() const { return (segment & FROM_ATTRACTION) != 0; } // the way back is an attraction edge
+	size_t segmentNumber() const { return segment & ~(ATTRACTION | FROM_ATTRACTION); }
+};
+
+class RoadGraph
+{
+public:
+	static const uint32_t NO_NODE = static_cast<uint32_t>(-1);
+
+	RoadGraph();
+	// throws away whatever was there and builds the graph for ml's segments as sm indexes them.
+	// ml has to outlive the graph (or the next build), node coordinates point into its segments
+	// (or, if it came from a snapshot that still has its map, the graph is read from there)
+	void build(const MapLoader &ml, const SegmentMapper &sm);
+	// starts out as the same graph as other, to be patched without changing other. what other's
+	// build made is shared rather than copied, apart from the nodes patches have changed since. the
+	// loader other was built from has to outlive this one too, as it does for one made with MapLoader::loadFrom
+	void initFrom(const RoadGraph &other);
+	// works out the edges again for every node on a segment in changes, which MapLoader::applyPatchOp
+	// made to ml. sm has to have had the same changes applied already
+	void applyChanges(const std::vector<MapChange> &changes, const MapLoader &ml, const SegmentMapper &sm);
+
+	size_t getNumNodes() const { return m_numBuilt + m_addedCoords.size(); }
+	size_t getNumEdges() const { return m_numEdges; }
+	uint32_t findNode(const CoordKey &key) const; // NO_NODE if nothing on the map is there
+	uint32_t findNode(const GeoCoord &gc) const { return findNode(CoordKey(gc)); }
+	const GeoCoord& getCoord(uint32_t node) const { return node < m_numBuilt ? builtCoord(node) : m_addedCoords[node - m_numBuilt]; }
+	// the node's coordinate with its trig already done, for the searches' straight-line guesses
+	const GeoPoint& getPoint(uint32_t node) const { return node < m_numBuilt ? m_points[node] : m_addedPoints[node - m_numBuilt]; }
+	// some attraction is at node
+	bool hasAttraction(uint32_t node) const
+	{
+		const ChangedNode* changed = findChanged(node);
+		return changed != nullptr ? changed->attraction : m_built->attractionNodes[node] != 0;
+	}
+	CoordKey getKey(uint32_t node) const { return node < m_numBuilt ? m_built->keys[node] : m_addedKeys[node - m_numBuilt]; }
+	// the street edge from one node to another that a search going through node's edges in order
+	// would keep: the first of the shortest. nullptr if there isn't one
+	const RoadEdge* findEdge(uint32_t from, uint32_t to) const;
+
+	// the edges leaving node, for (const RoadEdge* e = edgesBegin(n), *end = edgesEnd(n); e != end; e++)
+	const RoadEdge* edgesBegin(uint32_t node) const
+	{
+		const ChangedNode* changed = findChanged(node);
+		return changed != nullptr ? changed->edges.data() : m_edges + m_firstEdge[node];
+	}
+	const RoadEdge* edgesEnd(uint32_t node) const
+	{
+		const ChangedNode* changed = findChanged(node);
+		return changed != nullptr ? changed->edges.data() + changed->edges.size() : m_edges + m_firstEdge[node + 1];
+	}
+
+	RoadGraph(const RoadGraph&) = delete;
+	RoadGraph& operator=(const RoadGraph&) = delete;
+private:
+	// what build makes. nothing changes it afterwards, so every graph patched from this one shares it
+	struct Built
+	{
+		Built() : snapshot(nullptr) {}
+		~Built();
+		// one per node, pointing at the first place it was seen. a snapshot has no GeoCoords to
+		// point at, so one read from a snapshot makes each the first time it's asked for
+		std::unique_ptr<std::atomic<const GeoCoord*>[]> coords;
+		FlatArray<CoordKey> keys;				// one per node
+		FlatArray<GeoPoint> points;				// one per node
+		FlatArray<uint8_t> attractionNodes;		// one per node
+		FlatArray<uint32_t> firstEdge;			// one per node plus one past the end
+		FlatArray<RoadEdge> edges;
+		MyHashMap<CoordKey, uint32_t> nodes;	// empty when read from a snapshot, which has its own index
+		const MapSnapshot* snapshot;			// the one it was read from, if it was
+	};
+	// a node a patch has touched, with its edges worked out again
+	struct ChangedNode
+	{
+		std::vector<RoadEdge> edges;
+		bool attraction;
+		bool onMap; // false once every segment at the node has been removed
+	};
+
+	static const size_t CHANGED_BITS = 4096;
+
+	std::shared_ptr<const Built> m_built;
+	uint32_t m_numBuilt; // how many nodes m_built has
+	// m_built's arrays the searches read on every step, so they're one load away rather than two
+	const GeoPoint* m_points;
+	const uint32_t* m_firstEdge;
+	const RoadEdge* m_edges;
+	// nodes patches added. their coordinates are copied, since the segment a node was first seen
+	// on may be patched away while the node is still on other ones
+	std::vector<GeoCoord> m_addedCoords;
+	std::vector<CoordKey> m_addedKeys;
+	std::vector<GeoPoint> m_addedPoints;
+	MyHashMap<CoordKey, uint32_t> m_addedNodes;
+	MyHashMap<uint32_t, ChangedNode> m_changed;
+	// bit node % CHANGED_BITS is set if any node with that remainder is in m_changed. most nodes
+	// aren't, and this tells the searches so without a trip through the hash table
+	std::bitset<CHANGED_BITS> m_mayHaveChanged;
+	size_t m_numEdges;
+
+	const ChangedNode* findChanged(uint32_t node) const { return m_mayHaveChanged[node % CHANGED_BITS] ? m_changed.find(node) : nullptr; }
+
+	const GeoCoord& builtCoord(uint32_t node) const
+	{
+		const GeoCoord* gc = m_built->coords[node].load(std::memory_order_acquire);
+		return gc != nullptr ? *gc : coordFromSnapshot(node);
+	}
+	const GeoCoord& coordFromSnapshot(uint32_t node) const;
+	// fills in built, which has to be m_built already, so edges can be worked out the way patches do
+	void buildFrom(Built &built, const MapLoader &ml, const SegmentMapper &sm);
+	static void openSnapshot(Built &built, const MapSnapshot &snapshot);
+	uint32_t addPatchedNode(const GeoCoord &gc);
+	uint32_t nodeAt(const CoordKey &key) const; // like findNode, but nodes no longer on the map are found too
+	// the edges leaving node along the segments numbered segNums, in that order
+	void addEdges(uint32_t node, const std::vector<size_t> &segNums, const MapLoader &ml, std::vector<RoadEdge> &edges) const;
+};
+
+#endif // for ROAD_GRAPH_H
@@ -0,0 +1,557 @@
+#include "RouteSearch.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+using namespace std;
+
+bool RouteSearch::shortestPath(const RoadGraph &graph, const vector<SearchSeed> &seeds, uint32_t target, const GeoCoord &targetCoord,
+	const vector<TargetStep> &targetSteps, vector<RouteStep> &path)
+{
+	uint32_t numNodes = static_cast<uint32_t>(graph.getNumNodes());
+	GeoPoint targetAt(targetCoord);
+	auto potential = [&](uint32_t id) { return id < numNodes ? distanceEarthMiles(graph.getPoint(id), targetAt) : 0; };
+	return aStar(graph, seeds, target, targetSteps, path, potential);
+}
+
+bool RouteSearch::shortestPathLandmarks(const RoadGraph &graph, const LandmarkTable &landmarks, const vector<SearchSeed> &seeds,
+	uint32_t target, const GeoCoord &targetCoord, const vector<TargetStep> &targetSteps, vector<RouteStep> &path)
+{
+	uint32_t numNodes = static_cast<uint32_t>(graph.getNumNodes());
+	GeoPoint targetAt(targetCoord);
+	// the ways the route can end: at target itself, or by one of the last steps into a snapped end.
+	// a landmark's bound is the least of what it proves about each
+	vector<TargetStep> ends(targetSteps);
+	if (target < numNodes)
+		ends.assign(1, TargetStep{ target, 0 });
+	auto bound = [&](uint32_t id, size_t landmark)
+	{
+		double least = HUGE_VAL;
+		for (const TargetStep &end : ends)
+			least = min(least, landmarks.lowerBound(id, end.node, landmark) + end.distance);
+		return least;
+	};
+
+	// the straight line is still a bound, and the better one wherever the landmarks are all off to the side
+	auto potential = [&](uint32_t id)
+	{
+		if (id >= numNodes)
+			return 0.0;
+		double h = distanceEarthMiles(graph.getPoint(id), targetAt);
+		for (size_t i = 0; i < landmarks.size(); i++)
+			h = max(h, bound(id, i));
+		return h;
+	};
+	return aStar(graph, seeds, target, targetSteps, path, potential);
+}
+
+template<typename Potential>
+bool RouteSearch::aStar(const RoadGraph &graph, const vector<SearchSeed> &seeds, uint32_t target,
+	const vector<TargetStep> &targetSteps, vector<RouteStep> &path, Potential potential)
+{
+	uint32_t numNodes = static_cast<uint32_t>(graph.getNumNodes());
+	m_forward.start(numNodes + 2);
+	m_forward.settle(sourcePoint(graph));
+	m_settled = 0;
+	for (const SearchSeed &seed : seeds)
+		m_forward.relax(seed.node, seed.distance, seed.parent, seed.segment, potential);
+
+	// a key of HUGE_VAL means the heuristic knows target can't be reached from there, and then
+	// it can't be from anywhere else left either
+	while (!m_forward.empty() && m_forward.minKey() != HUGE_VAL)
+	{
+		uint32_t current = m_forward.popMin();
+		m_settled++;
+		if (current == target)
+		{
+			path.clear();
+			for (uint32_t id = target; id != RoadGraph::NO_NODE; id = m_forward.parent(id))
+				path.push_back(RouteStep{ id, m_forward.segment(id) });
+			reverse(path.begin(), path.end());
+			return true;
+		}
+		double g = m_forward.g(current);
+		for (const TargetStep &step : targetSteps)
+			if (step.node == current)
+				m_forward.relax(target, g + step.distance, current, step.segment, potential);
+		for (const RoadEdge *edge = graph.edgesBegin(current), *end = graph.edgesEnd(current); edge != end; edge++)
+		{
+			// attractions are only ever headed for if they're the destination
+			if (edge->toAttraction() && edge->target != target)
+				continue;
+			m_forward.relax(edge->target, g + edge->length, current, static_cast<uint32_t>(edge->segmentNumber()), potential);
+		}
+	}
+	return false;
+}
+
+bool RouteSearch::shortestPathBidirectional(const RoadGraph &graph, const vector<SearchSeed> &seeds, uint32_t target,
+	const GeoCoord &sourceCoord, const GeoCoord &targetCoord, const vector<TargetStep> &targetSteps, vector<RouteStep> &path)
+{
+	uint32_t numNodes = static_cast<uint32_t>(graph.getNumNodes());
+	uint32_t source = sourcePoint(graph);
+	GeoPoint sourceAt(sourceCoord), targetAt(targetCoord);
+	auto pointOf = [&](uint32_t id) -> const GeoPoint& { return id < numNodes ? graph.getPoint(id) : id == source ? sourceAt : targetAt; };
+	auto toTarget = [&](uint32_t id) { return distanceEarthMiles(pointOf(id), targetAt); };
+	auto toSource = [&](uint32_t id) { return distanceEarthMiles(sourceAt, pointOf(id)); };
+
+	double best = HUGE_VAL; // length of the shortest route through a node both searches have reached
+	uint32_t meeting = RoadGraph::NO_NODE;
+	auto forward = [&](uint32_t id, double g, uint32_t parent, uint32_t segment)
+	{
+		if (m_forward.relax(id, g, parent, segment, toTarget) && m_backward.touched(id) && g + m_backward.g(id) < best)
+		{
+			best = g + m_backward.g(id);
+			meeting = id;
+		}
+	};
+	// backward, a node's parent is the next one along toward target
+	auto backward = [&](uint32_t id, double g, uint32_t parent, uint32_t segment)
+	{
+		if (m_backward.relax(id, g, parent, segment, toSource) && m_forward.touched(id) && g + m_forward.g(id) < best)
+		{
+			best = g + m_forward.g(id);
+			meeting = id;
+		}
+	};
+
+	m_forward.start(numNodes + 2);
+	m_backward.start(numNodes + 2);
+	m_settled = 0;
+	// a snapped start goes in the open set like any node, with the seeds as its edges, so the
+	// backward search can still meet the forward one there. same for a snapped end
+	bool fromSourcePoint = false;
+	for (const SearchSeed &seed : seeds)
+	{
+		if (seed.parent == source)
+			fromSourcePoint = true;
+		else
+			forward(seed.node, seed.distance, seed.parent, seed.segment);
+	}
+	if (fromSourcePoint)
+		forward(source, 0, RoadGraph::NO_NODE, RouteStep::NO_SEGMENT);
+	backward(target, 0, RoadGraph::NO_NODE, RouteStep::NO_SEGMENT);
+
+	// once either search has taken a node off its open set, neither one looks at it again. a node
+	// is taken off without being expanded if no route through it could beat the best one found:
+	// when its own key is already that long, or when getting to it plus the least the other search
+	// still has to cover (its smallest key, less the part of it that's this node's heuristic) is.
+	// the search is over when either side has nothing left that could be expanded
+	while (!m_forward.empty() && !m_backward.empty())
+	{
+		bool goForward = m_forward.size() <= m_backward.size(); // grow whichever side is smaller
+		Frontier &side = goForward ? m_forward : m_backward;
+		Frontier &other = goForward ? m_backward : m_forward;
+		double key = side.minKey();
+		uint32_t current = side.popMin();
+		other.close(current);
+		double g = side.g(current);
+		double otherHeuristic = goForward ? toSource(current) : toTarget(current);
+		if (key >= best || (!other.empty() && g + other.minKey() - otherHeuristic >= best))
+			continue;
+		m_settled++;
+		if (goForward)
+		{
+			if (current == source)
+			{
+				for (const SearchSeed &seed : seeds)
+					if (seed.parent == source)
+						forward(seed.node, seed.distance, source, seed.segment);
+				continue;
+			}
+			if (current >= numNodes) // targetPoint has nowhere further to go
+				continue;
+			for (const TargetStep &step : targetSteps)
+				if (step.node == current)
+					forward(target, g + step.distance, current, step.segment);
+			for (const RoadEdge *edge = graph.edgesBegin(current), *end = graph.edgesEnd(current); edge != end; edge++)
+				if (!edge->toAttraction() || edge->target == target)
+					forward(edge->target, g + edge->length, current, static_cast<uint32_t>(edge->segmentNumber()));
+		}
+		else
+		{
+			if (current == target && target >= numNodes)
+			{
+				for (const TargetStep &step : targetSteps)
+					backward(step.node, step.distance, target, step.segment);
+				continue;
+			}
+			if (current >= numNodes) // sourcePoint has nowhere further back to go
+				continue;
+			// the seeds off a snapped start are edges from it, so backward they lead to it
+			for (const SearchSeed &seed : seeds)
+				if (seed.node == current && seed.parent == source)
+					backward(source, g + seed.distance, current, seed.segment);
+			// an edge is walked backward by taking the one going the other way. target can be
+			// reached by an attraction edge, but no other node can
+			for (const RoadEdge *edge = graph.edgesBegin(current), *end = graph.edgesEnd(current); edge != end; edge++)
+				if (!edge->fromAttraction() || current == target)
+					backward(edge->target, g + edge->length, current, static_cast<uint32_t>(edge->segmentNumber()));
+		}
+	}
+	if (meeting == RoadGraph::NO_NODE)
+		return false;
+
+	// backward, the segment an entry has is the one the step on from it toward target takes
+	path.clear();
+	for (uint32_t id = meeting; id != RoadGraph::NO_NODE; id = m_forward.parent(id))
+		path.push_back(RouteStep{ id, m_forward.segment(id) });
+	reverse(path.begin(), path.end());
+	for (uint32_t id = meeting; m_backward.parent(id) != RoadGraph::NO_NODE; id = m_backward.parent(id))
+		path.push_back(RouteStep{ m_backward.parent(id), m_backward.segment(id) });
+	return true;
+}
+
+bool RouteSearch::shortestPathContracted(const RoadGraph &graph, const ContractionHierarchy &hierarchy, const vector<SearchSeed> &seeds,
+	uint32_t target, const vector<TargetStep> &targetSteps, vector<RouteStep> &path)
+{
+	uint32_t numNodes = static_cast<uint32_t>(graph.getNumNodes());
+	uint32_t source = sourcePoint(graph);
+	auto noPotential = [](uint32_t) { return 0.0; }; // plain Dijkstra both ways, the hierarchy keeps the searches small
+
+	double best = HUGE_VAL;
+	uint32_t meeting = RoadGraph::NO_NODE;
+	auto forward = [&](uint32_t id, double g, uint32_t parent, uint32_t segment)
+	{
+		if (m_forward.relax(id, g, parent, segment, noPotential) && m_backward.touched(id) && g + m_backward.g(id) < best)
+		{
+			best = g + m_backward.g(id);
+			meeting = id;
+		}
+	};
+	// backward, a node's parent is the next one along toward target
+	auto backward = [&](uint32_t id, double g, uint32_t parent, uint32_t segment)
+	{
+		if (m_backward.relax(id, g, parent, segment, noPotential) && m_forward.touched(id) && g + m_forward.g(id) < best)
+		{
+			best = g + m_forward.g(id);
+			meeting = id;
+		}
+	};
+
+	m_forward.start(numNodes + 2);
+	m_backward.start(numNodes + 2);
+	m_settled = 0;
+	m_forward.settle(source);
+	if (target >= numNodes)
+	{
+		m_backward.settle(target);
+		for (const TargetStep &step : targetSteps)
+			backward(step.node, step.distance, target, step.segment);
+	}
+	else
+	{
+		backward(target, 0, RoadGraph::NO_NODE, RouteStep::NO_SEGMENT);
+		// attraction edges aren't in the hierarchy. the ones into target are its last step, so they
+		// start the backward search along with target itself
+		for (const RoadEdge *edge = graph.edgesBegin(target), *end = graph.edgesEnd(target); edge != end; edge++)
+			if (edge->fromAttraction())
+				backward(edge->target, edge->length, target, static_cast<uint32_t>(edge->segmentNumber()));
+	}
+	for (const SearchSeed &seed : seeds)
+		forward(seed.node, seed.distance, seed.parent, seed.segment);
+
+	// each side only climbs, and keeps going until its smallest key couldn't improve on best
+	for (;;)
+	{
+		bool forwardLeft = !m_forward.empty() && m_forward.minKey() < best;
+		bool backwardLeft = !m_backward.empty() && m_backward.minKey() < best;
+		if (!forwardLeft && !backwardLeft)
+			break;
+		bool goForward = forwardLeft && (!backwardLeft || m_forward.minKey() <= m_backward.minKey());
+		Frontier &side = goForward ? m_forward : m_backward;
+		uint32_t current = side.popMin();
+		m_settled++;
+		if (current >= numNodes) // sourcePoint and targetPoint have no edges in the hierarchy
+			continue;
+		double g = side.g(current);
+		if (goForward)
+		{
+			for (const HierarchyEdge* edge = hierarchy.upBegin(current); edge != hierarchy.upEnd(current); edge++)
+				forward(edge->other, g + edge->length, current, RouteStep::NO_SEGMENT);
+		}
+		else
+		{
+			for (const HierarchyEdge* edge = hierarchy.downBegin(current); edge != hierarchy.downEnd(current); edge++)
+				backward(edge->other, g + edge->length, current, RouteStep::NO_SEGMENT);
+		}
+	}
+	if (meeting == RoadGraph::NO_NODE)
+		return false;
+
+	// a link between two ids is a hierarchy edge if there's one that accounts exactly for the g it
+	// added, and then each street edge it stands for is named by the graph edge the hierarchy was
+	// built from (open() checked that it was built from this graph, so there is one). the only
+	// other links are the seeds and the last steps, which already know their segment
+	auto street = [&](uint32_t from, uint32_t to) { path.push_back(RouteStep{ to, static_cast<uint32_t>(graph.findEdge(from, to)->segmentNumber()) }); };
+	auto unpackLink = [&](uint32_t from, uint32_t to, double nearerG, double furtherG, uint32_t segment)
+	{
+		const HierarchyEdge* edge = from < numNodes && to < numNodes ? hierarchy.findEdge(from, to) : nullptr;
+		if (edge != nullptr && nearerG + edge->length == furtherG)
+			hierarchy.unpack(from, to, *edge, street);
+		else
+			path.push_back(RouteStep{ to, segment });
+	};
+	vector<uint32_t> chain; // the forward half, from the meeting back to the start
+	for (uint32_t id = meeting; id != RoadGraph::NO_NODE; id = m_forward.parent(id))
+		chain.push_back(id);
+	path.clear();
+	path.push_back(RouteStep{ chain.back(), RouteStep::NO_SEGMENT });
+	for (size_t i = chain.size() - 1; i > 0; i--)
+		unpackLink(chain[i], chain[i - 1], m_forward.g(chain[i]), m_forward.g(chain[i - 1]), m_forward.segment(chain[i - 1]));
+	for (uint32_t id = meeting; m_backward.parent(id) != RoadGraph::NO_NODE; id = m_backward.parent(id))
+		unpackLink(id, m_backward.parent(id), m_backward.g(m_backward.parent(id)), m_backward.g(id), m_backward.segment(id));
+	return true;
+}
+
+void RouteSearch::distanceMatrix(const RoadGraph &graph, const vector<uint32_t> &sources, const vector<uint32_t> &targets,
+	vector<double> &distances)
+{
+	uint32_t numNodes = static_cast<uint32_t>(graph.getNumNodes());
+	auto noPotential = [](uint32_t) { return 0.0; };
+	distances.assign(sources.size() * targets.size(), HUGE_VAL);
+	m_settled = 0;
+	if (targets.empty())
+		return;
+	vector<pair<uint32_t, size_t>> byNode; // each target's node and where it is in targets, in node order
+	for (size_t j = 0; j < targets.size(); j++)
+		byNode.push_back(make_pair(targets[j], j));
+	sort(byNode.begin(), byNode.end());
+
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		double* row = distances.data() + i * targets.size();
+		double farthest = HUGE_VAL; // the most any target in row is away so far
+		auto reach = [&](uint32_t node, double d)
+		{
+			bool closer = false;
+			for (auto it = lower_bound(byNode.begin(), byNode.end(), make_pair(node, size_t(0))); it != byNode.end() && it->first == node; it++)
+			{
+				if (d < row[it->second])
+				{
+					row[it->second] = d;
+					closer = true;
+				}
+			}
+			// distances only ever go down, so farthest only needs working out again when one does
+			if (closer)
+				farthest = *max_element(row, row + targets.size());
+		};
+
+		m_forward.start(numNodes + 2);
+		m_forward.relax(sources[i], 0, RoadGraph::NO_NODE, RouteStep::NO_SEGMENT, noPotential);
+		// nothing expanded from here on is any closer than the smallest key, so once that's as far
+		// as the farthest target, none of them can get closer
+		while (!m_forward.empty() && m_forward.minKey() < farthest)
+		{
+			uint32_t current = m_forward.popMin();
+			m_settled++;
+			double g = m_forward.g(current);
+			reach(current, g);
+			for (const RoadEdge *edge = graph.edgesBegin(current), *end = graph.edgesEnd(current); edge != end; edge++)
+			{
+				// an attraction edge can only be the last step of a route, so it never goes in the open set
+				if (edge->toAttraction())
+					reach(edge->target, g + edge->length);
+				else
+					m_forward.relax(edge->target, g + edge->length, current, static_cast<uint32_t>(edge->segmentNumber()), noPotential);
+			}
+		}
+	}
+}
+
+void RouteSearch::distanceMatrixContracted(const RoadGraph &graph, const ContractionHierarchy &hierarchy, const vector<uint32_t> &sources,
+	const vector<uint32_t> &targets, vector<double> &distances)
+{
+	uint32_t numNodes = static_cast<uint32_t>(graph.getNumNodes());
+	auto noPotential = [](uint32_t) { return 0.0; };
+	distances.assign(sources.size() * targets.size(), HUGE_VAL);
+	m_settled = 0;
+
+	// an entry in a node's bucket: a target that searched up to it, and how far from it the target is
+	struct BucketEntry
+	{
+		uint32_t node;
+		uint32_t target;
+		double distance;
+		bool operator<(const BucketEntry &other) const { return node < other.node; }
+	};
+	vector<BucketEntry> buckets; // all of them, sorted by node once they're filled
+	for (size_t j = 0; j < targets.size(); j++)
+	{
+		uint32_t target = targets[j];
+		m_backward.start(numNodes + 2);
+		m_backward.relax(target, 0, RoadGraph::NO_NODE, RouteStep::NO_SEGMENT, noPotential);
+		// the attraction edges into target aren't in the hierarchy, so they start the search too
+		for (const RoadEdge *edge = graph.edgesBegin(target), *end = graph.edgesEnd(target); edge != end; edge++)
+			if (edge->fromAttraction())
+				m_backward.relax(edge->target, edge->length, target, static_cast<uint32_t>(edge->segmentNumber()), noPotential);
+		// searches up the hierarchy are small, so they're run to the end
+		while (!m_backward.empty())
+		{
+			uint32_t current = m_backward.popMin();
+			m_settled++;
+			double g = m_backward.g(current);
+			BucketEntry entry = { current, static_cast<uint32_t>(j), g };
+			buckets.push_back(entry);
+			for (const HierarchyEdge* edge = hierarchy.downBegin(current); edge != hierarchy.downEnd(current); edge++)
+				m_backward.relax(edge->other, g + edge->length, current, RouteStep::NO_SEGMENT, noPotential);
+		}
+	}
+	stable_sort(buckets.begin(), buckets.end());
+
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		double* row = distances.data() + i * targets.size();
+		m_forward.start(numNodes + 2);
+		m_forward.relax(sources[i], 0, RoadGraph::NO_NODE, RouteStep::NO_SEGMENT, noPotential);
+		while (!m_forward.empty())
+		{
+			uint32_t current = m_forward.popMin();
+			m_settled++;
+			double g = m_forward.g(current);
+			BucketEntry key = { current, 0, 0 };
+			for (auto it = lower_bound(buckets.begin(), buckets.end(), key); it != buckets.end() && it->node == current; it++)
+				row[it->target] = min(row[it->target], g + it->distance);
+			for (const HierarchyEdge* edge = hierarchy.upBegin(current); edge != hierarchy.upEnd(current); edge++)
+				m_forward.relax(edge->other, g + edge->length, current, RouteStep::NO_SEGMENT, noPotential);
+		}
+	}
+}
+
+void RouteSearch::startNearest(const RoadGraph &graph, const vector<SearchSeed> &seeds)
+{
+	auto noPotential = [](uint32_t) { return 0.0; };
+	m_forward.start(graph.getNumNodes() + 2);
+	m_settled = 0;
+	for (const SearchSeed &seed : seeds)
+	{
+		if (!m_forward.relax(seed.node, seed.distance, seed.parent, seed.segment, noPotential) && seed.parent != INTO_ATTRACTION &&
+			seed.distance == m_forward.g(seed.node) && m_forward.parent(seed.node) == INTO_ATTRACTION)
+			m_forward.reparent(seed.node, seed.parent, seed.segment);
+	}
+}
+
+bool RouteSearch::nextNearest(const RoadGraph &graph, uint32_t &node, double &distance)
+{
+	if (m_forward.empty())
+		return false;
+	auto noPotential = [](uint32_t) { return 0.0; };
+	node = m_forward.popMin();
+	distance = m_forward.g(node);
+	m_settled++;
+	if (m_forward.parent(node) == INTO_ATTRACTION)
+		return true;
+	for (const RoadEdge *edge = graph.edgesBegin(node), *end = graph.edgesEnd(node); edge != end; edge++)
+	{
+		uint32_t parent = edge->toAttraction() ? INTO_ATTRACTION : node;
+		uint32_t segment = static_cast<uint32_t>(edge->segmentNumber());
+		double g = distance + edge->length;
+		// a street that ties an attraction edge wins, so the node can be left again once it's settled
+		if (!m_forward.relax(edge->target, g, parent, segment, noPotential) && parent != INTO_ATTRACTION &&
+			!m_forward.settled(edge->target) && g == m_forward.g(edge->target) && m_forward.parent(edge->target) == INTO_ATTRACTION)
+			m_forward.reparent(edge->target, parent, segment);
+	}
+	return true;
+}
+
+void RouteSearch::Frontier::start(size_t numIds)
+{
+	if (m_states.size() < numIds)
+	{
+		NodeState untouched = { 0, 0, RoadGraph::NO_NODE, RouteStep::NO_SEGMENT, CLOSED, 0 };
+		m_states.resize(numIds, untouched);
+	}
+	if (++m_search == 0) // wrapped around, so old entries could pass for this search's. really clear them this once
+	{
+		for (NodeState &state : m_states)
+			state.search = 0;
+		m_search = 1;
+	}
+	m_heap.clear();
+}
+
+void RouteSearch::Frontier::settle(uint32_t id)
+{
+	NodeState &state = m_states[id];
+	state.g = 0;
+	state.h = 0;
+	state.parent = RoadGraph::NO_NODE;
+	state.segment = RouteStep::NO_SEGMENT;
+	state.heapPosition = CLOSED;
+	state.search = m_search;
+}
+
+void RouteSearch::Frontier::close(uint32_t id)
+{
+	NodeState &state = m_states[id];
+	if (!touched(id))
+	{
+		state.g = HUGE_VAL;
+		state.parent = RoadGraph::NO_NODE;
+		state.segment = RouteStep::NO_SEGMENT;
+		state.search = m_search;
+	}
+	else if (state.heapPosition != CLOSED)
+	{
+		// fill the hole with the last entry, which may belong above or below it
+		size_t position = state.heapPosition;
+		HeapEntry last = m_heap.back();
+		m_heap.pop_back();
+		if (position < m_heap.size())
+		{
+			place(position, last);
+			siftUp(position);
+			siftDown(m_states[last.id].heapPosition);
+		}
+	}
+	state.heapPosition = CLOSED;
+}
+
+void RouteSearch::Frontier::siftUp(size_t position)
+{
+	HeapEntry moving = m_heap[position];
+	while (position > 0)
+	{
+		size_t parent = (position - 1) / ARITY;
+		if (!(moving.f < m_heap[parent].f))
+			break;
+		place(position, m_heap[parent]);
+		position = parent;
+	}
+	place(position, moving);
+}
+
+void RouteSearch::Frontier::siftDown(size_t position)
+{
+	HeapEntry moving = m_heap[position];
+	for (;;)
+	{
+		size_t first = position * ARITY + 1;
+		if (first >= m_heap.size())
+			break;
+		size_t last = min(first + ARITY, m_heap.size());
+		size_t smallest = first;
+		for (size_t child = first + 1; child < last; child++)
+			if (m_heap[child].f < m_heap[smallest].f)
+				smallest = child;
+		if (!(m_heap[smallest].f < moving.f))
+			break;
+		place(position, m_heap[smallest]);
+		position = smallest;
+	}
+	place(position, moving);
+}
+
+uint32_t RouteSearch::Frontier::popMin()
+{
+	uint32_t id = m_heap.front().id;
+	m_states[id].heapPosition = CLOSED;
+	HeapEntry last = m_heap.back();
+	m_heap.pop_back();
+	if (!m_heap.empty())
+	{
+		place(0, last);
+		siftDown(0);
+	}
+	return id;
+}
@@ -0,0 +1,212 @@
+#ifndef ROUTE_SEARCH_H
+#define ROUTE_SEARCH_H
+
+#include "provided.h"
+#include "RoadGraph.h"
+#include "ContractionHierarchy.h"
+#include "LandmarkTable.h"
+#include <vector>
+#include <cstdint>
+
+// one id along a route the searches found, and the loader's number for the segment the step into
+// it ran along (NO_SEGMENT for the first, which nothing steps into)
+struct RouteStep
+{
+	static const uint32_t NO_SEGMENT = static_cast<uint32_t>(-1);
+
+	uint32_t node;
+	uint32_t segment;
+};
+
+// where a search starts from: a node to put in the open set, how far along the route it already is,
+// the id to record as the one before it (RoadGraph::NO_NODE if it's the start itself), and the
+// segment the way from there runs along (RouteStep::NO_SEGMENT if there isn't one)
+struct SearchSeed
+{
+	uint32_t node;
+	double distance;
+	uint32_t parent;
+	uint32_t segment;
+};
+
+// a last step into a target that isn't one of the graph's nodes: from node, this far, along segment
+struct TargetStep
+{
+	uint32_t node;
+	double distance;
+	uint32_t segment;
+};
+
+// A* over a RoadGraph with all of its state in arrays indexed by node number. Each node has one
+// entry holding its g score, its parent, the segment it was reached along and where it is in the
+// open set, so there are no maps to search and no coordinates to copy, and the open set is a heap
+// of node numbers that lowers a node's key where it sits instead of taking a second copy of it. A
+// node is in the open set at most once.
+//
+// Route ends partway along a segment get the two ids past the graph's own nodes: sourcePoint for
+// the start, targetPoint for the end. Seeds can hang off sourcePoint, and targetSteps say which
+// nodes can step into targetPoint.
+//
+// One RouteSearch is meant to be kept and reused, one per thread. Every entry remembers which
+// search last wrote it, and anything older counts as untouched, so starting a search doesn't
+// have to clear arrays the size of the map.
+class RouteSearch
+{
+public:
+	RouteSearch() : m_settled(0) {}
+
+	static uint32_t sourcePoint(const RoadGraph &graph) { return static_cast<uint32_t>(graph.getNumNodes()); }
+	static uint32_t targetPoint(const RoadGraph &graph) { return static_cast<uint32_t>(graph.getNumNodes()) + 1; }
+
+	// the shortest route from the seeds to target, which is a node or targetPoint. targetCoord is
+	// where target is, for the heuristic. attraction edges are only followed into target, the way
+	// navigate has always worked. fills path with the ids along the route from the start, seed's
+	// parent first, each with the segment of the edge the search took into it, and returns false
+	// if target can't be reached
+	bool shortestPath(const RoadGraph &graph, const std::vector<SearchSeed> &seeds, uint32_t target, const GeoCoord &targetCoord,
+		const std::vector<TargetStep> &targetSteps, std::vector<RouteStep> &path);
+	// the same search, with each node's heuristic the best of the straight line and what the
+	// landmarks' tables prove about its distance to target. a better guess means fewer nodes
+	// expanded, and the route can differ from shortestPath's only where two are exactly as long
+	bool shortestPathLandmarks(const RoadGraph &graph, const LandmarkTable &landmarks, const std::vector<SearchSeed> &seeds,
+		uint32_t target, const GeoCoord &targetCoord, const std::vector<TargetStep> &targetSteps, std::vector<RouteStep> &path);
+	// the same route, found by searching forward from the start and backward from target at once.
+	// sourceCoord is where the start is. each direction is steered by the straight line distance
+	// to the end it's heading for, and the first meeting isn't necessarily the shortest route, so
+	// the two go on until neither has a node left that could lead to a shorter one (Pijls and
+	// Post's NBA*). the route can differ from shortestPath's only where two are exactly as long
+	bool shortestPathBidirectional(const RoadGraph &graph, const std::vector<SearchSeed> &seeds, uint32_t target,
+		const GeoCoord &sourceCoord, const GeoCoord &targetCoord, const std::vector<TargetStep> &targetSteps, std::vector<RouteStep> &path);
+	// the same route again, from a contraction hierarchy built from graph: a search up the
+	// hierarchy from each end, stopping once neither side's smallest key could improve on the best
+	// meeting, and then every shortcut along the way unpacked back into the graph's own nodes
+	bool shortestPathContracted(const RoadGraph &graph, const ContractionHierarchy &hierarchy, const std::vector<SearchSeed> &seeds,
+		uint32_t target, const std::vector<TargetStep> &targetSteps, std::vector<RouteStep> &path);
+	// the distances from every one of sources to every one of targets (all nodes), the way
+	// shortestPath would find them, with distances[i * targets.size() + j] from sources[i] to
+	// targets[j] and HUGE_VAL where there's no route. one Dijkstra search per source finds the
+	// distances to all the targets at once, stopping as soon as none of them could get any closer
+	void distanceMatrix(const RoadGraph &graph, const std::vector<uint32_t> &sources, const std::vector<uint32_t> &targets,
+		std::vector<double> &distances);
+	// the same distances from a contraction hierarchy built from graph. each target's search up the
+	// hierarchy is done once, and leaves its distance to every node it reaches in that node's
+	// bucket. then a search up from each source only has to look in the buckets of the nodes it
+	// reaches, since every route goes up and back down through one of them
+	void distanceMatrixContracted(const RoadGraph &graph, const ContractionHierarchy &hierarchy, const std::vector<uint32_t> &sources,
+		const std::vector<uint32_t> &targets, std::vector<double> &distances);
+	// Dijkstra out from the seeds, handing back one node at a time, closest first, so a caller after
+	// the nearest few of something can stop as soon as it has them. attractions are driven into but
+	// never through, the way navigate's routes are: a node reached by an attraction edge, or from a
+	// seed whose parent is INTO_ATTRACTION, isn't left again unless a street gets there just as soon
+	void startNearest(const RoadGraph &graph, const std::vector<SearchSeed> &seeds);
+	// the next closest node and how far it is. false once everything reachable has been handed back
+	bool nextNearest(const RoadGraph &graph, uint32_t &node, double &distance);
+	static const uint32_t INTO_ATTRACTION = RoadGraph::NO_NODE - 1;
+
+	// how many nodes the last search expanded
+	size_t nodesSettled() const { return m_settled; }
+
+	RouteSearch(const RouteSearch&) = delete;
+	RouteSearch& operator=(const RouteSearch&) = delete;
+private:
+	// the open set and per-node entries for one direction of search
+	class Frontier
+	{
+	public:
+		Frontier() : m_search(0) {}
+		// forgets the last search. ids run up to numIds
+		void start(size_t numIds);
+		bool touched(uint32_t id) const { return m_states[id].search == m_search; }
+		bool settled(uint32_t id) const { return touched(id) && m_states[id].heapPosition == CLOSED; }
+		double g(uint32_t id) const { return m_states[id].g; }
+		uint32_t parent(uint32_t id) const { return m_states[id].parent; }
+		uint32_t segment(uint32_t id) const { return m_states[id].segment; }
+		// makes id where this direction begins: settled, g of 0, nothing before it
+		void settle(uint32_t id);
+		// takes id out of the open set, or keeps it from ever going in, without it having a route
+		void close(uint32_t id);
+		// for a route to id that's exactly as long as the one it has, but that the search would rather keep
+		void reparent(uint32_t id, uint32_t parent, uint32_t segment)
+		{
+			m_states[id].parent = parent;
+			m_states[id].segment = segment;
+		}
+
+		// offers a route to id that's g long and comes from parent along segment. only kept if it's
+		// the shortest yet, and returns whether it was. potential(id) is the node's heuristic, only
+		// asked for the first time the node is reached
+		template<typename Potential>
+		bool relax(uint32_t id, double g, uint32_t parent, uint32_t segment, Potential potential)
+		{
+			NodeState &state = m_states[id];
+			if (!touched(id))
+			{
+				state.g = g;
+				state.h = potential(id);
+				state.parent = parent;
+				state.segment = segment;
+				state.search = m_search;
+				m_heap.push_back(HeapEntry());
+				HeapEntry entry = { g + state.h, id };
+				place(m_heap.size() - 1, entry);
+				siftUp(m_heap.size() - 1);
+				return true;
+			}
+			if (state.heapPosition == CLOSED || !(g < state.g)) // settled nodes already have their shortest route
+				return false;
+			state.g = g;
+			state.parent = parent;
+			state.segment = segment;
+			m_heap[state.heapPosition].f = g + state.h;
+			siftUp(state.heapPosition);
+			return true;
+		}
+		bool empty() const { return m_heap.empty(); }
+		size_t size() const { return m_heap.size(); }
+		double minKey() const { return m_heap.front().f; }
+		uint32_t popMin();
+
+		Frontier(const Frontier&) = delete;
+		Frontier& operator=(const Frontier&) = delete;
+	private:
+		static const uint32_t CLOSED = static_cast<uint32_t>(-1); // heapPosition of a settled node
+
+		struct NodeState {
+			double g;				// distance from where this direction began
+			double h;				// the heuristic
+			uint32_t parent;		// id of the node the route got here from
+			uint32_t segment;		// the segment the step from parent ran along
+			uint32_t heapPosition;	// index in m_heap, or CLOSED
+			uint32_t search;		// the search that wrote this entry. if it isn't m_search, the node is untouched
+		};
+		struct HeapEntry {
+			double f; // g + h, kept here so sifting only reads the heap
+			uint32_t id;
+		};
+		// a 4-ary heap: half as deep as a binary one, and a node's children are next to each other
+		static const size_t ARITY = 4;
+
+		std::vector<NodeState> m_states; // one per node, plus sourcePoint and targetPoint
+		std::vector<HeapEntry> m_heap;
+		uint32_t m_search;
+
+		void siftUp(size_t position);
+		void siftDown(size_t position);
+		void place(size_t position, const HeapEntry &entry)
+		{
+			m_heap[position] = entry;
+			m_states[entry.id].heapPosition = static_cast<uint32_t>(position);
+		}
+	};
+
+	// what shortestPath and shortestPathLandmarks share. potential(id) is the heuristic
+	template<typename Potential>
+	bool aStar(const RoadGraph &graph, const std::vector<SearchSeed> &seeds, uint32_t target,
+		const std::vector<TargetStep> &targetSteps, std::vector<RouteStep> &path, Potential potential);
+
+	Frontier m_forward;
+	Frontier m_backward; // only used by the searches from both ends, and for the buckets
+	size_t m_settled;
+};
+
+#endif // for ROUTE_SEARCH_H
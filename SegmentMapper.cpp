@@ -1,7 +1,11 @@
 #include "provided.h"
 #include "MyMap.h"
+#include "MyHashMap.h"
 #include "support.h"
+#include "MapSnapshot.h"
 #include <vector>
+#include <algorithm>
+#include <memory>
 using namespace std;
 
 class SegmentMapperImpl
@@ -10,13 +14,40 @@ public:
 	SegmentMapperImpl();
 	~SegmentMapperImpl();
 	void init(const MapLoader& ml);
+	void initFrom(const SegmentMapperImpl& other, const MapLoader& ml);
 	vector<StreetSegment> getSegments(const GeoCoord& gc) const;
+	vector<size_t> getSegmentNumbers(const GeoCoord& gc) const;
+	vector<size_t> getSegmentNumbers(const CoordKey& key) const;
+	void applyChanges(const vector<MapChange>& changes);
 private:
-	MyMap<GeoCoord, vector<StreetSegment>> segmentMap;
-	void addToMap(const GeoCoord &coord, const StreetSegment &seg);
+	// the index only ever answers "which segments touch exactly this coord", so it's a hash table.
+	// MyMap has the same interface and can be swapped in here
+	typedef MyHashMap<CoordKey, vector<size_t>> CoordIndex;
+	// maps coords to the numbers of the segments that touch them. the segments themselves
+	// stay in the loader, so building the index doesn't copy any of them. keyed by CoordKey
+	// so each entry holds 8 bytes of key instead of a GeoCoord's two strings and two doubles.
+	// built by init and never changed after, so mappers made with initFrom share it
+	shared_ptr<const CoordIndex> m_loadedMap;
+	const MapLoader* m_loader;
+	// when the loader came from a compiled snapshot, there's no m_loadedMap, the snapshot's own
+	// index is searched instead
+	const MapSnapshot* m_snapshot;
+	// coords that a patch has touched since, with all their segments. these entries take
+	// precedence over m_loadedMap or the snapshot's index
+	CoordIndex segmentMap;
+	static void addToMap(CoordIndex &index, const CoordKey &key, size_t segNum);
+	// the index entry for key, or nullptr if it has none. count is set for either kind of entry
+	const vector<size_t>* findEntry(const CoordKey &key, const uint32_t* &snapshotSegNums, size_t &count) const;
+
+	static const size_t NO_SEGMENT = static_cast<size_t>(-1);
+	// swaps one occurrence of oldSegNum in coord's list for newSegNum. NO_SEGMENT as the old
+	// number means add newSegNum, and NO_SEGMENT as the new number means remove oldSegNum
+	void relink(const CoordKey &key, size_t oldSegNum, size_t newSegNum);
+	void relinkSegment(const StreetSegment &seg, size_t oldSegNum, size_t newSegNum);
 };
 
 SegmentMapperImpl::SegmentMapperImpl()
+	: m_loader(nullptr), m_snapshot(nullptr)
 {
 }
 
@@ -26,54 +57,147 @@ SegmentMapperImpl::~SegmentMapperImpl()
 
 void SegmentMapperImpl::init(const MapLoader& ml)
 {
-	StreetSegment seg;
-	size_t numSegments = ml.getNumSegments();
-	for (size_t segNum = 0; segNum < numSegments; segNum++)
+	m_loader = &ml;
+	m_loadedMap.reset();
+	segmentMap.clear();
+	// a snapshot already has the coordinate index built, so just remember where it is. one that's
+	// been patched since has a different map, and gets indexed like any other
+	m_snapshot = MapSnapshot::unpatched(ml);
+	if (m_snapshot != nullptr)
+		return;
+
+	CoordIndex* loadedMap = new CoordIndex;
+	size_t segNum = 0;
+	for (const StreetSegment &seg : ml) // walks the loader's own segments, nothing is copied
 	{
-		if (ml.getSegment(segNum, seg))
-		{
-			addToMap(seg.segment.start, seg); // add starting coordinate
-			addToMap(seg.segment.end, seg); // add ending coordinate
+		addToMap(*loadedMap, CoordKey(seg.segment.start), segNum); // add starting coordinate
+		addToMap(*loadedMap, CoordKey(seg.segment.end), segNum); // add ending coordinate
 
-			if (seg.attractions.size() != 0) // there are attractions in street segment
-				for (size_t j = 0; j < seg.attractions.size(); j++)
-					addToMap(seg.attractions[j].geocoordinates, seg);
-		} // end if
+		if (seg.attractions.size() != 0) // there are attractions in street segment
+			for (size_t j = 0; j < seg.attractions.size(); j++)
+				addToMap(*loadedMap, CoordKey(seg.attractions[j].geocoordinates), segNum);
+		segNum++;
 	} // end for
+	m_loadedMap.reset(loadedMap);
 }
 
-void SegmentMapperImpl::addToMap(const GeoCoord &coord, const StreetSegment &seg)
+void SegmentMapperImpl::initFrom(const SegmentMapperImpl& other, const MapLoader& ml)
 {
-	vector<StreetSegment> *segmentPtr;
-	segmentPtr = segmentMap.find(coord);
-	if (segmentPtr == nullptr) // if none exists, make a new vector
-	{
-		vector<StreetSegment> segmentVector;
-		segmentVector.push_back(seg);
-		segmentMap.associate(coord, segmentVector); // associate coordinates and vector
-	}
-	else // coord found in map
-	{
-		segmentPtr->push_back(seg); // so just add street segment to coord's vector
-	}
+	m_loader = &ml;
+	m_loadedMap = other.m_loadedMap;
+	m_snapshot = other.m_snapshot;
+	segmentMap.copyFrom(other.segmentMap);
+}
+
+void SegmentMapperImpl::addToMap(CoordIndex &index, const CoordKey &key, size_t segNum)
+{
+	// one lookup that hands back coord's vector, starting an empty one if the coord is new
+	index.findOrInsert(key).push_back(segNum);
+}
+
+// a coord's segments are in segmentMap if a patch has touched it, and otherwise in whichever
+// index came with the loaded map. a snapshot's entries are a different type, so those come back
+// through snapshotSegNums instead
+const vector<size_t>* SegmentMapperImpl::findEntry(const CoordKey &key, const uint32_t* &snapshotSegNums, size_t &count) const
+{
+	snapshotSegNums = nullptr;
+	count = 0;
+	const vector<size_t> *segNums = segmentMap.size() != 0 ? segmentMap.find(key) : nullptr;
+	if (segNums == nullptr && m_loadedMap)
+		segNums = m_loadedMap->find(key);
+	if (segNums != nullptr)
+		count = segNums->size();
+	else if (m_snapshot != nullptr)
+		snapshotSegNums = m_snapshot->findSegments(key, count);
+	return segNums;
 }
 
 vector<StreetSegment> SegmentMapperImpl::getSegments(const GeoCoord& gc) const
 {
-	const vector<StreetSegment> *segVector;
 	vector<StreetSegment> segments;
-	segVector = segmentMap.find(gc);
-	if (segVector == nullptr)
-		return segments;
-	else
+	const uint32_t* snapshotSegNums;
+	size_t count;
+	const vector<size_t> *segNums = findEntry(CoordKey(gc), snapshotSegNums, count);
+	// callers get their own copies so they can't mess up the loader's segments
+	segments.reserve(count);
+	for (size_t i = 0; i < count; i++)
+		segments.push_back(*m_loader->getSegment(segNums != nullptr ? (*segNums)[i] : snapshotSegNums[i]));
+	return segments;
+}
+
+vector<size_t> SegmentMapperImpl::getSegmentNumbers(const GeoCoord& gc) const
+{
+	return getSegmentNumbers(CoordKey(gc));
+}
+
+vector<size_t> SegmentMapperImpl::getSegmentNumbers(const CoordKey& key) const
+{
+	const uint32_t* snapshotSegNums;
+	size_t count;
+	const vector<size_t> *segNums = findEntry(key, snapshotSegNums, count);
+	if (segNums != nullptr)
+		return *segNums;
+	return vector<size_t>(snapshotSegNums, snapshotSegNums + count);
+}
+
+// only the coords of the segments in the change list are visited, so the cost of a patch
+// depends on the size of the patch and not the size of the map
+void SegmentMapperImpl::applyChanges(const vector<MapChange>& changes)
+{
+	for (const MapChange &change : changes)
 	{
-		// not sure if i want to provide access to the insides of the map so i'm making
-		// and returning the "segments" vector so it won't mess up the map
-		segments = *segVector;
-		return segments;
+		switch (change.type)
+		{
+		case MapChange::SEGMENT_ADDED:
+			relinkSegment(change.segment, NO_SEGMENT, change.segNum);
+			break;
+		case MapChange::SEGMENT_REMOVED:
+			relinkSegment(change.segment, change.segNum, NO_SEGMENT);
+			break;
+		case MapChange::SEGMENT_MOVED:
+			relinkSegment(change.segment, change.fromSegNum, change.segNum);
+			break;
+		case MapChange::ATTRACTION_ADDED:
+			relink(CoordKey(change.attraction.geocoordinates), NO_SEGMENT, change.segNum);
+			break;
+		case MapChange::ATTRACTION_REMOVED:
+			relink(CoordKey(change.attraction.geocoordinates), change.segNum, NO_SEGMENT);
+			break;
+		}
 	}
 }
 
+// a segment is listed once under each of its endpoints and once under each attraction's coord
+void SegmentMapperImpl::relinkSegment(const StreetSegment &seg, size_t oldSegNum, size_t newSegNum)
+{
+	relink(CoordKey(seg.segment.start), oldSegNum, newSegNum);
+	relink(CoordKey(seg.segment.end), oldSegNum, newSegNum);
+	for (size_t j = 0; j < seg.attractions.size(); j++)
+		relink(CoordKey(seg.attractions[j].geocoordinates), oldSegNum, newSegNum);
+}
+
+void SegmentMapperImpl::relink(const CoordKey &key, size_t oldSegNum, size_t newSegNum)
+{
+	vector<size_t> *segNums = segmentMap.find(key);
+	if (segNums == nullptr) // first change to this coord, so start from what the loaded map has for it
+		segNums = segmentMap.emplace(key, getSegmentNumbers(key)).first;
+
+	if (oldSegNum != NO_SEGMENT)
+	{
+		vector<size_t>::iterator found = find(segNums->begin(), segNums->end(), oldSegNum);
+		if (found != segNums->end())
+		{
+			if (newSegNum == NO_SEGMENT)
+				segNums->erase(found);
+			else
+				*found = newSegNum;
+			return;
+		}
+	}
+	if (newSegNum != NO_SEGMENT)
+		segNums->push_back(newSegNum);
+}
+
 //******************** SegmentMapper functions ********************************
 
 // These functions simply delegate to SegmentMapperImpl's functions.
@@ -94,7 +218,22 @@ void SegmentMapper::init(const MapLoader& ml)
 	m_impl->init(ml);
 }
 
+void SegmentMapper::initFrom(const SegmentMapper& other, const MapLoader& ml)
+{
+	m_impl->initFrom(*other.m_impl, ml);
+}
+
 vector<StreetSegment> SegmentMapper::getSegments(const GeoCoord& gc) const
 {
 	return m_impl->getSegments(gc);
 }
+
+vector<size_t> SegmentMapper::getSegmentNumbers(const GeoCoord& gc) const
+{
+	return m_impl->getSegmentNumbers(gc);
+}
+
+void SegmentMapper::applyChanges(const vector<MapChange>& changes)
+{
+	m_impl->applyChanges(changes);
+}
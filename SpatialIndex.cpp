@@ -0,0 +1,776 @@
+#include "SpatialIndex.h"
+#include "support.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+using namespace std;
+
+namespace
+{
+	float roundDown(double value)
+	{
+		float rounded = static_cast<float>(value);
+		return rounded > value ? nextafterf(rounded, -HUGE_VALF) : rounded;
+	}
+
+	float roundUp(double value)
+	{
+		float rounded = static_cast<float>(value);
+		return rounded < value ? nextafterf(rounded, HUGE_VALF) : rounded;
+	}
+
+	// distance along a Hilbert curve filling a 65536 x 65536 grid to the cell at (x, y)
+	uint32_t hilbertIndex(uint32_t x, uint32_t y)
+	{
+		const uint32_t n = 1u << 16;
+		uint32_t d = 0;
+		for (uint32_t s = n / 2; s > 0; s /= 2)
+		{
+			uint32_t rx = (x & s) ? 1 : 0, ry = (y & s) ? 1 : 0;
+			d += s * s * ((3 * rx) ^ ry);
+			if (ry == 0) // rotate the quadrant so the curve inside it lines up with the next level
+			{
+				if (rx == 1)
+				{
+					x = n - 1 - x;
+					y = n - 1 - y;
+				}
+				swap(x, y);
+			}
+		}
+		return d;
+	}
+}
+
+//******************** PackedRTree functions **********************************
+
+void PackedRTree::build(const vector<Box> &boxes)
+{
+	vector<StoredBox> stored;
+	vector<uint32_t> items, levelStart;
+	if (boxes.empty())
+	{
+		m_boxes.clear();
+		m_items.clear();
+		m_levelStart.clear();
+		return;
+	}
+
+	Box all = boxes[0];
+	for (const Box &box : boxes)
+	{
+		all.minLatitude = min(all.minLatitude, box.minLatitude);
+		all.minLongitude = min(all.minLongitude, box.minLongitude);
+		all.maxLatitude = max(all.maxLatitude, box.maxLatitude);
+		all.maxLongitude = max(all.maxLongitude, box.maxLongitude);
+	}
+	// place every center on the curve's grid and sort by how far along the curve it is
+	double height = all.maxLatitude - all.minLatitude, width = all.maxLongitude - all.minLongitude;
+	double yScale = height > 0 ? 65535 / height : 0, xScale = width > 0 ? 65535 / width : 0;
+	vector<pair<uint32_t, uint32_t>> order; // curve distance, item
+	order.reserve(boxes.size());
+	for (uint32_t item = 0; item < boxes.size(); item++)
+	{
+		const Box &box = boxes[item];
+		double y = ((box.minLatitude + box.maxLatitude) / 2 - all.minLatitude) * yScale;
+		double x = ((box.minLongitude + box.maxLongitude) / 2 - all.minLongitude) * xScale;
+		order.push_back(make_pair(hilbertIndex(static_cast<uint32_t>(x), static_cast<uint32_t>(y)), item));
+	}
+	sort(order.begin(), order.end()); // ties go by item number, so the tree doesn't depend on the sort
+
+	items.reserve(order.size());
+	stored.reserve(order.size() + order.size() / (FANOUT - 1) + 1);
+	for (const pair<uint32_t, uint32_t> &entry : order)
+	{
+		const Box &box = boxes[entry.second];
+		StoredBox rounded = { roundDown(box.minLatitude), roundDown(box.minLongitude), roundUp(box.maxLatitude), roundUp(box.maxLongitude) };
+		items.push_back(entry.second);
+		stored.push_back(rounded);
+	}
+
+	// each level is one box per FANOUT boxes of the level below, until a level has just the root
+	levelStart.push_back(0);
+	uint32_t levelBegin = 0, levelEnd = static_cast<uint32_t>(stored.size());
+	do
+	{
+		for (uint32_t first = levelBegin; first < levelEnd; first += FANOUT)
+		{
+			StoredBox parent = stored[first];
+			for (uint32_t child = first + 1; child < min(first + FANOUT, levelEnd); child++)
+			{
+				parent.minLatitude = min(parent.minLatitude, stored[child].minLatitude);
+				parent.minLongitude = min(parent.minLongitude, stored[child].minLongitude);
+				parent.maxLatitude = max(parent.maxLatitude, stored[child].maxLatitude);
+				parent.maxLongitude = max(parent.maxLongitude, stored[child].maxLongitude);
+			}
+			stored.push_back(parent);
+		}
+		levelBegin = levelEnd;
+		levelEnd = static_cast<uint32_t>(stored.size());
+		levelStart.push_back(levelBegin);
+	} while (levelEnd - levelBegin > 1);
+	levelStart.push_back(levelEnd);
+
+	m_boxes.assign(move(stored));
+	m_items.assign(move(items));
+	m_levelStart.assign(move(levelStart));
+}
+
+void PackedRTree::open(const MapSnapshot &snapshot, snapshot::SectionId boxes, snapshot::SectionId items, snapshot::SectionId levelStart)
+{
+	size_t count;
+	const StoredBox* stored = snapshot.records<StoredBox>(boxes, count);
+	m_boxes.view(stored, count);
+	const uint32_t* positions = snapshot.records<uint32_t>(items, count);
+	m_items.view(positions, count);
+	const uint32_t* levels = snapshot.records<uint32_t>(levelStart, count);
+	m_levelStart.view(levels, count);
+}
+
+//******************** SpatialIndex functions *********************************
+
+SpatialIndex::SpatialIndex()
+{
+	shared_ptr<Built> built = make_shared<Built>();
+	built->minLatitude = built->minLongitude = 0;
+	built->cellHeight = built->cellWidth = 1;
+	built->rows = built->columns = 0;
+	m_built = built;
+}
+
+void SpatialIndex::build(const MapLoader &ml)
+{
+	shared_ptr<Built> built = make_shared<Built>();
+	built->minLatitude = built->minLongitude = 0;
+	built->cellHeight = built->cellWidth = 1;
+	built->rows = built->columns = 0;
+	m_built = built;
+	m_replacedSegments.clear();
+	m_mayBeReplaced.reset();
+	m_addedLines.clear();
+	m_addedLineOf.clear();
+	m_addedCellLines.clear();
+	m_cellMayHaveAdded.reset();
+	m_addedSegmentTree.build(vector<PackedRTree::Box>());
+	m_addedTreeLines.clear();
+	m_removedAttractions.clear();
+	m_addedAttractions.clear();
+	m_addedAttractionTree.build(vector<PackedRTree::Box>());
+
+	const MapSnapshot* snapshot = MapSnapshot::unpatched(ml);
+	if (snapshot != nullptr)
+	{
+		openSnapshot(*built, *snapshot);
+		return;
+	}
+
+	vector<PackedRTree::Box> boxes;
+	boxes.reserve(ml.getNumSegments());
+	for (const StreetSegment &seg : ml)
+	{
+		const GeoCoord &start = seg.segment.start, &end = seg.segment.end;
+		PackedRTree::Box box = { min(start.latitude, end.latitude), min(start.longitude, end.longitude),
+			max(start.latitude, end.latitude), max(start.longitude, end.longitude) };
+		boxes.push_back(box);
+	}
+	built->segmentTree.build(boxes);
+
+	vector<Line> lines(built->segmentTree.size());
+	for (uint32_t position = 0; position < lines.size(); position++)
+	{
+		uint32_t segNum = built->segmentTree.itemAt(position);
+		const GeoSegment &gs = ml.getSegment(segNum)->segment;
+		Line line = { gs.start.latitude, gs.start.longitude, gs.end.latitude, gs.end.longitude, segNum, 0 };
+		lines[position] = line;
+	}
+	built->lines.assign(move(lines));
+	buildGrid(*built);
+	buildAttractions(*built, ml);
+}
+
+// everything but the attractions is read where it is. those are Attraction objects, so they're
+// made from the snapshot's records, which only costs as much as the attractions
+void SpatialIndex::openSnapshot(Built &built, const MapSnapshot &snapshot)
+{
+	size_t count;
+	built.segmentTree.open(snapshot, snapshot::SEGMENT_TREE_BOXES, snapshot::SEGMENT_TREE_ITEMS, snapshot::SEGMENT_TREE_LEVELS);
+	const Line* lines = snapshot.records<Line>(snapshot::SPATIAL_LINES, count);
+	built.lines.view(lines, count);
+
+	const snapshot::GridRecord &grid = *snapshot.records<snapshot::GridRecord>(snapshot::SPATIAL_GRID, count);
+	built.minLatitude = grid.minLatitude;
+	built.minLongitude = grid.minLongitude;
+	built.cellHeight = grid.cellHeight;
+	built.cellWidth = grid.cellWidth;
+	built.rows = grid.rows;
+	built.columns = grid.columns;
+	const uint32_t* firstCellLine = snapshot.records<uint32_t>(snapshot::GRID_FIRST_CELL_LINE, count);
+	built.firstCellLine.view(firstCellLine, count);
+	const uint32_t* cellLines = snapshot.records<uint32_t>(snapshot::GRID_CELL_LINES, count);
+	built.cellLines.view(cellLines, count);
+
+	built.attractionTree.open(snapshot, snapshot::ATTRACTION_TREE_BOXES, snapshot::ATTRACTION_TREE_ITEMS, snapshot::ATTRACTION_TREE_LEVELS);
+	const uint32_t* attractions = snapshot.records<uint32_t>(snapshot::SPATIAL_ATTRACTIONS, count);
+	built.attractions.resize(count);
+	for (size_t position = 0; position < count; position++)
+		snapshot.getAttraction(attractions[position], built.attractions[position]);
+}
+
+void SpatialIndex::initFrom(const SpatialIndex &other)
+{
+	m_built = other.m_built;
+	m_replacedSegments.copyFrom(other.m_replacedSegments);
+	m_mayBeReplaced = other.m_mayBeReplaced;
+	m_addedLines = other.m_addedLines;
+	m_addedLineOf.copyFrom(other.m_addedLineOf);
+	m_addedCellLines.copyFrom(other.m_addedCellLines);
+	m_cellMayHaveAdded = other.m_cellMayHaveAdded;
+	m_addedSegmentTree.copyFrom(other.m_addedSegmentTree);
+	m_addedTreeLines = other.m_addedTreeLines;
+	m_removedAttractions.copyFrom(other.m_removedAttractions);
+	m_addedAttractions = other.m_addedAttractions;
+	m_addedAttractionTree.copyFrom(other.m_addedAttractionTree);
+}
+
+void SpatialIndex::applyChanges(const vector<MapChange> &changes, const MapLoader &ml, const SegmentMapper &sm)
+{
+	if (changes.empty())
+		return;
+	vector<Attraction> touched;
+	for (const MapChange &change : changes)
+	{
+		switch (change.type)
+		{
+		case MapChange::SEGMENT_ADDED:
+			addLine(change.segNum, change.segment.segment);
+			break;
+		case MapChange::SEGMENT_REMOVED:
+			removeLine(change.segNum);
+			break;
+		case MapChange::SEGMENT_MOVED:
+			removeLine(change.fromSegNum);
+			addLine(change.segNum, change.segment.segment);
+			break;
+		case MapChange::ATTRACTION_ADDED:
+		case MapChange::ATTRACTION_REMOVED:
+			touched.push_back(change.attraction);
+			continue; // the segment's line stays where it is
+		}
+		touched.insert(touched.end(), change.segment.attractions.begin(), change.segment.attractions.end());
+	}
+	for (const Attraction &a : touched)
+		updateAttraction(a, ml, sm);
+
+	// the small trees are packed again from scratch, which only costs as much as what's been added.
+	// lines go in by segment number, so the tree breaks ties the way the built one does
+	vector<Line> live;
+	for (const Line &line : m_addedLines)
+		if (line.segment != NO_SEGMENT)
+			live.push_back(line);
+	sort(live.begin(), live.end(), [](const Line &a, const Line &b) { return a.segment < b.segment; });
+	vector<PackedRTree::Box> boxes;
+	boxes.reserve(live.size());
+	for (const Line &line : live)
+		boxes.push_back(lineBox(line));
+	m_addedSegmentTree.build(boxes);
+	m_addedTreeLines.resize(live.size());
+	for (uint32_t position = 0; position < live.size(); position++)
+		m_addedTreeLines[position] = live[m_addedSegmentTree.itemAt(position)];
+	boxes.clear();
+	for (const Attraction &a : m_addedAttractions)
+	{
+		const GeoCoord &gc = a.geocoordinates;
+		PackedRTree::Box box = { gc.latitude, gc.longitude, gc.latitude, gc.longitude };
+		boxes.push_back(box);
+	}
+	m_addedAttractionTree.build(boxes);
+}
+
+void SpatialIndex::removeLine(size_t segNum)
+{
+	uint32_t segment = static_cast<uint32_t>(segNum);
+	m_replacedSegments.associate(segment, true);
+	m_mayBeReplaced.set(segment % CHANGED_BITS);
+	uint32_t* added = m_addedLineOf.find(segment);
+	if (added != nullptr && *added != NO_LINE)
+	{
+		m_addedLines[*added].segment = NO_SEGMENT; // left in its cells, but skipped
+		*added = NO_LINE;
+	}
+}
+
+void SpatialIndex::addLine(size_t segNum, const GeoSegment &gs)
+{
+	removeLine(segNum);
+	Line line = { gs.start.latitude, gs.start.longitude, gs.end.latitude, gs.end.longitude, static_cast<uint32_t>(segNum), 0 };
+	uint32_t place = static_cast<uint32_t>(m_addedLines.size());
+	m_addedLines.push_back(line);
+	m_addedLineOf.associate(line.segment, place);
+
+	// into every cell its box overlaps, the way buildGrid does it. one that's off the grid goes in
+	// the cells along the edge nearest it, which are never farther from anything than it is
+	if (m_built->rows == 0)
+		return; // nothing was built, so there's no grid, and snapping goes through the trees
+	int row1 = rowOf(min(line.lat1, line.lat2)), row2 = rowOf(max(line.lat1, line.lat2));
+	int column1 = columnOf(min(line.lon1, line.lon2)), column2 = columnOf(max(line.lon1, line.lon2));
+	for (int row = row1; row <= row2; row++)
+		for (int column = column1; column <= column2; column++)
+		{
+			uint32_t cell = static_cast<uint32_t>(row * m_built->columns + column);
+			m_addedCellLines.findOrInsert(cell).push_back(place);
+			m_cellMayHaveAdded.set(cell % CHANGED_BITS);
+		}
+}
+
+void SpatialIndex::updateAttraction(const Attraction &a, const MapLoader &ml, const SegmentMapper &sm)
+{
+	const Built &built = *m_built;
+	CoordKey key(a.geocoordinates);
+	auto same = [&](const Attraction &other) { return other.name.id() == a.name.id() && CoordKey(other.geocoordinates) == key; };
+
+	const GeoCoord &gc = a.geocoordinates;
+	PackedRTree::Box box = { gc.latitude - 1e-7, gc.longitude - 1e-7, gc.latitude + 1e-7, gc.longitude + 1e-7 };
+	built.attractionTree.search(box, [&](uint32_t position)
+	{
+		if (same(built.attractions[position]))
+			m_removedAttractions.associate(position, true);
+	});
+	m_addedAttractions.erase(remove_if(m_addedAttractions.begin(), m_addedAttractions.end(), same), m_addedAttractions.end());
+
+	// anything still listing it is at its coordinate, so that's where the mapper looks
+	vector<size_t> segNums = sm.getSegmentNumbers(gc);
+	for (size_t segNum : segNums)
+		for (const Attraction &listed : ml.getSegment(segNum)->attractions)
+			if (same(listed))
+			{
+				m_addedAttractions.push_back(listed);
+				return;
+			}
+}
+
+template<typename Visit>
+void SpatialIndex::searchLines(const PackedRTree::Box &box, Visit visit) const
+{
+	const Built &built = *m_built;
+	built.segmentTree.search(box, [&](uint32_t position)
+	{
+		if (!replaced(built.lines[position]))
+			visit(built.lines[position]);
+	});
+	m_addedSegmentTree.search(box, [&](uint32_t position) { visit(m_addedTreeLines[position]); });
+}
+
+template<typename Visit>
+void SpatialIndex::searchAttractions(const PackedRTree::Box &box, Visit visit) const
+{
+	const Built &built = *m_built;
+	built.attractionTree.search(box, [&](uint32_t position)
+	{
+		if (m_removedAttractions.find(position) == nullptr)
+			visit(built.attractions[position]);
+	});
+	m_addedAttractionTree.search(box, [&](uint32_t position)
+	{
+		visit(m_addedAttractions[m_addedAttractionTree.itemAt(position)]);
+	});
+}
+
+void SpatialIndex::buildAttractions(Built &built, const MapLoader &ml)
+{
+	// an attraction listed on two segments is the same name at the same spot both times. sort a
+	// copy by that to find the repeats, then put the first of each back in map order
+	vector<const Attraction*> all;
+	vector<pair<pair<unsigned, uint64_t>, uint32_t>> keys; // (name, coordinate), place in all
+	for (const StreetSegment &seg : ml)
+		for (const Attraction &a : seg.attractions)
+		{
+			keys.push_back(make_pair(make_pair(a.name.id(), CoordKey(a.geocoordinates).bits()), static_cast<uint32_t>(all.size())));
+			all.push_back(&a);
+		}
+	sort(keys.begin(), keys.end());
+	vector<uint32_t> kept;
+	for (size_t i = 0; i < keys.size(); i++)
+		if (i == 0 || keys[i].first != keys[i - 1].first)
+			kept.push_back(keys[i].second);
+	sort(kept.begin(), kept.end());
+
+	vector<PackedRTree::Box> boxes;
+	boxes.reserve(kept.size());
+	for (uint32_t i : kept)
+	{
+		const GeoCoord &gc = all[i]->geocoordinates;
+		PackedRTree::Box box = { gc.latitude, gc.longitude, gc.latitude, gc.longitude };
+		boxes.push_back(box);
+	}
+	built.attractionTree.build(boxes);
+	built.attractions.clear();
+	built.attractions.reserve(kept.size());
+	for (uint32_t position = 0; position < kept.size(); position++)
+		built.attractions.push_back(*all[kept[built.attractionTree.itemAt(position)]]);
+}
+
+void SpatialIndex::buildGrid(Built &built)
+{
+	built.firstCellLine.clear();
+	built.cellLines.clear();
+	built.rows = built.columns = 0;
+	if (built.lines.empty())
+		return;
+
+	double maxLatitude, maxLongitude;
+	built.minLatitude = maxLatitude = built.lines[0].lat1;
+	built.minLongitude = maxLongitude = built.lines[0].lon1;
+	for (const Line &line : built.lines)
+	{
+		built.minLatitude = min(built.minLatitude, min(line.lat1, line.lat2));
+		maxLatitude = max(maxLatitude, max(line.lat1, line.lat2));
+		built.minLongitude = min(built.minLongitude, min(line.lon1, line.lon2));
+		maxLongitude = max(maxLongitude, max(line.lon1, line.lon2));
+	}
+
+	// square cells (as the ground sees them in the middle of the map), four for every segment. on the
+	// LA map that's about 60 meters a side, which measured fastest: smaller cells mean more of them
+	// to visit, bigger ones more lines in each
+	double xScale = cos(deg2rad((built.minLatitude + maxLatitude) / 2));
+	double height = maxLatitude - built.minLatitude, width = (maxLongitude - built.minLongitude) * xScale;
+	double cellSize = sqrt(height * width / (4 * built.lines.size()));
+	if (!(cellSize > 1e-6)) // everything's on one line (or one point)
+		cellSize = max(max(height, width) / (4 * built.lines.size()), 1e-6);
+	built.cellHeight = cellSize;
+	built.cellWidth = cellSize / xScale;
+	built.rows = static_cast<int>(height / built.cellHeight) + 1;
+	built.columns = static_cast<int>((maxLongitude - built.minLongitude) / built.cellWidth) + 1;
+
+	// counting sort: count each cell's lines, turn the counts into starting points, then fill in
+	vector<uint32_t> firstCellLine(static_cast<size_t>(built.rows) * built.columns + 1, 0), cellLines;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		if (pass == 1)
+		{
+			uint32_t total = 0;
+			for (uint32_t &first : firstCellLine)
+			{
+				uint32_t count = first;
+				first = total;
+				total += count;
+			}
+			cellLines.resize(total);
+		}
+		for (uint32_t position = 0; position < built.lines.size(); position++)
+		{
+			const Line &line = built.lines[position];
+			int row1 = rowOf(min(line.lat1, line.lat2)), row2 = rowOf(max(line.lat1, line.lat2));
+			int column1 = columnOf(min(line.lon1, line.lon2)), column2 = columnOf(max(line.lon1, line.lon2));
+			for (int row = row1; row <= row2; row++)
+				for (int column = column1; column <= column2; column++)
+				{
+					uint32_t &cell = firstCellLine[row * built.columns + column];
+					if (pass == 0)
+						cell++;
+					else
+						cellLines[cell++] = position;
+				}
+		}
+	}
+	// filling in moved every cell's start up to where the next cell starts, so shift them back
+	for (size_t cell = firstCellLine.size() - 1; cell > 0; cell--)
+		firstCellLine[cell] = firstCellLine[cell - 1];
+	firstCellLine[0] = 0;
+	built.firstCellLine.assign(move(firstCellLine));
+	built.cellLines.assign(move(cellLines));
+}
+
+int SpatialIndex::rowOf(double latitude) const
+{
+	double row = floor((latitude - m_built->minLatitude) / m_built->cellHeight);
+	return row < 0 ? 0 : row >= m_built->rows ? m_built->rows - 1 : static_cast<int>(row);
+}
+
+int SpatialIndex::columnOf(double longitude) const
+{
+	double column = floor((longitude - m_built->minLongitude) / m_built->cellWidth);
+	return column < 0 ? 0 : column >= m_built->columns ? m_built->columns - 1 : static_cast<int>(column);
+}
+
+double SpatialIndex::lineDistance2(const Line &line, double latitude, double longitude, double xScale, double &fraction)
+{
+	double dLat = line.lat2 - line.lat1, dLon = (line.lon2 - line.lon1) * xScale;
+	double pLat = latitude - line.lat1, pLon = (longitude - line.lon1) * xScale;
+	double length2 = dLat * dLat + dLon * dLon;
+	double t = length2 > 0 ? (pLat * dLat + pLon * dLon) / length2 : 0;
+	fraction = t < 0 ? 0 : t > 1 ? 1 : t;
+	double eLat = pLat - fraction * dLat, eLon = pLon - fraction * dLon;
+	return eLat * eLat + eLon * eLon;
+}
+
+bool SpatialIndex::lineCrossesBox(const Line &line, const PackedRTree::Box &box)
+{
+	// clip the line against each side of the box in turn, keeping the part of it (from t0 to t1
+	// along it) that's on the inside of every side so far. if nothing's left, it missed
+	double dLat = line.lat2 - line.lat1, dLon = line.lon2 - line.lon1;
+	const double step[4] = { -dLat, dLat, -dLon, dLon };
+	const double room[4] = { line.lat1 - box.minLatitude, box.maxLatitude - line.lat1,
+		line.lon1 - box.minLongitude, box.maxLongitude - line.lon1 };
+	double t0 = 0, t1 = 1;
+	for (int side = 0; side < 4; side++)
+	{
+		if (step[side] == 0) // running alongside this edge, so it's either all inside or all out
+		{
+			if (room[side] < 0)
+				return false;
+			continue;
+		}
+		double t = room[side] / step[side];
+		if (step[side] < 0)
+			t0 = max(t0, t);
+		else
+			t1 = min(t1, t);
+		if (t0 > t1)
+			return false;
+	}
+	return true;
+}
+
+PackedRTree::Box SpatialIndex::boxAround(const GeoCoord &center, double miles, double &radius, double &xScale)
+{
+	const double earthRadiusMiles = 6371.0 * 0.621371; // what distanceEarthMiles uses
+	radius = rad2deg(max(miles, 0.0) / earthRadiusMiles);
+	xScale = max(cos(deg2rad(center.latitude)), 1e-9);
+	PackedRTree::Box box = { center.latitude - radius, center.longitude - radius / xScale,
+		center.latitude + radius, center.longitude + radius / xScale };
+	return box;
+}
+
+PackedRTree::Box SpatialIndex::lineBox(const Line &line)
+{
+	PackedRTree::Box box = { min(line.lat1, line.lat2), min(line.lon1, line.lon2), max(line.lat1, line.lat2), max(line.lon1, line.lon2) };
+	return box;
+}
+
+bool SpatialIndex::nearestInGrid(double latitude, double longitude, double xScale, const Line* &nearest) const
+{
+	const Built &built = *m_built;
+	// where the coordinate is in cell units, which can be off the grid, and the cell it's closest to
+	double gridRow = (latitude - built.minLatitude) / built.cellHeight, gridColumn = (longitude - built.minLongitude) / built.cellWidth;
+	int row = rowOf(latitude), column = columnOf(longitude);
+	double cellWidth = built.cellWidth * xScale; // in the same units as cellHeight
+
+	double best = 1e300; // squared distance to the closest line so far
+	nearest = nullptr;
+	auto consider = [&](const Line &line)
+	{
+		double fraction;
+		double d = lineDistance2(line, latitude, longitude, xScale, fraction);
+		if (d < best || (d == best && line.segment < nearest->segment))
+		{
+			best = d;
+			nearest = &line;
+		}
+	};
+	auto check = [&](int r, int c)
+	{
+		uint32_t cell = static_cast<uint32_t>(r * built.columns + c);
+		const uint32_t* end = built.cellLines.data() + built.firstCellLine[cell + 1];
+		for (const uint32_t* p = built.cellLines.data() + built.firstCellLine[cell]; p != end; p++)
+			if (!replaced(built.lines[*p]))
+				consider(built.lines[*p]);
+		const vector<uint32_t>* added = m_cellMayHaveAdded[cell % CHANGED_BITS] ? m_addedCellLines.find(cell) : nullptr;
+		if (added != nullptr)
+			for (uint32_t place : *added)
+				if (m_addedLines[place].segment != NO_SEGMENT)
+					consider(m_addedLines[place]);
+	};
+
+	// search rings of cells around the coordinate's cell, moving out until the nearest cell the
+	// next ring could have is farther away than the best line found so far
+	check(row, column);
+	for (int k = 1; ; k++)
+	{
+		bool below = row - k >= 0, above = row + k < built.rows, left = column - k >= 0, right = column + k < built.columns;
+		if (!below && !above && !left && !right) // the rings have covered the whole grid
+			return true;
+		double bound = 1e300;
+		if (below)
+			bound = min(bound, (gridRow - (row - k + 1)) * built.cellHeight);
+		if (above)
+			bound = min(bound, ((row + k) - gridRow) * built.cellHeight);
+		if (left)
+			bound = min(bound, (gridColumn - (column - k + 1)) * cellWidth);
+		if (right)
+			bound = min(bound, ((column + k) - gridColumn) * cellWidth);
+		if (bound > 0 && bound * bound > best)
+			return true;
+		if (k > MAX_RINGS)
+			return false;
+
+		int firstColumn = max(column - k, 0), lastColumn = min(column + k, built.columns - 1);
+		if (below)
+			for (int c = firstColumn; c <= lastColumn; c++)
+				check(row - k, c);
+		if (above)
+			for (int c = firstColumn; c <= lastColumn; c++)
+				check(row + k, c);
+		int firstRow = max(row - k + 1, 0), lastRow = min(row + k - 1, built.rows - 1);
+		for (int r = firstRow; r <= lastRow; r++)
+		{
+			if (left)
+				check(r, column - k);
+			if (right)
+				check(r, column + k);
+		}
+	}
+}
+
+bool SpatialIndex::nearestSegment(double latitude, double longitude, SegmentSnap &snap) const
+{
+	const Built &built = *m_built;
+	double xScale = cos(deg2rad(latitude));
+	const Line* nearest = nullptr;
+	if (built.rows == 0 || !nearestInGrid(latitude, longitude, xScale, nearest))
+	{
+		// the closest from each tree, with lines patches have replaced as infinitely far
+		double fraction;
+		uint32_t position = built.segmentTree.nearest(latitude, longitude, xScale, [&](uint32_t p)
+		{
+			return replaced(built.lines[p]) ? HUGE_VAL : lineDistance2(built.lines[p], latitude, longitude, xScale, fraction);
+		});
+		nearest = position == PackedRTree::NO_ITEM ? nullptr : &built.lines[position];
+		position = m_addedSegmentTree.nearest(latitude, longitude, xScale, [&](uint32_t p)
+		{
+			return lineDistance2(m_addedTreeLines[p], latitude, longitude, xScale, fraction);
+		});
+		if (position != PackedRTree::NO_ITEM)
+		{
+			const Line &added = m_addedTreeLines[position];
+			double d = lineDistance2(added, latitude, longitude, xScale, fraction);
+			double best = nearest == nullptr ? HUGE_VAL : lineDistance2(*nearest, latitude, longitude, xScale, fraction);
+			if (d < best || (d == best && added.segment < nearest->segment))
+				nearest = &added;
+		}
+	}
+	if (nearest == nullptr) // every segment has been patched away
+		return false;
+
+	const Line &line = *nearest;
+	snap.segment = line.segment;
+	lineDistance2(line, latitude, longitude, xScale, snap.fraction);
+	snap.latitude = line.lat1 + snap.fraction * (line.lat2 - line.lat1);
+	snap.longitude = line.lon1 + snap.fraction * (line.lon2 - line.lon1);
+	GeoCoord from, to; // distanceEarthMiles only looks at the numbers
+	from.latitude = latitude;
+	from.longitude = longitude;
+	to.latitude = snap.latitude;
+	to.longitude = snap.longitude;
+	snap.distance = distanceEarthMiles(from, to);
+	return true;
+}
+
+void SpatialIndex::segmentsInBox(const PackedRTree::Box &box, vector<size_t> &out) const
+{
+	out.clear();
+	searchLines(box, [&](const Line &line)
+	{
+		if (lineCrossesBox(line, box))
+			out.push_back(line.segment);
+	});
+}
+
+void SpatialIndex::segmentsWithin(const GeoCoord &center, double miles, vector<size_t> &out) const
+{
+	out.clear();
+	double radius, xScale;
+	PackedRTree::Box box = boxAround(center, miles, radius, xScale);
+	searchLines(box, [&](const Line &line)
+	{
+		double fraction;
+		if (lineDistance2(line, center.latitude, center.longitude, xScale, fraction) <= radius * radius)
+			out.push_back(line.segment);
+	});
+}
+
+void SpatialIndex::attractionsInBox(const PackedRTree::Box &box, vector<Attraction> &out) const
+{
+	out.clear();
+	searchAttractions(box, [&](const Attraction &a)
+	{
+		const GeoCoord &gc = a.geocoordinates;
+		if (gc.latitude >= box.minLatitude && gc.latitude <= box.maxLatitude &&
+			gc.longitude >= box.minLongitude && gc.longitude <= box.maxLongitude)
+			out.push_back(a);
+	});
+}
+
+void SpatialIndex::attractionsWithin(const GeoCoord &center, double miles, vector<Attraction> &out) const
+{
+	out.clear();
+	double radius, xScale;
+	PackedRTree::Box box = boxAround(center, miles, radius, xScale);
+	searchAttractions(box, [&](const Attraction &a)
+	{
+		const GeoCoord &gc = a.geocoordinates;
+		double dLat = gc.latitude - center.latitude, dLon = (gc.longitude - center.longitude) * xScale;
+		if (dLat * dLat + dLon * dLon <= radius * radius)
+			out.push_back(a);
+	});
+}
+
+// the distance to a box goes through the haversine formula with the smallest latitude and longitude
+// differences anything in the box could have, and the smallest cosine of a latitude in it. each term
+// is as small as it can be on its own, so the sum is no more than it is for any point in the box.
+// the built tree and the added one each hand over their k closest, and those are merged
+void SpatialIndex::nearestAttractions(const GeoCoord &center, size_t k, vector<NearbyAttraction> &out) const
+{
+	out.clear();
+	if (k == 0)
+		return;
+	const Built &built = *m_built;
+	const double earthRadiusMiles = 6371.0 * 0.621371; // what distanceEarthMiles uses
+	double centerCos = cos(deg2rad(center.latitude));
+	auto boxBound = [&](const PackedRTree::Box &box)
+	{
+		double dLat = max(max(box.minLatitude - center.latitude, center.latitude - box.maxLatitude), 0.0);
+		double dLon = max(max(box.minLongitude - center.longitude, center.longitude - box.maxLongitude), 0.0);
+		double minCos = min(cos(deg2rad(box.minLatitude)), cos(deg2rad(box.maxLatitude)));
+		double u = sin(deg2rad(dLat) / 2), v = sin(deg2rad(dLon) / 2);
+		double h = u * u + centerCos * max(minCos, 0.0) * v * v;
+		// shaved a hair so rounding can't put a box behind a point at exactly the same distance
+		return 2 * earthRadiusMiles * asin(sqrt(min(h, 1.0))) * (1 - 1e-12);
+	};
+	auto itemDistance = [&](uint32_t position) { return distanceEarthMiles(center, built.attractions[position].geocoordinates); };
+	built.attractionTree.inOrder(boxBound, itemDistance, [&](uint32_t position, double distance)
+	{
+		if (m_removedAttractions.find(position) != nullptr)
+			return true;
+		NearbyAttraction found = { built.attractions[position], distance };
+		out.push_back(found);
+		return out.size() < k;
+	});
+	if (m_addedAttractions.empty())
+		return;
+
+	vector<NearbyAttraction> added;
+	auto addedDistance = [&](uint32_t position)
+	{
+		return distanceEarthMiles(center, m_addedAttractions[m_addedAttractionTree.itemAt(position)].geocoordinates);
+	};
+	m_addedAttractionTree.inOrder(boxBound, addedDistance, [&](uint32_t position, double distance)
+	{
+		NearbyAttraction found = { m_addedAttractions[m_addedAttractionTree.itemAt(position)], distance };
+		added.push_back(found);
+		return added.size() < k;
+	});
+	vector<NearbyAttraction> both;
+	merge(out.begin(), out.end(), added.begin(), added.end(), back_inserter(both),
+		[](const NearbyAttraction &a, const NearbyAttraction &b) { return a.distance < b.distance; });
+	both.resize(min(both.size(), k));
+	out.swap(both);
+}
+
+void SpatialIndex::attractionsAt(const GeoCoord &gc, vector<Attraction> &out) const
+{
+	// a box a rounding step wide, then only what has the same key
+	PackedRTree::Box box = { gc.latitude - 1e-7, gc.longitude - 1e-7, gc.latitude + 1e-7, gc.longitude + 1e-7 };
+	CoordKey key(gc);
+	attractionsInBox(box, out);
+	out.erase(remove_if(out.begin(), out.end(), [&](const Attraction &a) { return CoordKey(a.geocoordinates) != key; }), out.end());
+}
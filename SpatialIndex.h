@@ -0,0 +1,410 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include "provided.h"
+#include "support.h"
+#include "MapSnapshot.h"
+#include "MyHashMap.h"
+#include <vector>
+#include <memory>
+#include <bitset>
+#include <utility>
+#include <algorithm>
+#include <queue>
+#include <cstdint>
+
+// A read-only R-tree over latitude/longitude boxes, packed the way static trees usually are: the
+// items are sorted along a Hilbert curve through their centers (so items next to each other in the
+// order are next to each other on the map), every run of FANOUT of them gets a parent box, every
+// FANOUT parents get a grandparent, and so on up to a single root. All the boxes live in one array,
+// items first and the root last, so there are no pointers and a level is found by arithmetic.
+//
+// Searches hand back an item's position in the sorted order. itemAt turns that into the number
+// the item was built with, and callers that keep their own per-item data can store it in the
+// same order to have it next to its neighbors' too.
+//
+// Nothing in the arrays points anywhere, so a tree can be saved in a map snapshot as it is and
+// searched right where the snapshot is mapped.
+class PackedRTree
+{
+public:
+	struct Box {
+		double minLatitude, minLongitude, maxLatitude, maxLongitude;
+	};
+	static const uint32_t FANOUT = 8;
+	static const uint32_t NO_ITEM = static_cast<uint32_t>(-1);
+
+	PackedRTree() {}
+	// throws away whatever was there and indexes boxes[i] as item number i
+	void build(const std::vector<Box> &boxes);
+	// throws away whatever was there and searches the tree saved in the three sections instead, in
+	// place. snapshot has to outlive the tree (or the next build or open)
+	void open(const MapSnapshot &snapshot, snapshot::SectionId boxes, snapshot::SectionId items, snapshot::SectionId levelStart);
+	// a tree is only ever copied on purpose, with this, and never by accident
+	void copyFrom(const PackedRTree &other)
+	{
+		m_boxes.copyFrom(other.m_boxes);
+		m_items.copyFrom(other.m_items);
+		m_levelStart.copyFrom(other.m_levelStart);
+	}
+	size_t size() const { return m_items.size(); }
+	uint32_t itemAt(uint32_t position) const { return m_items[position]; }
+
+	// the position of the item closest to the coordinate, or NO_ITEM if there aren't any.
+	// distance2(position) has to return the item's squared distance in flattened degrees: latitude
+	// differences as they are and longitude differences times xScale. boxes are measured the same
+	// way, so they never claim to be farther away than what's inside them. two items equally close
+	// are broken by the lower item number
+	template<typename Distance2>
+	uint32_t nearest(double latitude, double longitude, double xScale, Distance2 distance2) const;
+
+	// calls visit(position) for every item whose box overlaps the box, touching counts. boxes are
+	// kept a little bigger than they were built with (see StoredBox), so items just outside can be
+	// visited too: callers test what they're given against the real thing
+	template<typename Visit>
+	void search(const Box &box, Visit visit) const;
+
+	// hands items to visit(position, distance) closest first, by whatever distance the caller uses:
+	// itemDistance(position) is how far an item is, and boxBound(box) must never be more than that
+	// for anything inside box. stops as soon as visit returns false. items equally far come in order
+	// of item number
+	template<typename BoxBound, typename ItemDistance, typename Visit>
+	void inOrder(BoxBound boxBound, ItemDistance itemDistance, Visit visit) const;
+
+	PackedRTree(const PackedRTree&) = delete;
+	PackedRTree& operator=(const PackedRTree&) = delete;
+private:
+	friend class MapSnapshot; // writes the arrays out, and checks them when they're read back
+
+	// boxes are stored as floats, rounded outward so they still contain everything they did, to fit
+	// twice as many in a cache line. most of a search's time goes to waiting on those lines
+	struct StoredBox {
+		float minLatitude, minLongitude, maxLatitude, maxLongitude;
+	};
+	FlatArray<StoredBox> m_boxes;		// items in Hilbert order, then each level of parents, root last
+	FlatArray<uint32_t> m_items;		// item number at each position
+	FlatArray<uint32_t> m_levelStart;	// where each level starts in m_boxes, items (level 0) first, plus one past the root
+
+	uint32_t childrenBegin(size_t level, uint32_t position) const
+	{
+		return m_levelStart[level - 1] + (position - m_levelStart[level]) * FANOUT;
+	}
+	uint32_t childrenEnd(size_t level, uint32_t position) const
+	{
+		uint32_t end = childrenBegin(level, position) + FANOUT;
+		return end < m_levelStart[level] ? end : m_levelStart[level];
+	}
+	static Box unpack(const StoredBox &stored)
+	{
+		Box box = { stored.minLatitude, stored.minLongitude, stored.maxLatitude, stored.maxLongitude };
+		return box;
+	}
+	static bool overlaps(const StoredBox &stored, const Box &box)
+	{
+		return stored.minLatitude <= box.maxLatitude && stored.maxLatitude >= box.minLatitude &&
+			stored.minLongitude <= box.maxLongitude && stored.maxLongitude >= box.minLongitude;
+	}
+	static double boxDistance2(const StoredBox &box, double latitude, double longitude, double xScale)
+	{
+		// at most one of the differences on each axis is positive. written with max so there are no branches
+		double dLat = std::max(std::max(box.minLatitude - latitude, latitude - box.maxLatitude), 0.0);
+		double dLon = std::max(std::max(box.minLongitude - longitude, longitude - box.maxLongitude), 0.0) * xScale;
+		return dLat * dLat + dLon * dLon;
+	}
+
+	struct NearestSearch {
+		double latitude, longitude, xScale;
+		double best; // squared distance to bestPosition
+		uint32_t bestPosition;
+		uint32_t firstLeaf; // the level 1 node that was searched before anything else
+	};
+	template<typename Distance2>
+	void nearestInLeaf(uint32_t position, NearestSearch &search, Distance2 &distance2) const;
+	template<typename Distance2>
+	void nearestBelow(size_t level, uint32_t position, NearestSearch &search, Distance2 &distance2) const;
+	template<typename Visit>
+	void searchBelow(size_t level, uint32_t position, const Box &box, Visit &visit) const;
+};
+
+// the search starts by following the closest box down from the root to one run of items, which is
+// almost always where the answer is. the best of those then rules out nearly everything else on
+// the way through the rest of the tree. children aren't sorted by distance: on a tree this shallow,
+// the comparisons a sort takes cost more in mispredicted branches than the extra boxes it saves
+template<typename Distance2>
+uint32_t PackedRTree::nearest(double latitude, double longitude, double xScale, Distance2 distance2) const
+{
+	if (m_items.empty())
+		return NO_ITEM;
+	NearestSearch search = { latitude, longitude, xScale, 1e300, NO_ITEM, 0 };
+	size_t root = m_levelStart.size() - 2;
+	uint32_t position = m_levelStart[root];
+	for (size_t level = root; level > 1; level--)
+	{
+		uint32_t closest = childrenBegin(level, position);
+		double closestDistance2 = boxDistance2(m_boxes[closest], latitude, longitude, xScale);
+		for (uint32_t child = closest + 1; child < childrenEnd(level, position); child++)
+		{
+			double d = boxDistance2(m_boxes[child], latitude, longitude, xScale);
+			closest = d < closestDistance2 ? child : closest;
+			closestDistance2 = d < closestDistance2 ? d : closestDistance2;
+		}
+		position = closest;
+	}
+	search.firstLeaf = position;
+	nearestInLeaf(position, search, distance2);
+	if (root > 1) // otherwise the root was the only leaf
+		nearestBelow(root, m_levelStart[root], search, distance2);
+	return search.bestPosition;
+}
+
+template<typename Distance2>
+void PackedRTree::nearestInLeaf(uint32_t position, NearestSearch &search, Distance2 &distance2) const
+{
+	for (uint32_t child = childrenBegin(1, position); child < childrenEnd(1, position); child++)
+	{
+		if (boxDistance2(m_boxes[child], search.latitude, search.longitude, search.xScale) > search.best)
+			continue;
+		double d = distance2(child);
+		if (d < search.best || (d == search.best && m_items[child] < m_items[search.bestPosition]))
+		{
+			search.best = d;
+			search.bestPosition = child;
+		}
+	}
+}
+
+template<typename Distance2>
+void PackedRTree::nearestBelow(size_t level, uint32_t position, NearestSearch &search, Distance2 &distance2) const
+{
+	for (uint32_t child = childrenBegin(level, position); child < childrenEnd(level, position); child++)
+	{
+		if (boxDistance2(m_boxes[child], search.latitude, search.longitude, search.xScale) > search.best)
+			continue;
+		if (level > 2)
+			nearestBelow(level - 1, child, search, distance2);
+		else if (child != search.firstLeaf)
+			nearestInLeaf(child, search, distance2);
+	}
+}
+
+// only the parts of the tree whose boxes overlap the query are opened, so the time goes to the
+// items found plus the one or two paths down to the edges of the query that don't find anything
+template<typename Visit>
+void PackedRTree::search(const Box &box, Visit visit) const
+{
+	if (m_items.empty())
+		return;
+	size_t root = m_levelStart.size() - 2;
+	if (overlaps(m_boxes[m_levelStart[root]], box))
+		searchBelow(root, m_levelStart[root], box, visit);
+}
+
+template<typename Visit>
+void PackedRTree::searchBelow(size_t level, uint32_t position, const Box &box, Visit &visit) const
+{
+	for (uint32_t child = childrenBegin(level, position); child < childrenEnd(level, position); child++)
+	{
+		if (!overlaps(m_boxes[child], box))
+			continue;
+		if (level > 1)
+			searchBelow(level - 1, child, box, visit);
+		else
+			visit(child);
+	}
+}
+
+// a best-first walk: everything opened so far waits in one queue by distance, and whatever's closest
+// is taken next. a box comes off before anything farther than its bound, so by the time an item
+// does, nothing still waiting can hold one closer
+template<typename BoxBound, typename ItemDistance, typename Visit>
+void PackedRTree::inOrder(BoxBound boxBound, ItemDistance itemDistance, Visit visit) const
+{
+	if (m_items.empty())
+		return;
+	struct Waiting {
+		double distance;
+		size_t level; // 0 for an item
+		uint32_t position;
+		uint32_t item; // only used for items
+	};
+	auto later = [](const Waiting &a, const Waiting &b)
+	{
+		if (a.distance != b.distance)
+			return a.distance > b.distance;
+		if (a.level != b.level) // at the same distance a box goes first, it could hold an item that close
+			return a.level < b.level;
+		return a.item > b.item;
+	};
+	std::priority_queue<Waiting, std::vector<Waiting>, decltype(later)> queue(later);
+	size_t root = m_levelStart.size() - 2;
+	Waiting start = { boxBound(unpack(m_boxes[m_levelStart[root]])), root, m_levelStart[root], 0 };
+	queue.push(start);
+	while (!queue.empty())
+	{
+		Waiting next = queue.top();
+		queue.pop();
+		if (next.level == 0)
+		{
+			if (!visit(next.position, next.distance))
+				return;
+			continue;
+		}
+		for (uint32_t child = childrenBegin(next.level, next.position); child < childrenEnd(next.level, next.position); child++)
+		{
+			Waiting opened = { 0, next.level - 1, child, 0 };
+			if (next.level == 1)
+			{
+				opened.distance = itemDistance(child);
+				opened.item = m_items[child];
+			}
+			else
+				opened.distance = boxBound(unpack(m_boxes[child]));
+			queue.push(opened);
+		}
+	}
+}
+
+// where a coordinate lands when it's moved onto the nearest street
+struct SegmentSnap
+{
+	size_t segment;		// the loader's number for the nearest segment
+	double latitude;	// the closest point on that segment
+	double longitude;
+	double fraction;	// how far along the segment the point is, 0 at its start and 1 at its end
+	double distance;	// miles from the coordinate to the point
+};
+
+// Finds segments by where they are instead of by an exact coordinate. Distances are measured on a
+// flat projection: a degree of longitude counts for cos(latitude) of a degree of latitude, using the
+// latitude being asked about. Over the few blocks a query actually compares, that's the same answer
+// the great circle would give.
+//
+// Box and radius queries (for drawing a tile, or for what's around a spot) go through R-trees, one
+// over the segments and one over the attractions, and take time in proportion to what they find
+// rather than to the size of the map. Nearest attractions go through the second tree too, but by
+// great circle distance, since their answers get shown to people as distances.
+//
+// Snapping mostly goes through a uniform grid of cells about as wide as a short block, each listing
+// the segments whose bounding boxes overlap it. A coordinate near a street only has to look at its
+// own cell and the ones around it. One that's farther than a few cells from every street (or off the
+// map altogether) would have to walk a lot of empty cells, so it goes to an R-tree instead.
+//
+// A patched map doesn't build its index again. What build made is shared with the index it was
+// patched from, and what's changed since is kept to the side: the built lines of segment numbers a
+// patch has touched are skipped, and whatever segment has that number now is an added line. Added
+// lines go into the grid's cells through a list per cell of their own, and into a small R-tree
+// that holds only them. Attractions work the same way, minus the grid. The small trees are packed
+// again after every patch, which costs about as much as the patches have changed.
+class SpatialIndex
+{
+public:
+	SpatialIndex();
+	// throws away whatever was there and indexes ml's segments. nothing points back into ml, unless
+	// it came from a snapshot that still has its map: then the index is read from the snapshot where
+	// it's mapped, and ml has to outlive this one (or the next build)
+	void build(const MapLoader &ml);
+	// starts out as the same index as other, to be patched without changing other. what other's
+	// build made is shared rather than copied, apart from whatever patches have changed in it
+	void initFrom(const SpatialIndex &other);
+	// indexes the segments and attractions in changes, which MapLoader::applyPatchOp made to ml, in
+	// place of what was there before. sm has to have had the same changes applied already
+	void applyChanges(const std::vector<MapChange> &changes, const MapLoader &ml, const SegmentMapper &sm);
+
+	// the segment closest to the coordinate and the point on it closest to the coordinate. the
+	// coordinate doesn't have to be on the map, or even near it. returns false only if there are no
+	// segments. two segments exactly as close are broken by the lower segment number
+	bool nearestSegment(double latitude, double longitude, SegmentSnap &snap) const;
+	bool nearestSegment(const GeoCoord &gc, SegmentSnap &snap) const { return nearestSegment(gc.latitude, gc.longitude, snap); }
+
+	// every segment with some part inside the box (its edges count), by the loader's segment number,
+	// in no particular order. out is emptied first
+	void segmentsInBox(const PackedRTree::Box &box, std::vector<size_t> &out) const;
+	// every segment that comes within miles of the center
+	void segmentsWithin(const GeoCoord &center, double miles, std::vector<size_t> &out) const;
+	// the same for attractions. one that's listed on more than one segment is only reported once
+	void attractionsInBox(const PackedRTree::Box &box, std::vector<Attraction> &out) const;
+	void attractionsWithin(const GeoCoord &center, double miles, std::vector<Attraction> &out) const;
+	// the k attractions closest to the center, closest first, by distanceEarthMiles
+	void nearestAttractions(const GeoCoord &center, size_t k, std::vector<NearbyAttraction> &out) const;
+	// the attractions at exactly this coordinate (to the map data's precision)
+	void attractionsAt(const GeoCoord &gc, std::vector<Attraction> &out) const;
+
+	SpatialIndex(const SpatialIndex&) = delete;
+	SpatialIndex& operator=(const SpatialIndex&) = delete;
+private:
+	friend class MapSnapshot; // writes what build made, and checks it when it's read back
+
+	struct Line {
+		double lat1, lon1, lat2, lon2;
+		uint32_t segment;
+		uint32_t padding; // spelled out so a snapshot writes it as zeros
+	};
+	// how many rings of cells around a coordinate's own cell the grid searches before giving up
+	static const int MAX_RINGS = 3;
+	static const uint32_t NO_SEGMENT = static_cast<uint32_t>(-1); // an added line that's since been removed
+	static const uint32_t NO_LINE = static_cast<uint32_t>(-1);
+	static const size_t CHANGED_BITS = 4096;
+
+	// what build makes. nothing changes it afterwards, so every index patched from this one shares it
+	// the arrays are read in place when the map came from a snapshot, which saved them
+	struct Built {
+		PackedRTree segmentTree;
+		FlatArray<Line> lines; // in the tree's order, so a leaf's lines are next to each other
+		PackedRTree attractionTree;
+		std::vector<Attraction> attractions; // in that tree's order
+
+		double minLatitude, minLongitude;
+		double cellHeight, cellWidth; // degrees of latitude and of longitude
+		int rows, columns;
+		FlatArray<uint32_t> firstCellLine; // one per cell plus one past the end, cells numbered row by row
+		FlatArray<uint32_t> cellLines; // positions in lines, grouped by cell
+	};
+	std::shared_ptr<const Built> m_built;
+
+	// built segment numbers whose lines patches have made out of date
+	MyHashMap<uint32_t, bool> m_replacedSegments;
+	// bit segment % CHANGED_BITS is set if any segment with that remainder is in m_replacedSegments,
+	// so the searches can tell a line is current without a trip through the hash table
+	std::bitset<CHANGED_BITS> m_mayBeReplaced;
+	std::vector<Line> m_addedLines; // the ones removed since have NO_SEGMENT
+	MyHashMap<uint32_t, uint32_t> m_addedLineOf; // segment number to its place in m_addedLines, or NO_LINE
+	MyHashMap<uint32_t, std::vector<uint32_t>> m_addedCellLines; // cell to places in m_addedLines
+	std::bitset<CHANGED_BITS> m_cellMayHaveAdded; // the same kind of filter, by cell % CHANGED_BITS
+	PackedRTree m_addedSegmentTree; // over the added lines still on the map
+	std::vector<Line> m_addedTreeLines; // those lines in that tree's order
+	MyHashMap<uint32_t, bool> m_removedAttractions; // positions in Built::attractions no longer on the map
+	std::vector<Attraction> m_addedAttractions;
+	PackedRTree m_addedAttractionTree; // item numbers are places in m_addedAttractions
+
+	void buildGrid(Built &built);
+	// what build would make, read from the snapshot instead
+	static void openSnapshot(Built &built, const MapSnapshot &snapshot);
+	int rowOf(double latitude) const;
+	int columnOf(double longitude) const;
+	// squared distance from the coordinate to the line, and how far along the line the closest point is
+	static double lineDistance2(const Line &line, double latitude, double longitude, double xScale, double &fraction);
+	static bool lineCrossesBox(const Line &line, const PackedRTree::Box &box);
+	// the box around the circle, and the circle's radius in flattened degrees
+	static PackedRTree::Box boxAround(const GeoCoord &center, double miles, double &radius, double &xScale);
+	static PackedRTree::Box lineBox(const Line &line);
+	void buildAttractions(Built &built, const MapLoader &ml);
+	// false if the closest line is more than MAX_RINGS cells away, since then it may not have been seen
+	bool nearestInGrid(double latitude, double longitude, double xScale, const Line* &nearest) const;
+	// a built line whose segment number a patch has touched
+	bool replaced(const Line &line) const
+	{
+		return m_mayBeReplaced[line.segment % CHANGED_BITS] && m_replacedSegments.find(line.segment) != nullptr;
+	}
+	void removeLine(size_t segNum);
+	void addLine(size_t segNum, const GeoSegment &gs);
+	// drops every copy of the attraction and puts one back if it's still on the map
+	void updateAttraction(const Attraction &a, const MapLoader &ml, const SegmentMapper &sm);
+	// calls visit(line) for every current line whose box overlaps box
+	template<typename Visit>
+	void searchLines(const PackedRTree::Box &box, Visit visit) const;
+	// calls visit(attraction) for every current attraction that might be in box
+	template<typename Visit>
+	void searchAttractions(const PackedRTree::Box &box, Visit visit) const;
+};
+
+#endif // for SPATIAL_INDEX_H
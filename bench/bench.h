@@ -0,0 +1,26 @@
+#ifndef BENCH_INCLUDED
+#define BENCH_INCLUDED
+
+// bits the benchmark drivers share. each driver is built on its own against every .cpp in the top
+// directory but main.cpp, from the top directory, e.g.
+//   g++ -std=c++11 -O2 -I. -o parsebench bench/parsebench.cpp $(ls *.cpp | grep -v main.cpp) -lpthread
+
+#include <chrono>
+#include <algorithm>
+
+// the fastest of runs calls to f, in milliseconds. the fastest is the one least disturbed by
+// everything else the machine was doing
+template<typename F>
+double bestMs(int runs, F f)
+{
+	double best = 1e30;
+	for (int run = 0; run < runs; run++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		f();
+		best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+
+#endif // BENCH_INCLUDED
@@ -0,0 +1,78 @@
+// the time from nothing to a map that can be routed over: loading it, then building the segment
+// and attraction mappers, the road graph and the spatial index, best of 10 for each step. run it
+// on the text map data, and on a snapshot of it (written first if a snapshot file is named), where
+// everything but AttractionMapper's name table is read from the file instead of being built.
+//
+//   ./coldbench mapdata.txt map.snapshot
+
+#include "provided.h"
+#include "RoadGraph.h"
+#include "SpatialIndex.h"
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+using namespace std;
+
+static double now()
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool coldStart(const string &mapFile)
+{
+	const int STEPS = 6;
+	const char* names[STEPS] = { "load", "SegmentMapper", "AttractionMapper", "RoadGraph", "SpatialIndex", "total" };
+	double best[STEPS];
+	fill(best, best + STEPS, 1e30);
+	for (int run = 0; run < 10; run++)
+	{
+		double t0 = now();
+		MapLoader ml;
+		if (!ml.load(mapFile))
+			return false;
+		double t1 = now();
+		SegmentMapper sm;
+		sm.init(ml);
+		double t2 = now();
+		AttractionMapper am;
+		am.init(ml);
+		double t3 = now();
+		RoadGraph graph;
+		graph.build(ml, sm);
+		double t4 = now();
+		SpatialIndex spatial;
+		spatial.build(ml);
+		double t5 = now();
+		double took[STEPS] = { t1 - t0, t2 - t1, t3 - t2, t4 - t3, t5 - t4, t5 - t0 };
+		for (int step = 0; step < STEPS; step++)
+			best[step] = min(best[step], took[step]);
+	}
+	printf("%s\n", mapFile.c_str());
+	for (int step = 0; step < STEPS; step++)
+		printf("  %-16s %8.2f ms\n", names[step], best[step]);
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		cerr << "usage: coldbench mapfile [snapshotfile]" << endl;
+		return 1;
+	}
+	if (!coldStart(argv[1]))
+	{
+		cerr << "can't load " << argv[1] << endl;
+		return 1;
+	}
+	if (argc > 2)
+	{
+		MapLoader ml;
+		if (!ml.load(argv[1]) || !ml.saveSnapshot(argv[2]) || !coldStart(argv[2]))
+		{
+			cerr << "can't write or load " << argv[2] << endl;
+			return 1;
+		}
+	}
+}
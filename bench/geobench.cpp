@@ -0,0 +1,113 @@
+// measures the batch distance and angle kernels in GeoMath.h against the scalar functions in
+// provided.h: the largest difference between them over every segment and over random pairs of
+// points, then the time per point for one origin against every point on the map.
+//
+//   ./geobench mapdata.txt
+
+#include "provided.h"
+#include "GeoMath.h"
+#include "bench/bench.h"
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <cstdio>
+using namespace std;
+
+static double angleDifference(double a, double b)
+{
+	double d = fabs(a - b);
+	return min(d, 360 - d);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		cerr << "usage: geobench mapfile" << endl;
+		return 1;
+	}
+	MapLoader ml;
+	if (!ml.load(argv[1]))
+	{
+		cerr << "can't load " << argv[1] << endl;
+		return 1;
+	}
+	vector<GeoCoord> coords;
+	for (const StreetSegment &seg : ml)
+	{
+		coords.push_back(seg.segment.start);
+		coords.push_back(seg.segment.end);
+		for (const Attraction &a : seg.attractions)
+			coords.push_back(a.geocoordinates);
+	}
+	GeoPoints points;
+	points.reserve(coords.size());
+	for (const GeoCoord &gc : coords)
+		points.push_back(gc);
+
+	// accuracy: each segment's own length, then 200 random origins against every point
+	double maxMiles = 0, maxAngle = 0, maxBetween = 0;
+	for (const StreetSegment &seg : ml)
+	{
+		double d = distanceEarthMiles(GeoPoint(seg.segment.start), GeoPoint(seg.segment.end));
+		maxMiles = max(maxMiles, fabs(d - distanceEarthMiles(seg.segment.start, seg.segment.end)));
+	}
+	mt19937 rng(5);
+	vector<double> miles, angles, between;
+	for (int i = 0; i < 200; i++)
+	{
+		const GeoCoord &from = coords[rng() % coords.size()];
+		GeoSegment line1(coords[rng() % coords.size()], coords[rng() % coords.size()]);
+		distancesEarthMiles(GeoPoint(from), points, miles);
+		anglesOfLines(GeoPoint(from), points, angles);
+		anglesBetween2Lines(line1, GeoPoint(from), points, between);
+		for (size_t p = 0; p < coords.size(); p++)
+		{
+			GeoSegment line2(from, coords[p]);
+			maxMiles = max(maxMiles, fabs(miles[p] - distanceEarthMiles(from, coords[p])));
+			maxAngle = max(maxAngle, angleDifference(angles[p], angleOfLine(line2)));
+			maxBetween = max(maxBetween, angleDifference(between[p], angleBetween2Lines(line1, line2)));
+		}
+	}
+	printf("%zu points\n", coords.size());
+	printf("largest difference: %.3g miles, angleOfLine %.3g degrees, angleBetween2Lines %.3g degrees\n", maxMiles, maxAngle, maxBetween);
+
+	// speed: 100 origins against every point, best of 5
+	const int ORIGINS = 100;
+	double sink = 0;
+	double scalarMiles = bestMs(5, [&]() {
+		for (int i = 0; i < ORIGINS; i++)
+		{
+			const GeoCoord &from = coords[i * 97 % coords.size()];
+			for (size_t p = 0; p < coords.size(); p++)
+				sink += distanceEarthMiles(from, coords[p]);
+		}
+	});
+	double batchMiles = bestMs(5, [&]() {
+		for (int i = 0; i < ORIGINS; i++)
+		{
+			distancesEarthMiles(GeoPoint(coords[i * 97 % coords.size()]), points, miles);
+			sink += miles[i];
+		}
+	});
+	double scalarAngle = bestMs(5, [&]() {
+		for (int i = 0; i < ORIGINS; i++)
+		{
+			const GeoCoord &from = coords[i * 97 % coords.size()];
+			for (size_t p = 0; p < coords.size(); p++)
+				sink += angleOfLine(GeoSegment(from, coords[p]));
+		}
+	});
+	double batchAngle = bestMs(5, [&]() {
+		for (int i = 0; i < ORIGINS; i++)
+		{
+			anglesOfLines(GeoPoint(coords[i * 97 % coords.size()]), points, angles);
+			sink += angles[i];
+		}
+	});
+	double perPoint = 1e6 / (double(ORIGINS) * coords.size()); // ms per batch to ns per point
+	printf("distanceEarthMiles  scalar %6.2f ns  batch %6.2f ns per point\n", scalarMiles * perPoint, batchMiles * perPoint);
+	printf("angleOfLine         scalar %6.2f ns  batch %6.2f ns per point\n", scalarAngle * perPoint, batchAngle * perPoint);
+	if (sink == 0) // keeps the compiler from dropping the loops
+		printf("\n");
+}
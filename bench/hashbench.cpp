@@ -0,0 +1,86 @@
+// compares MyMap and MyHashMap on the keys SegmentMapper and AttractionMapper index: the time to
+// build each from the map data, then the time per find for keys that are there and keys that aren't.
+//
+//   ./hashbench mapdata.txt
+
+#include "provided.h"
+#include "support.h"
+#include "MyMap.h"
+#include "MyHashMap.h"
+#include "bench/bench.h"
+#include <iostream>
+#include <random>
+#include <cctype>
+#include <cstdio>
+using namespace std;
+
+template<typename Map, typename KeyType, typename ValueType>
+static void compare(const char* what, const vector<KeyType> &keys, const vector<KeyType> &misses, const ValueType &value)
+{
+	vector<KeyType> hits(keys);
+	shuffle(hits.begin(), hits.end(), mt19937(5));
+	const int ROUNDS = 50;
+	size_t found = 0;
+	Map* map = nullptr;
+	double build = bestMs(5, [&]() {
+		delete map;
+		map = new Map;
+		for (size_t i = 0; i < keys.size(); i++)
+			map->associate(keys[i], value);
+	});
+	double hit = bestMs(3, [&]() {
+		for (int round = 0; round < ROUNDS; round++)
+			for (size_t i = 0; i < hits.size(); i++)
+				found += map->find(hits[i]) != nullptr;
+	});
+	double miss = bestMs(3, [&]() {
+		for (int round = 0; round < ROUNDS; round++)
+			for (size_t i = 0; i < misses.size(); i++)
+				found += map->find(misses[i]) != nullptr;
+	});
+	delete map;
+	printf("  %-10s build %6.2f ms  hit %5.0f ns  miss %5.0f ns\n", what, build,
+		hit * 1e6 / (double(ROUNDS) * hits.size()), miss * 1e6 / (double(ROUNDS) * misses.size()));
+	if (found == 0)
+		printf("\n");
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		cerr << "usage: hashbench mapfile" << endl;
+		return 1;
+	}
+	MapLoader ml;
+	if (!ml.load(argv[1]))
+	{
+		cerr << "can't load " << argv[1] << endl;
+		return 1;
+	}
+	// the misses are a ten-millionth of a degree north of a real coordinate, and names with a letter on the end
+	vector<CoordKey> coords, coordMisses;
+	vector<string> names, nameMisses;
+	for (const StreetSegment &seg : ml)
+	{
+		coords.push_back(CoordKey(seg.segment.start));
+		coords.push_back(CoordKey(seg.segment.end));
+		coordMisses.push_back(CoordKey(coords.back().latitudeE7() + 1, coords.back().longitudeE7()));
+		for (const Attraction &a : seg.attractions)
+		{
+			coords.push_back(CoordKey(a.geocoordinates));
+			string name = a.name;
+			for (size_t i = 0; i < name.size(); i++)
+				name[i] = tolower(name[i]);
+			names.push_back(name);
+			nameMisses.push_back(name + "x");
+		}
+	}
+
+	printf("coordinates (SegmentMapper), %zu keys\n", coords.size());
+	compare<MyMap<CoordKey, vector<size_t>>>("MyMap", coords, coordMisses, vector<size_t>(1, 0));
+	compare<MyHashMap<CoordKey, vector<size_t>>>("MyHashMap", coords, coordMisses, vector<size_t>(1, 0));
+	printf("names (AttractionMapper), %zu keys\n", names.size());
+	compare<MyMap<string, uint32_t>>("MyMap", names, nameMisses, 0u);
+	compare<MyHashMap<string, uint32_t, CaseInsensitiveHash>>("MyHashMap", names, nameMisses, 0u);
+}
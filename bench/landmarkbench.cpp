@@ -0,0 +1,112 @@
+// compares A* with the straight-line heuristic and A* with landmarks (ALT) over random pairs of
+// attractions: nodes settled and time per search, grouped by how long the route is, and how long
+// building the landmark tables takes. both have to find routes of the same length.
+//
+//   ./landmarkbench mapdata.txt [landmarks] [pairs]
+
+#include "provided.h"
+#include "support.h"
+#include "RoadGraph.h"
+#include "LandmarkTable.h"
+#include "RouteSearch.h"
+#include "bench/bench.h"
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+using namespace std;
+
+// how long the route through path is, taking the shortest edge between each pair of nodes on it
+static double routeLength(const RoadGraph &graph, const vector<RouteStep> &path)
+{
+	double length = 0;
+	for (size_t i = 1; i < path.size(); i++)
+	{
+		double step = HUGE_VAL;
+		for (const RoadEdge *edge = graph.edgesBegin(path[i - 1].node), *end = graph.edgesEnd(path[i - 1].node); edge != end; edge++)
+			if (edge->target == path[i].node)
+				step = min(step, edge->length);
+		length += step;
+	}
+	return length;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		cerr << "usage: landmarkbench mapfile [landmarks] [pairs]" << endl;
+		return 1;
+	}
+	size_t numLandmarks = argc > 2 ? atoi(argv[2]) : 16;
+	size_t numPairs = argc > 3 ? atoi(argv[3]) : 3000;
+	MapLoader ml;
+	if (!ml.load(argv[1]))
+	{
+		cerr << "can't load " << argv[1] << endl;
+		return 1;
+	}
+	SegmentMapper sm;
+	sm.init(ml);
+	RoadGraph graph;
+	graph.build(ml, sm);
+	LandmarkTable landmarks;
+	double buildMs = bestMs(1, [&]() { landmarks.build(graph, numLandmarks); });
+	printf("%zu landmarks: build %.1f ms, %.1f MB\n", landmarks.size(), buildMs, graph.getNumNodes() * landmarks.size() * sizeof(double) / 1e6);
+
+	vector<uint32_t> attractionNodes;
+	for (const StreetSegment &seg : ml)
+		for (const Attraction &a : seg.attractions)
+			attractionNodes.push_back(graph.findNode(CoordKey(a.geocoordinates)));
+
+	// by route length in miles, the last for pairs with no route at all
+	const int GROUPS = 5;
+	const char* groupNames[GROUPS] = { "0-1 mi", "1-3 mi", "3-6 mi", "6+ mi", "no route" };
+	double settled[GROUPS][2] = {}, micros[GROUPS][2] = {};
+	size_t counts[GROUPS] = {}, different = 0;
+	RouteSearch search;
+	vector<TargetStep> noSteps;
+	vector<RouteStep> path, landmarkPath;
+	mt19937 rng(5);
+	for (size_t p = 0; p < numPairs; p++)
+	{
+		uint32_t start = attractionNodes[rng() % attractionNodes.size()], target = attractionNodes[rng() % attractionNodes.size()];
+		vector<SearchSeed> seeds(1);
+		seeds[0].node = start;
+		seeds[0].distance = 0;
+		seeds[0].parent = RoadGraph::NO_NODE;
+		seeds[0].segment = RouteStep::NO_SEGMENT;
+		const GeoCoord &targetCoord = graph.getCoord(target);
+
+		bool found = false, landmarkFound = false;
+		double plainMs = bestMs(3, [&]() { found = search.shortestPath(graph, seeds, target, targetCoord, noSteps, path); });
+		size_t plainSettled = search.nodesSettled();
+		double landmarkMs = bestMs(3, [&]() {
+			landmarkFound = search.shortestPathLandmarks(graph, landmarks, seeds, target, targetCoord, noSteps, landmarkPath);
+		});
+		size_t landmarkSettled = search.nodesSettled();
+
+		double length = found ? routeLength(graph, path) : HUGE_VAL;
+		if (found != landmarkFound || (found && fabs(length - routeLength(graph, landmarkPath)) > 1e-9))
+			different++;
+		int group = !found ? 4 : length < 1 ? 0 : length < 3 ? 1 : length < 6 ? 2 : 3;
+		counts[group]++;
+		settled[group][0] += plainSettled;
+		settled[group][1] += landmarkSettled;
+		micros[group][0] += plainMs * 1e3;
+		micros[group][1] += landmarkMs * 1e3;
+	}
+
+	printf("%zu pairs, %zu where the two disagree\n", numPairs, different);
+	printf("route       pairs   nodes A*   nodes ALT   ratio   us A*   us ALT\n");
+	for (int group = 0; group < GROUPS; group++)
+	{
+		if (counts[group] == 0)
+			continue;
+		double n = double(counts[group]);
+		printf("%-10s %6zu %10.0f %11.0f %7.2f %7.0f %8.0f\n", groupNames[group], counts[group], settled[group][0] / n, settled[group][1] / n,
+			settled[group][1] / settled[group][0], micros[group][0] / n, micros[group][1] / n);
+	}
+	return different == 0 ? 0 : 1;
+}
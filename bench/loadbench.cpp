@@ -0,0 +1,65 @@
+// times MapLoader::load on text map data at every thread count from 1 up to twice the number of
+// cores, best of 10 each. with a copies argument the file is repeated that many times into a
+// temporary file first, since mapdata.txt alone only cuts into a handful of 256 KB chunks.
+//
+//   ./loadbench mapdata.txt 10
+
+#include "provided.h"
+#include "bench/bench.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+using namespace std;
+
+static double bestLoad(const string &mapFile, unsigned numThreads, size_t &numSegments)
+{
+	MapLoader ml;
+	ml.setLoadThreads(numThreads);
+	bool ok = true;
+	double ms = bestMs(10, [&]() { ok = ml.load(mapFile) && ok; });
+	numSegments = ml.getNumSegments();
+	return ok ? ms : -1;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		cerr << "usage: loadbench mapfile [copies]" << endl;
+		return 1;
+	}
+	string mapFile = argv[1];
+	int copies = argc > 2 ? atoi(argv[2]) : 1;
+	if (copies > 1)
+	{
+		ifstream in(mapFile, ios::binary);
+		stringstream text;
+		text << in.rdbuf();
+		mapFile = "loadbench.tmp";
+		ofstream out(mapFile, ios::binary);
+		for (int i = 0; i < copies; i++)
+			out << text.str();
+	}
+
+	unsigned cores = max(1u, thread::hardware_concurrency());
+	cout << cores << " cores" << endl;
+	double single = 0;
+	for (unsigned numThreads = 1; numThreads <= 2 * cores || numThreads <= 8; numThreads *= 2)
+	{
+		size_t numSegments = 0;
+		double ms = bestLoad(mapFile, numThreads, numSegments);
+		if (ms < 0)
+		{
+			cerr << "can't load " << mapFile << endl;
+			return 1;
+		}
+		if (numThreads == 1)
+			single = ms;
+		printf("threads %2u  %zu segments  %8.2f ms  speedup %.2f\n", numThreads, numSegments, ms, single / ms);
+	}
+	if (copies > 1)
+		remove(mapFile.c_str());
+}
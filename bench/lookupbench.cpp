@@ -0,0 +1,100 @@
+// lookups per second for attraction names: AttractionMapper::findGeoCoord (no copies at all),
+// AttractionMapper::getGeoCoord (copies the coordinate out), and a copy of the lookup
+// AttractionMapper used to do, which lowercased a copy of the name a character at a time, found
+// it in a MyMap and copied the coordinate out. the names are asked for in the case the map data
+// has them, and one in ten isn't an attraction at all.
+//
+//   ./lookupbench mapdata.txt
+
+#include "provided.h"
+#include "MyMap.h"
+#include "bench/bench.h"
+#include <iostream>
+#include <random>
+#include <cctype>
+#include <cstdio>
+using namespace std;
+
+class OldLookup
+{
+public:
+	void init(const MapLoader &ml)
+	{
+		for (const StreetSegment &seg : ml)
+			for (const Attraction &a : seg.attractions)
+				m_attractions.associate(stringToLowerCase(a.name), a.geocoordinates);
+	}
+	bool getGeoCoord(string attraction, GeoCoord &gc) const
+	{
+		const GeoCoord* found = m_attractions.find(stringToLowerCase(attraction));
+		if (found == nullptr)
+			return false;
+		gc = *found;
+		return true;
+	}
+private:
+	MyMap<string, GeoCoord> m_attractions;
+	static string stringToLowerCase(const string &toBeLowered)
+	{
+		string result;
+		for (size_t i = 0; i < toBeLowered.size(); i++)
+			result += tolower(toBeLowered[i]);
+		return result;
+	}
+};
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		cerr << "usage: lookupbench mapfile" << endl;
+		return 1;
+	}
+	MapLoader ml;
+	if (!ml.load(argv[1]))
+	{
+		cerr << "can't load " << argv[1] << endl;
+		return 1;
+	}
+	AttractionMapper am;
+	am.init(ml);
+	OldLookup old;
+	old.init(ml);
+
+	vector<string> names;
+	for (const StreetSegment &seg : ml)
+		for (const Attraction &a : seg.attractions)
+			names.push_back(a.name);
+	mt19937 rng(5);
+	vector<string> queries;
+	for (int i = 0; i < 100000; i++)
+	{
+		string name = names[rng() % names.size()];
+		if (i % 10 == 0)
+			name += " Annex";
+		queries.push_back(name);
+	}
+
+	size_t found = 0, foundOld = 0, foundCopied = 0;
+	GeoCoord gc;
+	double oldMs = bestMs(5, [&]() {
+		foundOld = 0;
+		for (size_t q = 0; q < queries.size(); q++)
+			foundOld += old.getGeoCoord(queries[q], gc);
+	});
+	double copiedMs = bestMs(5, [&]() {
+		foundCopied = 0;
+		for (size_t q = 0; q < queries.size(); q++)
+			foundCopied += am.getGeoCoord(queries[q], gc);
+	});
+	double findMs = bestMs(5, [&]() {
+		found = 0;
+		for (size_t q = 0; q < queries.size(); q++)
+			found += am.findGeoCoord(queries[q]) != nullptr;
+	});
+	printf("%zu queries, %zu found (old lookup %zu, getGeoCoord %zu)\n", queries.size(), found, foundOld, foundCopied);
+	printf("old lookup    %6.2f million/s\n", queries.size() / oldMs / 1e3);
+	printf("getGeoCoord   %6.2f million/s\n", queries.size() / copiedMs / 1e3);
+	printf("findGeoCoord  %6.2f million/s\n", queries.size() / findMs / 1e3);
+	return found == foundOld && found == foundCopied ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+// builds MyMap from the keys SegmentMapper and AttractionMapper index (every coordinate, every
+// lowercased attraction name, in the order the map data has them) and compares its height and
+// find time with the unbalanced tree MyMap used to be.
+//
+//   ./mapbench mapdata.txt
+
+#include "provided.h"
+#include "support.h"
+#include "MyMap.h"
+#include "bench/bench.h"
+#include <iostream>
+#include <random>
+#include <cctype>
+#include <cstdio>
+using namespace std;
+
+// the old MyMap: a plain binary search tree that takes whatever shape the insertion order gives it
+template<typename KeyType>
+class UnbalancedTree
+{
+public:
+	UnbalancedTree() : m_root(nullptr) {}
+	~UnbalancedTree()
+	{
+		// not recursive, since the trees this makes are deep enough to overflow the stack
+		vector<Node*> pending;
+		if (m_root != nullptr)
+			pending.push_back(m_root);
+		while (!pending.empty())
+		{
+			Node* node = pending.back();
+			pending.pop_back();
+			if (node->left != nullptr)
+				pending.push_back(node->left);
+			if (node->right != nullptr)
+				pending.push_back(node->right);
+			delete node;
+		}
+	}
+	void associate(const KeyType& key)
+	{
+		Node** link = &m_root;
+		while (*link != nullptr)
+		{
+			if ((*link)->key < key)
+				link = &(*link)->right;
+			else if (key < (*link)->key)
+				link = &(*link)->left;
+			else
+				return;
+		}
+		*link = new Node(key);
+	}
+	bool find(const KeyType& key) const
+	{
+		const Node* current = m_root;
+		while (current != nullptr)
+		{
+			if (current->key < key)
+				current = current->right;
+			else if (key < current->key)
+				current = current->left;
+			else
+				return true;
+		}
+		return false;
+	}
+	// the deepest node and the average depth of a node, counting the root as 1
+	void depths(int &deepest, double &average) const
+	{
+		vector<pair<const Node*, int>> pending;
+		if (m_root != nullptr)
+			pending.push_back(make_pair(m_root, 1));
+		long long total = 0, count = 0;
+		deepest = 0;
+		while (!pending.empty())
+		{
+			const Node* node = pending.back().first;
+			int depth = pending.back().second;
+			pending.pop_back();
+			deepest = max(deepest, depth);
+			total += depth;
+			count++;
+			if (node->left != nullptr)
+				pending.push_back(make_pair(node->left, depth + 1));
+			if (node->right != nullptr)
+				pending.push_back(make_pair(node->right, depth + 1));
+		}
+		average = count == 0 ? 0 : double(total) / count;
+	}
+	UnbalancedTree(const UnbalancedTree&) = delete;
+	UnbalancedTree& operator=(const UnbalancedTree&) = delete;
+private:
+	struct Node
+	{
+		Node(const KeyType& k) : key(k), left(nullptr), right(nullptr) {}
+		KeyType key;
+		Node *left, *right;
+	};
+	Node* m_root;
+};
+
+template<typename KeyType>
+static void compare(const char* what, const vector<KeyType> &keys)
+{
+	vector<KeyType> probes(keys);
+	shuffle(probes.begin(), probes.end(), mt19937(5));
+	const int ROUNDS = 20;
+	size_t found = 0;
+
+	MyMap<KeyType, int> balanced;
+	double balancedBuild = bestMs(1, [&]() {
+		for (size_t i = 0; i < keys.size(); i++)
+			balanced.associate(keys[i], 0);
+	});
+	double balancedFind = bestMs(3, [&]() {
+		for (int round = 0; round < ROUNDS; round++)
+			for (size_t i = 0; i < probes.size(); i++)
+				found += balanced.find(probes[i]) != nullptr;
+	});
+
+	UnbalancedTree<KeyType> unbalanced;
+	double unbalancedBuild = bestMs(1, [&]() {
+		for (size_t i = 0; i < keys.size(); i++)
+			unbalanced.associate(keys[i]);
+	});
+	double unbalancedFind = bestMs(3, [&]() {
+		for (int round = 0; round < ROUNDS; round++)
+			for (size_t i = 0; i < probes.size(); i++)
+				found += unbalanced.find(probes[i]);
+	});
+	int deepest;
+	double average;
+	unbalanced.depths(deepest, average);
+
+	double perFind = 1e6 / (double(ROUNDS) * probes.size()); // ms per round to ns per find
+	printf("%s: %zu keys, %d distinct\n", what, keys.size(), balanced.size());
+	printf("  unbalanced  height %5d (average depth %7.1f)  build %7.2f ms  find %6.0f ns\n", deepest, average, unbalancedBuild, unbalancedFind * perFind);
+	printf("  MyMap       height %5d                          build %7.2f ms  find %6.0f ns\n", balanced.height(), balancedBuild, balancedFind * perFind);
+	if (found == 0)
+		printf("\n");
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		cerr << "usage: mapbench mapfile" << endl;
+		return 1;
+	}
+	MapLoader ml;
+	if (!ml.load(argv[1]))
+	{
+		cerr << "can't load " << argv[1] << endl;
+		return 1;
+	}
+	vector<CoordKey> coords;
+	vector<string> names;
+	for (const StreetSegment &seg : ml)
+	{
+		coords.push_back(CoordKey(seg.segment.start));
+		coords.push_back(CoordKey(seg.segment.end));
+		for (const Attraction &a : seg.attractions)
+		{
+			coords.push_back(CoordKey(a.geocoordinates));
+			string name = a.name;
+			for (size_t i = 0; i < name.size(); i++)
+				name[i] = tolower(name[i]);
+			names.push_back(name);
+		}
+	}
+	compare("coordinates (SegmentMapper)", coords);
+	compare("names (AttractionMapper)", names);
+}
@@ -0,0 +1,151 @@
+// times the k = 10 nearest attraction queries: SpatialIndex::nearestAttractions as the crow flies,
+// against sorting every attraction by distanceEarthMiles, and Navigator::nearestAttractions by road.
+// both have to find the same distances as doing it the slow way: for by road, that's navigating to
+// every attraction from the first few query points and sorting by the length of the route.
+//
+//   ./nearbench mapdata.txt [queries]
+
+#include "provided.h"
+#include "support.h"
+#include "SpatialIndex.h"
+#include "bench/bench.h"
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+using namespace std;
+
+const size_t K = 10;
+
+// the distances of the k closest of distances, closest first
+static void closest(vector<double> &distances, size_t k)
+{
+	k = min(k, distances.size());
+	partial_sort(distances.begin(), distances.begin() + k, distances.end());
+	distances.resize(k);
+}
+
+// whether found has the same distances as expected, give or take rounding. which of two attractions
+// exactly as far away comes first is up to the query, so only the distances are compared
+static bool sameDistances(const vector<NearbyAttraction> &found, const vector<double> &expected)
+{
+	if (found.size() != expected.size())
+		return false;
+	for (size_t i = 0; i < found.size(); i++)
+		if (fabs(found[i].distance - expected[i]) > 1e-9 * max(1.0, expected[i]))
+			return false;
+	return true;
+}
+
+static double routeMiles(const vector<NavSegment> &directions)
+{
+	double miles = 0;
+	for (const NavSegment &step : directions)
+		if (step.m_command == NavSegment::PROCEED)
+			miles += step.m_distance;
+	return miles;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		cerr << "usage: nearbench mapfile [queries]" << endl;
+		return 1;
+	}
+	size_t numQueries = argc > 2 ? strtoul(argv[2], nullptr, 10) : 2000;
+	const size_t ROUTED = 20; // query points that by road is checked from, navigating to every attraction
+	MapLoader ml;
+	Navigator nav;
+	if (!ml.load(argv[1]) || !nav.loadMapData(argv[1]) || ml.getNumSegments() == 0)
+	{
+		cerr << "can't load " << argv[1] << endl;
+		return 1;
+	}
+	SpatialIndex index;
+	index.build(ml);
+
+	// every attraction once, however many segments list it, like the index keeps them
+	vector<Attraction> attractions;
+	vector<pair<unsigned, CoordKey>> seen;
+	for (const StreetSegment &seg : ml)
+	{
+		for (const Attraction &a : seg.attractions)
+		{
+			pair<unsigned, CoordKey> key(a.name.id(), CoordKey(a.geocoordinates));
+			if (find(seen.begin(), seen.end(), key) != seen.end())
+				continue;
+			seen.push_back(key);
+			attractions.push_back(a);
+		}
+	}
+
+	// query points are segment starts picked at random and moved up to about 50 m each way
+	mt19937 rng(5);
+	uniform_real_distribution<double> jitter(-0.0005, 0.0005);
+	vector<GeoCoord> queries;
+	for (size_t i = 0; i < numQueries; i++)
+	{
+		const GeoCoord &start = ml.getSegment(rng() % ml.getNumSegments())->segment.start;
+		GeoCoord gc; // the queries only look at the numbers
+		gc.latitude = start.latitude + jitter(rng);
+		gc.longitude = start.longitude + jitter(rng);
+		queries.push_back(gc);
+	}
+
+	vector<NearbyAttraction> nearby;
+	vector<double> distances;
+	size_t straightWrong = 0, roadWrong = 0;
+	for (const GeoCoord &gc : queries)
+	{
+		index.nearestAttractions(gc, K, nearby);
+		distances.clear();
+		for (const Attraction &a : attractions)
+			distances.push_back(distanceEarthMiles(gc, a.geocoordinates));
+		closest(distances, K);
+		straightWrong += !sameDistances(nearby, distances);
+	}
+	size_t routed = min(ROUTED, queries.size());
+	vector<NavSegment> directions;
+	for (size_t q = 0; q < routed; q++)
+	{
+		distances.clear();
+		for (const Attraction &a : attractions)
+			if (nav.navigate(queries[q], a.geocoordinates, directions) == NAV_SUCCESS)
+				distances.push_back(routeMiles(directions));
+		closest(distances, K);
+		roadWrong += !sameDistances(nav.nearestAttractions(queries[q], K, true), distances);
+	}
+
+	double sink = 0;
+	double indexMs = bestMs(5, [&]() {
+		for (const GeoCoord &gc : queries)
+		{
+			index.nearestAttractions(gc, K, nearby);
+			sink += nearby.empty() ? 0 : nearby.back().distance;
+		}
+	});
+	double sortMs = bestMs(3, [&]() {
+		for (const GeoCoord &gc : queries)
+		{
+			distances.clear();
+			for (const Attraction &a : attractions)
+				distances.push_back(distanceEarthMiles(gc, a.geocoordinates));
+			closest(distances, K);
+			sink += distances.empty() ? 0 : distances.back();
+		}
+	});
+	double roadMs = bestMs(3, [&]() {
+		for (const GeoCoord &gc : queries)
+			sink += nav.nearestAttractions(gc, K, true).size();
+	});
+	double perQuery = 1e3 / queries.size(); // ms for all of them to us for one
+	printf("%zu attractions, k = %zu, %zu queries\n", attractions.size(), K, queries.size());
+	printf("  straight line  index %8.1f us  sort %8.1f us  %zu of %zu disagree\n",
+		indexMs * perQuery, sortMs * perQuery, straightWrong, queries.size());
+	printf("  by road        search %7.1f us  %zu of %zu checked by navigating disagree\n", roadMs * perQuery, roadWrong, routed);
+	if (sink == 0) // keeps the compiler from dropping the loops
+		printf("\n");
+	return straightWrong + roadWrong == 0 ? 0 : 1;
+}
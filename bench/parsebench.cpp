@@ -0,0 +1,149 @@
+// times MapLoader::load (one thread) against the stream parser it replaced, and checks the two
+// come up with the same segments.
+//
+//   ./parsebench mapdata.txt
+
+#include "provided.h"
+#include "bench/bench.h"
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+using namespace std;
+
+// the original parser, one character at a time from an ifstream. the only change is that it
+// appends segments instead of stopping at 20000
+static bool streamLoad(string mapFile, vector<StreetSegment> &segmentVector)
+{
+	segmentVector.clear();
+	ifstream loader(mapFile);
+	if (!loader)
+		return false;
+	string input, streetName, attractionName;
+	int numAttractions = 0;
+	string latitude, longitude;
+	while (getline(loader, input))
+	{
+		StreetSegment seg;
+		seg.streetName = input;
+		char ch;
+
+		latitude = longitude = "";
+		loader.get(ch);
+		while (ch != ',')
+		{
+			latitude += ch;
+			loader.get(ch);
+		}
+		loader.get(ch);
+		while (ch == ' ')
+			loader.get(ch);
+		while (ch != ' ')
+		{
+			longitude += ch;
+			loader.get(ch);
+		}
+		seg.segment.start = GeoCoord(latitude, longitude);
+
+		latitude = longitude = "";
+		loader.get(ch);
+		while (ch != ',')
+		{
+			latitude += ch;
+			loader.get(ch);
+		}
+		loader.get(ch);
+		while (ch == ' ')
+			loader.get(ch);
+		while (ch != '\n')
+		{
+			longitude += ch;
+			loader.get(ch);
+		}
+		seg.segment.end = GeoCoord(latitude, longitude);
+
+		loader >> numAttractions;
+		loader.ignore(10000, '\n');
+		for (int i = 0; i < numAttractions; i++)
+		{
+			loader.get(ch);
+			attractionName = "";
+			while (ch != '|')
+			{
+				attractionName += ch;
+				loader.get(ch);
+			}
+			latitude = longitude = "";
+			loader.get(ch);
+			while (ch != ',')
+			{
+				latitude += ch;
+				loader.get(ch);
+			}
+			loader.get(ch);
+			while (ch == ' ')
+				loader.get(ch);
+			while (ch != '\n')
+			{
+				longitude += ch;
+				loader.get(ch);
+			}
+			Attraction a;
+			a.name = attractionName;
+			a.geocoordinates = GeoCoord(latitude, longitude);
+			seg.attractions.push_back(a);
+		}
+		segmentVector.push_back(seg);
+	}
+	return true;
+}
+
+static bool sameCoord(const GeoCoord &a, const GeoCoord &b)
+{
+	return a.latitudeText == b.latitudeText && a.longitudeText == b.longitudeText && a.latitude == b.latitude && a.longitude == b.longitude;
+}
+
+static bool sameSegment(const StreetSegment &a, const StreetSegment &b)
+{
+	if (a.streetName != b.streetName || !sameCoord(a.segment.start, b.segment.start) || !sameCoord(a.segment.end, b.segment.end) ||
+		a.attractions.size() != b.attractions.size())
+		return false;
+	for (size_t i = 0; i < a.attractions.size(); i++)
+		if (a.attractions[i].name != b.attractions[i].name || !sameCoord(a.attractions[i].geocoordinates, b.attractions[i].geocoordinates))
+			return false;
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		cerr << "usage: parsebench mapfile" << endl;
+		return 1;
+	}
+	string mapFile = argv[1];
+
+	vector<StreetSegment> streamed;
+	MapLoader ml;
+	ml.setLoadThreads(1);
+	bool ok = true;
+	double streamMs = bestMs(10, [&]() { ok = streamLoad(mapFile, streamed) && ok; });
+	double mappedMs = bestMs(10, [&]() { ok = ml.load(mapFile) && ok; });
+	if (!ok)
+	{
+		cerr << "can't load " << mapFile << endl;
+		return 1;
+	}
+
+	size_t different = streamed.size() == ml.getNumSegments() ? 0 : 1;
+	for (size_t segNum = 0; segNum < streamed.size() && segNum < ml.getNumSegments(); segNum++)
+	{
+		StreetSegment seg;
+		ml.getSegment(segNum, seg);
+		if (!sameSegment(streamed[segNum], seg))
+			different++;
+	}
+	printf("%zu segments, %zu different\n", streamed.size(), different);
+	printf("stream parser  %8.2f ms\n", streamMs);
+	printf("mapped parser  %8.2f ms\n", mappedMs);
+	return different == 0 ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+// times SpatialIndex's box and radius queries against scanning every segment with MapLoader,
+// the way they had to be answered before, at a few query sizes. both have to find the same
+// segments and attractions.
+//
+//   ./querybench mapdata.txt
+
+#include "provided.h"
+#include "support.h"
+#include "SpatialIndex.h"
+#include "bench/bench.h"
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <cstdio>
+using namespace std;
+
+// the same tests SpatialIndex makes, but on every segment: the segment clipped to the box, and
+// the distance to it with longitude shrunk by the cosine of the center's latitude
+static bool crossesBox(const GeoSegment &seg, const PackedRTree::Box &box)
+{
+	double lat1 = seg.start.latitude, lon1 = seg.start.longitude;
+	double dLat = seg.end.latitude - lat1, dLon = seg.end.longitude - lon1;
+	const double step[4] = { -dLat, dLat, -dLon, dLon };
+	const double room[4] = { lat1 - box.minLatitude, box.maxLatitude - lat1, lon1 - box.minLongitude, box.maxLongitude - lon1 };
+	double t0 = 0, t1 = 1;
+	for (int side = 0; side < 4; side++)
+	{
+		if (step[side] == 0)
+		{
+			if (room[side] < 0)
+				return false;
+			continue;
+		}
+		double t = room[side] / step[side];
+		if (step[side] < 0)
+			t0 = max(t0, t);
+		else
+			t1 = min(t1, t);
+		if (t0 > t1)
+			return false;
+	}
+	return true;
+}
+
+static double distance2(const GeoSegment &seg, const GeoCoord &center, double xScale)
+{
+	double dLat = seg.end.latitude - seg.start.latitude, dLon = (seg.end.longitude - seg.start.longitude) * xScale;
+	double pLat = center.latitude - seg.start.latitude, pLon = (center.longitude - seg.start.longitude) * xScale;
+	double length2 = dLat * dLat + dLon * dLon;
+	double t = length2 > 0 ? (pLat * dLat + pLon * dLon) / length2 : 0;
+	t = t < 0 ? 0 : t > 1 ? 1 : t;
+	double eLat = pLat - t * dLat, eLon = pLon - t * dLon;
+	return eLat * eLat + eLon * eLon;
+}
+
+static bool inBox(const GeoCoord &gc, const PackedRTree::Box &box)
+{
+	return gc.latitude >= box.minLatitude && gc.latitude <= box.maxLatitude && gc.longitude >= box.minLongitude && gc.longitude <= box.maxLongitude;
+}
+
+// an attraction listed on several segments is found once, like SpatialIndex finds it
+static void addAttraction(const Attraction &a, vector<pair<unsigned, CoordKey>> &found)
+{
+	pair<unsigned, CoordKey> key(a.name.id(), CoordKey(a.geocoordinates));
+	if (find(found.begin(), found.end(), key) == found.end())
+		found.push_back(key);
+}
+
+static void scanBox(const MapLoader &ml, const PackedRTree::Box &box, vector<size_t> &segments, vector<pair<unsigned, CoordKey>> &attractions)
+{
+	segments.clear();
+	attractions.clear();
+	for (size_t segNum = 0; segNum < ml.getNumSegments(); segNum++)
+	{
+		const StreetSegment &seg = *ml.getSegment(segNum);
+		if (crossesBox(seg.segment, box))
+			segments.push_back(segNum);
+		for (const Attraction &a : seg.attractions)
+			if (inBox(a.geocoordinates, box))
+				addAttraction(a, attractions);
+	}
+}
+
+static void scanWithin(const MapLoader &ml, const GeoCoord &center, double miles, vector<size_t> &segments, vector<pair<unsigned, CoordKey>> &attractions)
+{
+	segments.clear();
+	attractions.clear();
+	double radius = rad2deg(miles / (6371.0 * 0.621371));
+	double xScale = max(cos(deg2rad(center.latitude)), 1e-9);
+	for (size_t segNum = 0; segNum < ml.getNumSegments(); segNum++)
+	{
+		const StreetSegment &seg = *ml.getSegment(segNum);
+		if (distance2(seg.segment, center, xScale) <= radius * radius)
+			segments.push_back(segNum);
+		for (const Attraction &a : seg.attractions)
+		{
+			double dLat = a.geocoordinates.latitude - center.latitude, dLon = (a.geocoordinates.longitude - center.longitude) * xScale;
+			if (dLat * dLat + dLon * dLon <= radius * radius)
+				addAttraction(a, attractions);
+		}
+	}
+}
+
+static bool sameSegments(vector<size_t> a, vector<size_t> b)
+{
+	sort(a.begin(), a.end());
+	sort(b.begin(), b.end());
+	return a == b;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		cerr << "usage: querybench mapfile" << endl;
+		return 1;
+	}
+	MapLoader ml;
+	if (!ml.load(argv[1]))
+	{
+		cerr << "can't load " << argv[1] << endl;
+		return 1;
+	}
+	SpatialIndex index;
+	index.build(ml);
+
+	// query centers are segment starts picked at random, so every query is somewhere on the map
+	mt19937 rng(5);
+	vector<GeoCoord> centers;
+	for (int i = 0; i < 200; i++)
+		centers.push_back(ml.getSegment(rng() % ml.getNumSegments())->segment.start);
+
+	const double SIZES[] = { 0.1, 0.5, 2.0 }; // miles: half the side of a box, or a radius
+	size_t wrong = 0;
+	for (double miles : SIZES)
+	{
+		vector<PackedRTree::Box> boxes;
+		for (const GeoCoord &c : centers)
+		{
+			double dLat = rad2deg(miles / (6371.0 * 0.621371)), dLon = dLat / cos(deg2rad(c.latitude));
+			PackedRTree::Box box = { c.latitude - dLat, c.longitude - dLon, c.latitude + dLat, c.longitude + dLon };
+			boxes.push_back(box);
+		}
+
+		vector<size_t> segments, scannedSegments;
+		vector<Attraction> attractions;
+		vector<pair<unsigned, CoordKey>> scannedAttractions;
+		size_t numSegments = 0, numAttractions = 0;
+		for (size_t q = 0; q < centers.size(); q++)
+		{
+			index.segmentsInBox(boxes[q], segments);
+			index.attractionsInBox(boxes[q], attractions);
+			scanBox(ml, boxes[q], scannedSegments, scannedAttractions);
+			wrong += !sameSegments(segments, scannedSegments) || attractions.size() != scannedAttractions.size();
+			numSegments += segments.size();
+			numAttractions += attractions.size();
+			index.segmentsWithin(centers[q], miles, segments);
+			index.attractionsWithin(centers[q], miles, attractions);
+			scanWithin(ml, centers[q], miles, scannedSegments, scannedAttractions);
+			wrong += !sameSegments(segments, scannedSegments) || attractions.size() != scannedAttractions.size();
+		}
+
+		double boxIndex = bestMs(5, [&]() {
+			for (size_t q = 0; q < boxes.size(); q++)
+			{
+				index.segmentsInBox(boxes[q], segments);
+				index.attractionsInBox(boxes[q], attractions);
+			}
+		});
+		double boxScan = bestMs(3, [&]() {
+			for (size_t q = 0; q < boxes.size(); q++)
+				scanBox(ml, boxes[q], scannedSegments, scannedAttractions);
+		});
+		double withinIndex = bestMs(5, [&]() {
+			for (size_t q = 0; q < centers.size(); q++)
+			{
+				index.segmentsWithin(centers[q], miles, segments);
+				index.attractionsWithin(centers[q], miles, attractions);
+			}
+		});
+		double withinScan = bestMs(3, [&]() {
+			for (size_t q = 0; q < centers.size(); q++)
+				scanWithin(ml, centers[q], miles, scannedSegments, scannedAttractions);
+		});
+		double perQuery = 1e3 / centers.size(); // ms for all of them to us for one
+		printf("%.1f miles: %.0f segments, %.1f attractions per box\n", miles, double(numSegments) / centers.size(), double(numAttractions) / centers.size());
+		printf("  box     index %8.1f us  scan %8.1f us\n", boxIndex * perQuery, boxScan * perQuery);
+		printf("  radius  index %8.1f us  scan %8.1f us\n", withinIndex * perQuery, withinScan * perQuery);
+	}
+	printf("%zu queries where the index and the scan disagree\n", wrong);
+	return wrong == 0 ? 0 : 1;
+}
@@ -0,0 +1,52 @@
+// navigate latency over random pairs of attractions, by name: the mean, median and 90th
+// percentile of each pair's best time over a few rounds. it uses nothing but MapLoader and
+// Navigator::navigate, so building it against an older checkout measures that tree the same way.
+//
+//   ./routebench mapdata.txt [pairs]
+
+#include "provided.h"
+#include "bench/bench.h"
+#include <iostream>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		cerr << "usage: routebench mapfile [pairs]" << endl;
+		return 1;
+	}
+	size_t numPairs = argc > 2 ? atoi(argv[2]) : 300;
+	MapLoader ml;
+	Navigator nav;
+	if (!ml.load(argv[1]) || !nav.loadMapData(argv[1]))
+	{
+		cerr << "can't load " << argv[1] << endl;
+		return 1;
+	}
+	vector<string> names;
+	StreetSegment seg;
+	for (size_t segNum = 0; segNum < ml.getNumSegments(); segNum++)
+		if (ml.getSegment(segNum, seg))
+			for (size_t i = 0; i < seg.attractions.size(); i++)
+				names.push_back(seg.attractions[i].name);
+
+	mt19937 rng(7);
+	vector<double> took;
+	size_t routed = 0;
+	vector<NavSegment> directions;
+	for (size_t p = 0; p < numPairs; p++)
+	{
+		const string &start = names[rng() % names.size()], &end = names[rng() % names.size()];
+		took.push_back(bestMs(5, [&]() { routed += nav.navigate(start, end, directions) == NAV_SUCCESS; }));
+	}
+	double total = 0;
+	for (size_t p = 0; p < took.size(); p++)
+		total += took[p];
+	sort(took.begin(), took.end());
+	printf("%zu pairs, %zu routed\n", numPairs, routed / 5);
+	printf("mean %.3f ms  median %.3f ms  p90 %.3f ms\n", total / took.size(), took[took.size() / 2], took[took.size() * 9 / 10]);
+}
@@ -0,0 +1,130 @@
+// times SpatialIndex::nearestSegment, which navigate snaps coordinates with, on two sets of
+// coordinates: ones close to a street, the way a user's position usually is, and ones spread evenly
+// over the map's bounding box with a tenth of them well off it, which have to fall back to the tree.
+// a sample of each is checked against scanning every segment with MapLoader.
+//
+//   ./snapbench mapdata.txt [queries]
+
+#include "provided.h"
+#include "support.h"
+#include "SpatialIndex.h"
+#include "bench/bench.h"
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+using namespace std;
+
+// the segment scanning finds closest, with the distance SpatialIndex measures: longitude shrunk by
+// the cosine of the query's latitude. ties go to the lower segment number, as they do in the index
+static size_t scanNearest(const MapLoader &ml, const GeoCoord &gc)
+{
+	double xScale = cos(deg2rad(gc.latitude));
+	double best = HUGE_VAL;
+	size_t nearest = 0;
+	for (size_t segNum = 0; segNum < ml.getNumSegments(); segNum++)
+	{
+		const GeoSegment &seg = ml.getSegment(segNum)->segment;
+		double dLat = seg.end.latitude - seg.start.latitude, dLon = (seg.end.longitude - seg.start.longitude) * xScale;
+		double pLat = gc.latitude - seg.start.latitude, pLon = (gc.longitude - seg.start.longitude) * xScale;
+		double length2 = dLat * dLat + dLon * dLon;
+		double t = length2 > 0 ? (pLat * dLat + pLon * dLon) / length2 : 0;
+		t = t < 0 ? 0 : t > 1 ? 1 : t;
+		double eLat = pLat - t * dLat, eLon = pLon - t * dLon;
+		double d = eLat * eLat + eLon * eLon;
+		if (d < best)
+		{
+			best = d;
+			nearest = segNum;
+		}
+	}
+	return nearest;
+}
+
+static GeoCoord at(double latitude, double longitude)
+{
+	GeoCoord gc; // nearestSegment only looks at the numbers
+	gc.latitude = latitude;
+	gc.longitude = longitude;
+	return gc;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		cerr << "usage: snapbench mapfile [queries]" << endl;
+		return 1;
+	}
+	size_t numQueries = argc > 2 ? strtoul(argv[2], nullptr, 10) : 200000;
+	const size_t CHECKED = 2000; // queries per set that are also scanned for
+	MapLoader ml;
+	if (!ml.load(argv[1]) || ml.getNumSegments() == 0)
+	{
+		cerr << "can't load " << argv[1] << endl;
+		return 1;
+	}
+	SpatialIndex index;
+	double buildMs = bestMs(1, [&]() { index.build(ml); });
+
+	double minLat = HUGE_VAL, maxLat = -HUGE_VAL, minLon = HUGE_VAL, maxLon = -HUGE_VAL;
+	for (const StreetSegment &seg : ml)
+	{
+		for (const GeoCoord* gc : { &seg.segment.start, &seg.segment.end })
+		{
+			minLat = min(minLat, gc->latitude);
+			maxLat = max(maxLat, gc->latitude);
+			minLon = min(minLon, gc->longitude);
+			maxLon = max(maxLon, gc->longitude);
+		}
+	}
+
+	// near streets: segment starts picked at random and moved up to about 50 m each way.
+	// uniform: anywhere in the bounding box, and every tenth one up to 0.3 degrees past it
+	mt19937 rng(5);
+	uniform_real_distribution<double> jitter(-0.0005, 0.0005);
+	vector<GeoCoord> nearStreets, uniform;
+	for (size_t i = 0; i < numQueries; i++)
+	{
+		const GeoCoord &start = ml.getSegment(rng() % ml.getNumSegments())->segment.start;
+		nearStreets.push_back(at(start.latitude + jitter(rng), start.longitude + jitter(rng)));
+		double margin = i % 10 == 0 ? 0.3 : 0;
+		uniform_real_distribution<double> lat(minLat - margin, maxLat + margin), lon(minLon - margin, maxLon + margin);
+		uniform.push_back(at(lat(rng), lon(rng)));
+	}
+
+	printf("%zu segments, index built in %.1f ms\n", ml.getNumSegments(), buildMs);
+	struct QuerySet { const char* name; const vector<GeoCoord>* queries; };
+	const QuerySet SETS[] = { { "near streets", &nearStreets }, { "uniform, 10% off the map", &uniform } };
+	size_t wrong = 0;
+	double sink = 0;
+	for (const QuerySet &set : SETS)
+	{
+		const vector<GeoCoord> &queries = *set.queries;
+		size_t checked = min(CHECKED, queries.size()), mismatches = 0;
+		SegmentSnap snap;
+		for (size_t q = 0; q < checked; q++)
+			if (!index.nearestSegment(queries[q], snap) || snap.segment != scanNearest(ml, queries[q]))
+				mismatches++;
+		wrong += mismatches;
+
+		double indexMs = bestMs(5, [&]() {
+			for (const GeoCoord &gc : queries)
+			{
+				index.nearestSegment(gc, snap);
+				sink += snap.distance;
+			}
+		});
+		double scanMs = bestMs(1, [&]() {
+			for (size_t q = 0; q < checked; q++)
+				sink += scanNearest(ml, queries[q]);
+		});
+		printf("%-26s index %8.3f us  scan %8.1f us  %zu of %zu checked disagree\n", set.name,
+			indexMs * 1e3 / queries.size(), checked > 0 ? scanMs * 1e3 / checked : 0.0, mismatches, checked);
+	}
+	printf("%zu queries where the index and the scan disagree\n", wrong);
+	if (sink == 0) // keeps the compiler from dropping the loops
+		printf("\n");
+	return wrong == 0 ? 0 : 1;
+}
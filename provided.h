@@ -3,6 +3,29 @@
 
 #include <string>
 #include <vector>
+#include <iosfwd>
+
+// Street and attraction names repeat a lot (one street is usually many segments), so every distinct
+// name is stored once in a process wide table and everything else just holds its id. A Name turns
+// back into a const std::string& wherever the text is needed, and comparing two Names only compares ids.
+class Name
+{
+public:
+	Name() : m_id(0) {} // the empty name
+	Name(const std::string& text);
+	Name(const char* text);
+	Name(const char* text, size_t length);
+	const std::string& str() const;
+	operator const std::string&() const { return str(); }
+	unsigned id() const { return m_id; }
+	bool empty() const { return m_id == 0; }
+	bool operator==(const Name& other) const { return m_id == other.m_id; }
+	bool operator!=(const Name& other) const { return m_id != other.m_id; }
+private:
+	unsigned m_id;
+};
+
+std::ostream& operator<<(std::ostream& os, const Name& name);
 
 struct GeoCoord
 {
@@ -35,27 +58,94 @@ struct GeoSegment
 
 struct Attraction
 {
-	std::string name;
+	Name		name;
 	GeoCoord	geocoordinates;
 };
 
 struct StreetSegment
 {
-	std::string				streetName;
+	Name					streetName;
 	GeoSegment				segment;
 	std::vector<Attraction>	attractions;
 };
 
+// one edit read from a map patch file (the format is described in MapLoader.cpp)
+struct MapPatchOp
+{
+	enum OpType { ADD_SEGMENT, REMOVE_SEGMENT, ADD_ATTRACTION, REMOVE_ATTRACTION };
+
+	OpType			type;
+	StreetSegment	segment;	// the segment to add, or the street name and endpoints of the one to change
+	Attraction		attraction;	// the attraction to add or remove (removing only needs the name)
+};
+
+// one thing applying a patch op did to the loader's segments. the mappers replay these to keep
+// their indexes up to date without looking at the rest of the map
+struct MapChange
+{
+	enum ChangeType { SEGMENT_ADDED, SEGMENT_REMOVED, SEGMENT_MOVED, ATTRACTION_ADDED, ATTRACTION_REMOVED };
+
+	ChangeType		type;
+	size_t			segNum;		// the segment number that changed
+	size_t			fromSegNum;	// for SEGMENT_MOVED, the number the segment used to have
+	StreetSegment	segment;	// the segment that was added, removed or moved (or had an attraction change)
+	Attraction		attraction;	// for ATTRACTION_ADDED and ATTRACTION_REMOVED
+};
+
 class MapLoaderImpl;
+class MapSnapshot;
 
 class MapLoader
 {
 public:
 	MapLoader();
 	~MapLoader();
-	bool load(std::string mapFile);
+	bool load(std::string mapFile); // accepts either map data text or a compiled snapshot
+	// makes this loader a copy of other's map that can be patched without changing other. the
+	// segments are shared rather than copied (they never change once loaded, patches replace
+	// them), so this costs about as much as the patches other has had, not the map
+	void loadFrom(const MapLoader& other);
+	// how many of the segments are patched ones rather than loaded ones
+	size_t getNumPatched() const;
+	// stops sharing anything with the loader this one was loaded from, by copying every segment
+	// into a map of its own, as though it had been loaded that way. costs as much as a load
+	void compact();
+	// how many threads load() parses text map data with. 0 (the default) means one per core
+	void setLoadThreads(unsigned numThreads);
 	size_t getNumSegments() const;
 	bool getSegment(size_t segNum, StreetSegment& seg) const;
+	// read-only access without copying. returns nullptr if segNum is out of range. the pointer is
+	// good until the loader is destroyed, loads again or is patched
+	const StreetSegment* getSegment(size_t segNum) const;
+	// lets every segment be visited in order with for (const StreetSegment& seg : loader)
+	class const_iterator
+	{
+	public:
+		const_iterator(const MapLoader* loader, size_t segNum) : m_loader(loader), m_segNum(segNum) {}
+		const StreetSegment& operator*() const { return *m_loader->getSegment(m_segNum); }
+		const StreetSegment* operator->() const { return m_loader->getSegment(m_segNum); }
+		const_iterator& operator++() { m_segNum++; return *this; }
+		bool operator==(const const_iterator& other) const { return m_segNum == other.m_segNum; }
+		bool operator!=(const const_iterator& other) const { return m_segNum != other.m_segNum; }
+	private:
+		const MapLoader* m_loader;
+		size_t m_segNum;
+	};
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, getNumSegments()); }
+	// writes the loaded map, plus SegmentMapper's index and the road graph and spatial index
+	// Navigator would build, to a binary snapshot file. AttractionMapper still builds its name
+	// tables when the snapshot is loaded. tools/mapcompile.cpp is the compile step around this:
+	// mapcompile mapdata.txt map.snapshot, then load map.snapshot wherever mapdata.txt was loaded
+	bool saveSnapshot(std::string snapshotFile) const;
+	// the snapshot this map was loaded from, or nullptr if it was loaded from text. a loader made
+	// with loadFrom has the same one, patches or not, until it's compacted
+	const MapSnapshot* getSnapshot() const;
+	// reads a patch file. returns false, with ops left empty, if it's missing or malformed
+	bool readPatch(std::string patchFile, std::vector<MapPatchOp>& ops) const;
+	// applies one op to segment number segNum (not used by ADD_SEGMENT) and appends what changed.
+	// removing a segment moves the last segment into its number so the numbers stay dense
+	bool applyPatchOp(const MapPatchOp& op, size_t segNum, std::vector<MapChange>& changes);
 	// We prevent a MapLoader object from being copied or assigned.
 	MapLoader(const MapLoader&) = delete;
 	MapLoader& operator=(const MapLoader&) = delete;
@@ -71,7 +161,21 @@ public:
 	AttractionMapper();
 	~AttractionMapper();
 	void init(const MapLoader& ml);
-	bool getGeoCoord(std::string attraction, GeoCoord& gc) const;
+	// starts out with the same names as other, to be patched without changing other. the index is
+	// shared rather than copied, apart from whatever patches have changed in it
+	void initFrom(const AttractionMapper& other);
+	bool getGeoCoord(const std::string& attraction, GeoCoord& gc) const;
+	// the coordinate stored for the name, ignoring case, or nullptr if it isn't on the map. the name
+	// is read where it is and nothing gets allocated or copied. the pointer is good until the next
+	// init or applyChanges
+	const GeoCoord* findGeoCoord(const char* name, size_t length) const;
+	const GeoCoord* findGeoCoord(const std::string& name) const { return findGeoCoord(name.data(), name.size()); }
+	// up to k attractions whose names start with prefix, ignoring case, in alphabetical order. with
+	// maxEdits above 0, a name also counts if it starts with something at most that many typos
+	// (characters added, dropped or changed) away from prefix, and those come fewest typos first
+	std::vector<Attraction> complete(const std::string& prefix, size_t k, unsigned maxEdits = 0) const;
+	// updates the name index for changes made by MapLoader::applyPatchOp
+	void applyChanges(const std::vector<MapChange>& changes);
 	// We prevent an AttractionMapper object from being copied or assigned.
 	AttractionMapper(const AttractionMapper&) = delete;
 	AttractionMapper& operator=(const AttractionMapper&) = delete;
@@ -86,8 +190,16 @@ class SegmentMapper
 public:
 	SegmentMapper();
 	~SegmentMapper();
-	void init(const MapLoader& ml);
+	void init(const MapLoader& ml); // ml has to outlive the mapper, segments are read from it
+	// starts out with the same index as other, for ml, a loader made from other's with
+	// MapLoader::loadFrom. the index is shared rather than copied, apart from the coordinates
+	// patches have touched, and other isn't changed by this one's applyChanges
+	void initFrom(const SegmentMapper& other, const MapLoader& ml);
 	std::vector<StreetSegment> getSegments(const GeoCoord& gc) const;
+	// the loader's numbers for the same segments getSegments returns
+	std::vector<size_t> getSegmentNumbers(const GeoCoord& gc) const;
+	// updates the coordinate index for changes made by MapLoader::applyPatchOp
+	void applyChanges(const std::vector<MapChange>& changes);
 	// We prevent a SegmentMapper object from being copied or assigned.
 	SegmentMapper(const SegmentMapper&) = delete;
 	SegmentMapper& operator=(const SegmentMapper&) = delete;
@@ -105,18 +217,18 @@ public:
 	{}
 
 	// constructor for a Proceed NavSegment
-	NavSegment(std::string direction, std::string streetName, double distance, const GeoSegment& gs)
+	NavSegment(std::string direction, Name streetName, double distance, const GeoSegment& gs)
 		: m_command(PROCEED), m_direction(direction), m_streetName(streetName), m_distance(distance), m_geoSegment(gs)
 	{}
 
 	// constructor for a Turn NavSegment
-	NavSegment(std::string direction, std::string streetName)
+	NavSegment(std::string direction, Name streetName)
 		: m_command(TURN), m_direction(direction), m_streetName(streetName)
 	{}
 
 	NavCommand	m_command;	    // PROCEED or TURN
 	std::string	m_direction;	// e.g., "north" for proceed or "left" for turn
-	std::string	m_streetName;	// e.g., Westwood Blvd
+	Name		m_streetName;	// e.g., Westwood Blvd
 	double		m_distance;		// for proceed, distance in kilometers
 	GeoSegment	m_geoSegment;
 };
@@ -125,6 +237,22 @@ enum NavResult {
 	NAV_SUCCESS, NAV_BAD_SOURCE, NAV_BAD_DESTINATION, NAV_NO_ROUTE
 };
 
+// how navigate looks for a route. every mode finds a shortest one, they differ in how much of the
+// map they look at on the way
+enum RoutingMode {
+	ROUTE_ASTAR,			// A* out from the start. the default
+	ROUTE_BIDIRECTIONAL,	// A* out from both ends until they meet. looks at fewer streets on long routes
+	ROUTE_HIERARCHY,		// the contraction hierarchy from loadHierarchy. A* if none is loaded for this map
+	ROUTE_LANDMARKS			// A* guided by the landmarks from buildLandmarks. plain A* if there aren't any for this map
+};
+
+// an attraction found by how close it is to somewhere
+struct NearbyAttraction
+{
+	Attraction	attraction;
+	double		distance;	// in miles
+};
+
 class NavigatorImpl;
 
 class Navigator
@@ -132,8 +260,46 @@ class Navigator
 public:
 	Navigator();
 	~Navigator();
+	// safe to call while other threads are navigating: they keep the map they started with, and
+	// the new one is swapped in once it's completely built. a failed load keeps the old map
 	bool loadMapData(std::string mapFile);
+	// applies a patch file to the loaded map. returns false if the patch couldn't be read
+	// (nothing changes) or if some op named a segment or attraction that isn't on the map (that op is skipped).
+	// like loadMapData, the patched map is built off to the side and swapped in, so this is safe
+	// to call while other threads are navigating
+	bool applyPatch(std::string patchFile);
 	NavResult navigate(std::string start, std::string end, std::vector<NavSegment>& directions) const;
+	// the same, but between two coordinates instead of two attractions. each is first moved to the
+	// closest point on the closest street, so they don't have to be exactly on the map (a GPS fix, say)
+	NavResult navigate(const GeoCoord& start, const GeoCoord& end, std::vector<NavSegment>& directions) const;
+	// the k attractions closest to gc, closest first. as the crow flies by default. byRoad measures
+	// the drive instead, along the streets from the closest point on the closest street to gc, and
+	// leaves out anything that can't be driven to from there
+	std::vector<NearbyAttraction> nearestAttractions(const GeoCoord& gc, size_t k, bool byRoad = false) const;
+	// how far it is to drive from each of sources to each of targets (all attraction names), in
+	// miles, without working out any directions: distances[i][j] is how long the route navigate
+	// would find from sources[i] to targets[j], or HUGE_VAL if there isn't one. the searches share
+	// their work, so this is much quicker than navigating every pair. returns NAV_BAD_SOURCE or
+	// NAV_BAD_DESTINATION, leaving distances alone, if a name isn't an attraction
+	NavResult distanceMatrix(const std::vector<std::string>& sources, const std::vector<std::string>& targets,
+		std::vector<std::vector<double>>& distances) const;
+	// contracts the loaded map's streets and writes the result to a file for loadHierarchy. on the
+	// LA map this takes about half a second (several times a patch or a load), so it's meant to be
+	// done once, offline, for each map
+	bool saveHierarchy(std::string hierarchyFile) const;
+	// makes ROUTE_HIERARCHY use a file written by saveHierarchy. fails unless the file was made from
+	// exactly this map. safe to call while other threads are navigating. loading another map, or
+	// applying a patch, drops it again
+	bool loadHierarchy(std::string hierarchyFile);
+	// picks count landmarks around the edge of the loaded map and works out how far every point on
+	// its streets is from each, for ROUTE_LANDMARKS. the default 16 take about 50 ms and 2.4 MB.
+	// safe to call while other threads are navigating. a patch that only removes things keeps them,
+	// since routes can only have gotten longer. one that adds anything drops them, as does loading
+	// another map, and ROUTE_LANDMARKS is plain A* until they're built again
+	bool buildLandmarks(size_t count = 16);
+	// picks how navigate searches from now on. safe to call while other threads are navigating
+	void setRoutingMode(RoutingMode mode);
+	RoutingMode getRoutingMode() const;
 	// We prevent a Navigator object from being copied or assigned.
 	Navigator(const Navigator&) = delete;
 	Navigator& operator=(const Navigator&) = delete;
@@ -1,5 +1,19 @@
 #include "support.h"
 #include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <cstring>
+#include <stdexcept>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 using namespace std;
 
 string directionOfLine(const GeoSegment& gs)
@@ -23,4 +37,263 @@ string directionOfLine(const GeoSegment& gs)
 		return "southeast";
 	else
 		return "east";
-}
\ No newline at end of file
+}
+
+namespace
+{
+	string fixedE7Text(int32_t valueE7)
+	{
+		// done in integers so the text is exactly the key, with no rounding from going through a double
+		int64_t magnitude = valueE7 < 0 ? -static_cast<int64_t>(valueE7) : valueE7;
+		string fraction = to_string(magnitude % 10000000);
+		return (valueE7 < 0 ? "-" : "") + to_string(magnitude / 10000000) + "." + string(7 - fraction.size(), '0') + fraction;
+	}
+}
+
+GeoCoord CoordKey::toGeoCoord() const
+{
+	return GeoCoord(fixedE7Text(latitudeE7()), fixedE7Text(longitudeE7()));
+}
+
+//******************** Name functions *****************************************
+
+namespace
+{
+	// the process wide table behind Name. interning takes a lock, but turning an id back into its
+	// text never does: names live in fixed size chunks that never move once they're allocated,
+	// so a reader only has to find the chunk.
+	class NameTable
+	{
+	public:
+		NameTable();
+		~NameTable();
+		unsigned intern(const char* text, size_t length);
+		const string& lookup(unsigned id) const
+		{
+			return m_chunks[id >> CHUNK_BITS].load(memory_order_acquire)[id & (CHUNK_SIZE - 1)];
+		}
+	private:
+		static const unsigned CHUNK_BITS = 12;
+		static const unsigned CHUNK_SIZE = 1 << CHUNK_BITS;
+		static const unsigned MAX_CHUNKS = 1 << 14; // room for 67 million distinct names
+		atomic<string*> m_chunks[MAX_CHUNKS];
+		unsigned m_count;
+		vector<unsigned> m_slots; // open addressing table of id + 1, 0 means the slot is empty
+		mutex m_mutex;
+
+		static size_t hashOf(const char* text, size_t length);
+		void grow();
+	};
+
+	NameTable::NameTable()
+		: m_count(0), m_slots(1024, 0)
+	{
+		for (unsigned c = 0; c < MAX_CHUNKS; c++)
+			m_chunks[c].store(nullptr, memory_order_relaxed);
+		intern("", 0); // so a default constructed Name (id 0) is the empty name
+	}
+
+	NameTable::~NameTable()
+	{
+		for (unsigned c = 0; c < MAX_CHUNKS; c++)
+			delete[] m_chunks[c].load(memory_order_relaxed);
+	}
+
+	// FNV-1a. works on the raw characters so looking a name up never builds a string
+	size_t NameTable::hashOf(const char* text, size_t length)
+	{
+		size_t hash = 2166136261u;
+		for (size_t i = 0; i < length; i++)
+			hash = (hash ^ static_cast<unsigned char>(text[i])) * 16777619u;
+		return hash;
+	}
+
+	unsigned NameTable::intern(const char* text, size_t length)
+	{
+		lock_guard<mutex> lock(m_mutex);
+		size_t mask = m_slots.size() - 1;
+		for (size_t slot = hashOf(text, length) & mask; ; slot = (slot + 1) & mask)
+		{
+			if (m_slots[slot] == 0) // not in the table yet, so it gets the next id
+			{
+				unsigned id = m_count;
+				unsigned chunk = id >> CHUNK_BITS;
+				if (chunk >= MAX_CHUNKS)
+					throw length_error("too many distinct names");
+				string* storage = m_chunks[chunk].load(memory_order_relaxed);
+				if (storage == nullptr)
+				{
+					storage = new string[CHUNK_SIZE];
+					m_chunks[chunk].store(storage, memory_order_release);
+				}
+				storage[id & (CHUNK_SIZE - 1)].assign(text, length);
+				m_slots[slot] = id + 1;
+				m_count++;
+				if (m_count * 2 > m_slots.size()) // keep the table at most half full
+					grow();
+				return id;
+			}
+			const string &existing = lookup(m_slots[slot] - 1);
+			if (existing.size() == length && memcmp(existing.data(), text, length) == 0)
+				return m_slots[slot] - 1;
+		}
+	}
+
+	void NameTable::grow()
+	{
+		vector<unsigned> slots(m_slots.size() * 2, 0);
+		size_t mask = slots.size() - 1;
+		for (unsigned id = 0; id < m_count; id++)
+		{
+			const string &text = lookup(id);
+			size_t slot = hashOf(text.data(), text.size()) & mask;
+			while (slots[slot] != 0)
+				slot = (slot + 1) & mask;
+			slots[slot] = id + 1;
+		}
+		m_slots.swap(slots);
+	}
+
+	NameTable& nameTable()
+	{
+		static NameTable table; // built the first time any name is interned
+		return table;
+	}
+}
+
+Name::Name(const string& text)
+	: m_id(nameTable().intern(text.data(), text.size()))
+{
+}
+
+Name::Name(const char* text)
+	: m_id(nameTable().intern(text, strlen(text)))
+{
+}
+
+Name::Name(const char* text, size_t length)
+	: m_id(nameTable().intern(text, length))
+{
+}
+
+const string& Name::str() const
+{
+	return nameTable().lookup(m_id);
+}
+
+ostream& operator<<(ostream& os, const Name& name)
+{
+	return os << name.str();
+}
+
+//******************** MappedFile functions ***********************************
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile()
+	: m_data(nullptr), m_size(0), m_fileHandle(INVALID_HANDLE_VALUE), m_mappingHandle(nullptr)
+{
+}
+
+bool MappedFile::open(const string &fileName)
+{
+	close();
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	m_fileHandle = file;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		close();
+		return false;
+	}
+	m_size = static_cast<size_t>(fileSize.QuadPart);
+	if (m_size == 0) // can't map an empty file, but it's still a valid (empty) file
+		return true;
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		close();
+		return false;
+	}
+	m_mappingHandle = mapping;
+	m_data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_data == nullptr)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_mappingHandle != nullptr)
+		CloseHandle(m_mappingHandle);
+	if (m_fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(m_fileHandle);
+	m_data = nullptr;
+	m_size = 0;
+	m_mappingHandle = nullptr;
+	m_fileHandle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+MappedFile::MappedFile()
+	: m_data(nullptr), m_size(0)
+{
+}
+
+bool MappedFile::open(const string &fileName)
+{
+	close();
+	int fd = ::open(fileName.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+	{
+		::close(fd);
+		return false;
+	}
+	m_size = static_cast<size_t>(info.st_size);
+	if (m_size == 0) // mmap refuses zero-length mappings, but an empty file is still valid
+	{
+		::close(fd);
+		return true;
+	}
+
+	void* mapped = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // the mapping keeps its own reference to the file
+	if (mapped == MAP_FAILED)
+	{
+		m_size = 0;
+		return false;
+	}
+	madvise(mapped, m_size, MADV_SEQUENTIAL); // we read front to back, so let the kernel read ahead
+	m_data = static_cast<const char*>(mapped);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data != nullptr)
+		munmap(const_cast<char*>(m_data), m_size);
+	m_data = nullptr;
+	m_size = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
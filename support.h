@@ -3,21 +3,174 @@
 
 #include "provided.h"
 #include <string>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <functional>
 
-// need this operator for comparing geocoords
+// a coordinate packed into one 64 bit integer. latitude and longitude are each stored as a whole
+// number of 1e-7 degrees (the precision the map data is written with), which fits in 32 bits.
+// they're offset so that comparing the packed values as unsigned numbers orders keys by latitude
+// and then longitude. the indexes and the route search compare these instead of coordinate text
+class CoordKey
+{
+public:
+	CoordKey() : m_bits(0) {} // isn't a real coordinate, so it can be used to mean "no coordinate"
+	explicit CoordKey(const GeoCoord &gc) : m_bits(pack(toFixed(gc.latitude), toFixed(gc.longitude))) {}
+	CoordKey(int32_t latitudeE7, int32_t longitudeE7) : m_bits(pack(latitudeE7, longitudeE7)) {}
+
+	int32_t latitudeE7() const { return static_cast<int32_t>(static_cast<uint32_t>(m_bits >> 32) ^ SIGN_BIT); }
+	int32_t longitudeE7() const { return static_cast<int32_t>(static_cast<uint32_t>(m_bits) ^ SIGN_BIT); }
+	// dividing the exact integer gives the same double as parsing seven decimal places of text
+	double latitude() const { return latitudeE7() / 1e7; }
+	double longitude() const { return longitudeE7() / 1e7; }
+	uint64_t bits() const { return m_bits; }
+	// the coordinate written out with seven decimal places, like the map data
+	GeoCoord toGeoCoord() const;
+
+	bool operator <(const CoordKey &RHS) const { return m_bits < RHS.m_bits; }
+	bool operator ==(const CoordKey &RHS) const { return m_bits == RHS.m_bits; }
+	bool operator !=(const CoordKey &RHS) const { return m_bits != RHS.m_bits; }
+private:
+	static const uint32_t SIGN_BIT = 0x80000000u;
+	uint64_t m_bits;
+
+	static int32_t toFixed(double degrees) { return static_cast<int32_t>(llround(degrees * 1e7)); }
+	// flipping the sign bit turns two's complement order into unsigned order
+	static uint64_t pack(int32_t latitudeE7, int32_t longitudeE7)
+	{
+		return static_cast<uint64_t>(static_cast<uint32_t>(latitudeE7) ^ SIGN_BIT) << 32 |
+			(static_cast<uint32_t>(longitudeE7) ^ SIGN_BIT);
+	}
+};
+
+// so CoordKeys can be used in hash tables
+namespace std
+{
+	template<> struct hash<CoordKey>
+	{
+		size_t operator()(const CoordKey &key) const { return hash<uint64_t>()(key.bits()); }
+	};
+}
+
+// need this operator for comparing geocoords. orders them the same way as their keys
 inline bool operator <(const GeoCoord &LHS, const GeoCoord &RHS)
 {
-	if (LHS.latitudeText < RHS.latitudeText)
-		return true;
-	else if (RHS.latitudeText < LHS.latitudeText)
-		return false;
-	else if (LHS.longitudeText < RHS.longitudeText)
-		return true;
-	else
+	return CoordKey(LHS) < CoordKey(RHS);
+}
+
+// equality comparison operator for geocoords. compares their numeric values, so "34.05" and
+// "34.0500000" are the same place
+inline bool operator ==(const GeoCoord &LHS, const GeoCoord &RHS)
+{
+	return CoordKey(LHS) == CoordKey(RHS);
+}
+
+// lowercase for the ASCII letters and nothing else, which is what tolower does in the "C" locale
+inline char asciiLower(char c)
+{
+	return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// a name to look up by, read where it already is instead of being copied into a lowercase string.
+// a table keyed by lowercase strings and hashed with CaseInsensitiveHash can be searched with one
+// of these (see MyHashMap::findEquivalent), and a probe matches a key if it's the key in any case
+struct NameProbe
+{
+	NameProbe(const char* text, size_t length) : text(text), length(length) {}
+	const char* text;
+	size_t length;
+};
+
+inline bool operator ==(const std::string &lowerKey, const NameProbe &probe)
+{
+	if (lowerKey.size() != probe.length)
 		return false;
+	for (size_t i = 0; i < probe.length; i++)
+		if (lowerKey[i] != asciiLower(probe.text[i]))
+			return false;
+	return true;
 }
 
+// FNV-1a over the lowercased characters, so a lowercase key and a probe for it in any case hash the same
+struct CaseInsensitiveHash
+{
+	size_t operator()(const std::string &text) const { return hash(text.data(), text.size()); }
+	size_t operator()(const NameProbe &probe) const { return hash(probe.text, probe.length); }
+	static size_t hash(const char* text, size_t length)
+	{
+		uint64_t h = 14695981039346656037ull;
+		for (size_t i = 0; i < length; i++)
+			h = (h ^ static_cast<unsigned char>(asciiLower(text[i]))) * 1099511628211ull;
+		return static_cast<size_t>(h);
+	}
+};
+
+// an array that's either its own or read where it already is, like a section of a mapped
+// snapshot. reading it is the same both ways, so the indexes that can be saved in a snapshot
+// don't care which one they got
+template<typename T>
+class FlatArray
+{
+public:
+	FlatArray() : m_data(nullptr), m_size(0) {}
+	// takes over what's in elements
+	void assign(std::vector<T> &&elements)
+	{
+		m_owned.swap(elements);
+		m_data = m_owned.data();
+		m_size = m_owned.size();
+	}
+	// reads count elements at data, which has to outlive this array (or the next assign)
+	void view(const T* data, size_t count)
+	{
+		m_owned.clear();
+		m_data = data;
+		m_size = count;
+	}
+	// an array is only ever copied on purpose, with this, and the copy is always its own
+	void copyFrom(const FlatArray &other) { assign(std::vector<T>(other.begin(), other.end())); }
+	void clear() { assign(std::vector<T>()); }
+
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+	const T* data() const { return m_data; }
+	const T& operator[](size_t i) const { return m_data[i]; }
+	const T* begin() const { return m_data; }
+	const T* end() const { return m_data + m_size; }
+
+	FlatArray(const FlatArray&) = delete;
+	FlatArray& operator=(const FlatArray&) = delete;
+private:
+	std::vector<T> m_owned; // empty for a view
+	const T* m_data;
+	size_t m_size;
+};
+
 // used for finding the direction that a geosegment goes
 std::string directionOfLine(const GeoSegment& gs);
 
-#endif // for SUPPORT_H
\ No newline at end of file
+// read-only view of a whole file mapped into memory. used by the loaders so they can
+// parse straight out of the page cache instead of pulling one character at a time from a stream
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+	bool open(const std::string &fileName); // returns false if the file can't be opened or mapped
+	void close();
+	const char* data() const { return m_data; }
+	size_t size() const { return m_size; }
+	// we prevent a MappedFile from being copied or assigned because it owns the mapping
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+private:
+	const char* m_data;
+	size_t m_size;
+#if defined(_WIN32)
+	void* m_fileHandle;
+	void* m_mappingHandle;
+#endif
+};
+
+#endif // for SUPPORT_H
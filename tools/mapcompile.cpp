@@ -0,0 +1,32 @@
+// the compile step for map snapshots: loads text map data and writes the snapshot Navigator and
+// MapLoader can load in its place (see MapSnapshot.h). rerun it whenever the map data changes;
+// a snapshot from an older build of the format is rejected at load, not misread.
+//
+//   g++ -std=c++11 -O2 -I. -o mapcompile tools/mapcompile.cpp $(ls *.cpp | grep -v main.cpp) -lpthread
+//   ./mapcompile mapdata.txt map.snapshot
+
+#include "provided.h"
+#include <iostream>
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+	if (argc != 3)
+	{
+		cerr << "usage: mapcompile mapfile snapshotfile" << endl;
+		return 1;
+	}
+	MapLoader ml;
+	if (!ml.load(argv[1]))
+	{
+		cerr << "can't load " << argv[1] << endl;
+		return 1;
+	}
+	if (!ml.saveSnapshot(argv[2]))
+	{
+		cerr << "can't write " << argv[2] << endl;
+		return 1;
+	}
+	cerr << "wrote " << ml.getNumSegments() << " segments to " << argv[2] << endl;
+	return 0;
+}